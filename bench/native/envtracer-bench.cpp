@@ -0,0 +1,630 @@
+/* Native microbenchmark of the tables, backtraces and their export.
+
+   Backtrace, EnvironmentTable, EnvironmentAccessTable and EffectsTable are
+   driven by a synthetic event stream on a mock of the instrumentr value
+   and frame API, so that their cost is measured without running R code.
+   A random walk over a call stack of bounded depth decides where events
+   happen; the cardinality is the number of distinct calls, promises,
+   functions, environments and symbols the events refer to.
+
+   One row of CSV per benchmark is written to stdout:
+
+   benchmark              table driven by the events
+   events                 number of events
+   ns_per_event           time to insert an event
+   allocations            operator new calls during the events
+   allocations_per_event  allocations over events
+   heap_mb                heap held by the table after the events
+   arena_mb               arena blocks reserved by the table, NA if it
+                          has no arena
+   rows                   rows of the table
+   export_ns_per_row      time to export a row, NA with --export=none
+
+   R is always embedded, also with --export=none, since the tables rely on
+   globals such as NA_INTEGER that R sets when it starts.
+
+   --export=sexp keeps the tables in memory and exports them with to_sexp.
+   --export=stream streams the event tables to --output while events are
+   inserted, as trace_expr(output = ...) does; export then only closes the
+   streams. The environment table is an entity table and always exported
+   with to_sexp. Records of 10^8 events only fit in memory when streamed.
+
+   usage: envtracer-bench [--events=n] [--depth=n] [--cardinality=n]
+                          [--benchmarks=a,b] [--export=sexp|stream|none]
+                          [--output=dir] [--chunk-size=n] [--seed=n] */
+
+#include "Backtrace.h"
+#include "EffectsTable.h"
+#include "EnvironmentAccessTable.h"
+#include "EnvironmentTable.h"
+#include <Rembedded.h>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <malloc.h>
+#include <sys/stat.h>
+
+/* heap usage of the process, counted by the replaced operator new. Arena
+   blocks and R vectors are allocated with malloc and not counted. */
+static std::atomic<std::size_t> allocation_count(0);
+static std::atomic<std::size_t> live_bytes(0);
+
+void* operator new(std::size_t size) {
+    void* memory = std::malloc(size == 0 ? 1 : size);
+    if (memory == nullptr) {
+        throw std::bad_alloc();
+    }
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    live_bytes.fetch_add(malloc_usable_size(memory),
+                         std::memory_order_relaxed);
+    return memory;
+}
+
+void operator delete(void* memory) noexcept {
+    if (memory != nullptr) {
+        live_bytes.fetch_sub(malloc_usable_size(memory),
+                             std::memory_order_relaxed);
+        std::free(memory);
+    }
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+    operator delete(memory);
+}
+
+struct BenchOptions {
+    BenchOptions()
+        : events(1000000)
+        , depth(64)
+        , cardinality(10000)
+        , benchmarks({"backtrace", "environment", "env_access", "effects"})
+        , export_mode("sexp")
+        , output("/tmp/envtracer-bench")
+        , chunk_size(65536)
+        , seed(42) {
+    }
+
+    double events;
+    int depth;
+    int cardinality;
+    std::vector<std::string> benchmarks;
+    std::string export_mode;
+    std::string output;
+    int chunk_size;
+    std::uint64_t seed;
+};
+
+/* negative values are written as NA */
+struct BenchResult {
+    std::string benchmark;
+    double events;
+    double seconds;
+    double allocations;
+    double heap_bytes;
+    double arena_bytes;
+    double rows;
+    double export_seconds;
+};
+
+/* xorshift64*, fast enough not to show up in the timings */
+class Random {
+  public:
+    explicit Random(std::uint64_t seed): state_(seed * 2654435761ULL + 1) {
+    }
+
+    int below(int bound) {
+        state_ ^= state_ >> 12;
+        state_ ^= state_ << 25;
+        state_ ^= state_ >> 27;
+        return (state_ * 2685821657736338717ULL >> 33) % bound;
+    }
+
+  private:
+    std::uint64_t state_;
+};
+
+/* depth of the call stack, which moves up or down by one per event and
+   stays within [0, max_depth] */
+class StackWalk {
+  public:
+    explicit StackWalk(int max_depth): depth_(0), max_depth_(max_depth) {
+    }
+
+    /* true if the event pushes a frame, false if it pops one */
+    bool step(Random& random) {
+        bool push = depth_ == 0 ||
+                    (depth_ < max_depth_ && random.below(2) == 0);
+        depth_ += push ? 1 : -1;
+        return push;
+    }
+
+    int get_depth() const {
+        return depth_;
+    }
+
+  private:
+    int depth_;
+    int max_depth_;
+};
+
+/* instrumentr objects the events refer to. Environment i is a call
+   environment whose parent is environment (i - 1) / 2; environment 0 is a
+   namespace whose parent is NULL. */
+class SyntheticProgram {
+  public:
+    explicit SyntheticProgram(int cardinality)
+        : closures_(cardinality)
+        , builtins_(cardinality)
+        , specials_(cardinality)
+        , calls_(cardinality)
+        , promises_(cardinality)
+        , frames_(2 * cardinality)
+        , environments_(cardinality) {
+        null_.kind = MOCK_VALUE_NULL;
+        null_.id = 0;
+        null_.name = nullptr;
+
+        for (int index = 0; index < cardinality; ++index) {
+            function_names_.push_back("f" + std::to_string(index));
+            symbols_.push_back("x" + std::to_string(index));
+        }
+
+        for (int index = 0; index < cardinality; ++index) {
+            calls_[index].id = index;
+            calls_[index].function = create_function_(index);
+            promises_[index].id = index;
+            frames_[2 * index] = {&calls_[index], nullptr};
+            frames_[2 * index + 1] = {nullptr, &promises_[index]};
+            create_environment_(index);
+        }
+    }
+
+    int get_cardinality() const {
+        return calls_.size();
+    }
+
+    /* three in four frames are calls */
+    instrumentr_frame_t get_frame(Random& random) {
+        int index = random.below(get_cardinality());
+        return &frames_[2 * index + (random.below(4) == 0)];
+    }
+
+    instrumentr_environment_t get_environment(int index) {
+        return &environments_[index];
+    }
+
+    const std::string& get_function_name(int index) const {
+        return function_names_[index];
+    }
+
+    const std::string& get_symbol(int index) const {
+        return symbols_[index];
+    }
+
+  private:
+    /* half of the functions are closures, the rest builtins and specials */
+    instrumentr_value_t create_function_(int index) {
+        instrumentr_value_impl_t* function;
+
+        switch (index % 4) {
+        case 2:
+            function = &builtins_[index];
+            function->kind = MOCK_VALUE_BUILTIN;
+            break;
+        case 3:
+            function = &specials_[index];
+            function->kind = MOCK_VALUE_SPECIAL;
+            break;
+        default:
+            function = &closures_[index];
+            function->kind = MOCK_VALUE_CLOSURE;
+            break;
+        }
+
+        function->id = index;
+        function->name = function_names_[index].c_str();
+        return function;
+    }
+
+    void create_environment_(int index) {
+        instrumentr_environment_impl_t& environment = environments_[index];
+        environment.kind = MOCK_VALUE_ENVIRONMENT;
+        environment.id = index;
+
+        if (index == 0) {
+            environment.name = "envtracer";
+            environment.type = INSTRUMENTR_ENVIRONMENT_TYPE_NAMESPACE;
+            environment.hashed = true;
+            environment.parent = &null_;
+            environment.call = nullptr;
+        } else {
+            environment.name = nullptr;
+            environment.type = INSTRUMENTR_ENVIRONMENT_TYPE_CALL;
+            environment.hashed = index % 8 == 0;
+            environment.parent = &environments_[(index - 1) / 2];
+            environment.call = &calls_[index];
+        }
+    }
+
+    instrumentr_value_impl_t null_;
+    std::vector<std::string> function_names_;
+    std::vector<std::string> symbols_;
+    std::vector<instrumentr_closure_impl_t> closures_;
+    std::vector<instrumentr_builtin_impl_t> builtins_;
+    std::vector<instrumentr_special_impl_t> specials_;
+    std::vector<instrumentr_call_impl_t> calls_;
+    std::vector<instrumentr_promise_impl_t> promises_;
+    std::vector<instrumentr_frame_impl_t> frames_;
+    std::vector<instrumentr_environment_impl_t> environments_;
+};
+
+/* measures the events of a benchmark and the export of its table. The
+   heap is measured between the creation of the measure, which precedes
+   the table, and the end of the events. */
+class BenchMeasure {
+  public:
+    BenchMeasure(const std::string& benchmark, double events)
+        : start_allocations_(allocation_count.load())
+        , start_bytes_(live_bytes.load()) {
+        result_.benchmark = benchmark;
+        result_.events = events;
+        result_.arena_bytes = -1;
+        result_.export_seconds = -1;
+    }
+
+    void start() {
+        start_allocations_ = allocation_count.load();
+        start_time_ = std::chrono::steady_clock::now();
+    }
+
+    void stop_events() {
+        std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start_time_;
+        result_.seconds = elapsed.count();
+        result_.allocations = allocation_count.load() - start_allocations_;
+        result_.heap_bytes =
+            static_cast<double>(live_bytes.load()) - start_bytes_;
+    }
+
+    void start_export() {
+        start_time_ = std::chrono::steady_clock::now();
+    }
+
+    void stop_export() {
+        std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start_time_;
+        result_.export_seconds = elapsed.count();
+    }
+
+    void set_arena(const Arena& arena) {
+        result_.arena_bytes = arena.get_reserved_bytes();
+    }
+
+    void set_rows(double rows) {
+        result_.rows = rows;
+    }
+
+    const BenchResult& get_result() const {
+        return result_;
+    }
+
+  private:
+    BenchResult result_;
+    std::size_t start_allocations_;
+    std::size_t start_bytes_;
+    std::chrono::steady_clock::time_point start_time_;
+};
+
+/* exports an in-memory table with to_sexp */
+template <typename Table>
+void export_sexp(Table& table, BenchMeasure& measure) {
+    measure.start_export();
+    PROTECT(table.to_sexp());
+    measure.stop_export();
+    UNPROTECT(1);
+}
+
+/* pushes and pops frames of the walk */
+BenchResult bench_backtrace(const BenchOptions& options,
+                            SyntheticProgram& program) {
+    Random random(options.seed);
+    StackWalk walk(options.depth);
+    BenchMeasure measure("backtrace", options.events);
+    std::unique_ptr<StreamWriter> writer;
+    Backtrace backtrace;
+    int max_node_id = 0;
+
+    if (options.export_mode == "stream") {
+        writer.reset(new StreamWriter());
+        backtrace.enable_streaming(*writer,
+                                   options.output + "/backtraces.tbl",
+                                   options.chunk_size);
+    }
+
+    measure.start();
+    for (double event = 0; event < options.events; ++event) {
+        if (walk.step(random)) {
+            backtrace.push(program.get_frame(random));
+            if (backtrace.get_node_id() > max_node_id) {
+                max_node_id = backtrace.get_node_id();
+            }
+        } else {
+            backtrace.pop();
+        }
+    }
+    measure.stop_events();
+    measure.set_rows(max_node_id + 1);
+
+    if (options.export_mode == "sexp") {
+        export_sexp(backtrace, measure);
+    } else if (writer) {
+        measure.start_export();
+        backtrace.close_stream();
+        writer->stop();
+        measure.stop_export();
+    }
+
+    return measure.get_result();
+}
+
+/* inserts environments, which also inserts their ancestors */
+BenchResult bench_environment(const BenchOptions& options,
+                              SyntheticProgram& program) {
+    Random random(options.seed);
+    BenchMeasure measure("environment", options.events);
+    EnvironmentTable table;
+    int cardinality = program.get_cardinality();
+
+    measure.start();
+    for (double event = 0; event < options.events; ++event) {
+        table.insert(program.get_environment(random.below(cardinality)));
+    }
+    measure.stop_events();
+
+    int rows = 0;
+    for (int index = 0; index < cardinality; ++index) {
+        rows += table.lookup(index) != NULL;
+    }
+    measure.set_rows(rows);
+
+    if (options.export_mode != "none") {
+        export_sexp(table, measure);
+    }
+
+    return measure.get_result();
+}
+
+/* creates and inserts a variable lookup per event */
+BenchResult bench_env_access(const BenchOptions& options,
+                             SyntheticProgram& program) {
+    Random random(options.seed);
+    StackWalk walk(options.depth);
+    BenchMeasure measure("env_access", options.events);
+    std::unique_ptr<StreamWriter> writer;
+    Arena arena;
+    EnvironmentAccessTable table(arena);
+    int cardinality = program.get_cardinality();
+
+    if (options.export_mode == "stream") {
+        writer.reset(new StreamWriter());
+        table.enable_streaming(
+            *writer, options.output + "/env_access.tbl", options.chunk_size);
+    }
+
+    measure.start();
+    for (double event = 0; event < options.events; ++event) {
+        walk.step(random);
+        int function = random.below(cardinality);
+        EnvironmentAccess* access =
+            table.create(static_cast<int>(event),
+                         walk.get_depth(),
+                         program.get_function_name(function));
+        access->set_fun("closure", function);
+        access->set_symbol(program.get_symbol(random.below(cardinality)));
+        access->set_result_env("call", random.below(cardinality));
+        access->set_backtrace(random.below(cardinality));
+        table.insert(access);
+    }
+    measure.stop_events();
+    measure.set_arena(arena);
+    measure.set_rows(options.events);
+
+    if (options.export_mode == "sexp") {
+        export_sexp(table, measure);
+    } else if (writer) {
+        measure.start_export();
+        table.close_stream();
+        writer->stop();
+        measure.stop_export();
+    }
+
+    return measure.get_result();
+}
+
+/* inserts a variable side effect per event */
+BenchResult bench_effects(const BenchOptions& options,
+                          SyntheticProgram& program) {
+    Random random(options.seed);
+    BenchMeasure measure("effects", options.events);
+    std::unique_ptr<StreamWriter> writer;
+    Arena arena;
+    EffectsTable table(arena);
+    int cardinality = program.get_cardinality();
+
+    if (options.export_mode == "stream") {
+        writer.reset(new StreamWriter());
+        table.enable_streaming(
+            *writer, options.output + "/effects.tbl", options.chunk_size);
+    }
+
+    measure.start();
+    for (double event = 0; event < options.events; ++event) {
+        int function = random.below(cardinality);
+        table.insert(random.below(4) == 0 ? 'D' : 'A',
+                     program.get_symbol(random.below(cardinality)),
+                     random.below(2),
+                     random.below(cardinality),
+                     function,
+                     random.below(cardinality),
+                     NA_INTEGER,
+                     NA_INTEGER,
+                     function,
+                     random.below(cardinality),
+                     NA_INTEGER,
+                     NA_INTEGER,
+                     random.below(cardinality));
+    }
+    measure.stop_events();
+    measure.set_arena(arena);
+    measure.set_rows(options.events);
+
+    if (options.export_mode == "sexp") {
+        export_sexp(table, measure);
+    } else if (writer) {
+        measure.start_export();
+        table.close_stream();
+        writer->stop();
+        measure.stop_export();
+    }
+
+    return measure.get_result();
+}
+
+void write_value(double value, double scale) {
+    if (value < 0) {
+        std::printf(",NA");
+    } else {
+        std::printf(",%.3f", value * scale);
+    }
+}
+
+void write_result(const BenchResult& result) {
+    double events = result.events > 0 ? result.events : 1;
+    double rows = result.rows > 0 ? result.rows : 1;
+
+    std::printf("%s,%.0f", result.benchmark.c_str(), result.events);
+    write_value(result.seconds, 1e9 / events);
+    std::printf(",%.0f", result.allocations);
+    write_value(result.allocations, 1 / events);
+    write_value(result.heap_bytes < 0 ? 0 : result.heap_bytes, 1.0 / 1048576);
+    write_value(result.arena_bytes, 1.0 / 1048576);
+    std::printf(",%.0f", result.rows);
+    write_value(result.export_seconds, 1e9 / rows);
+    std::printf("\n");
+    std::fflush(stdout);
+}
+
+bool parse_option(const char* arg, const char* name, std::string& value) {
+    std::size_t size = std::strlen(name);
+    if (std::strncmp(arg, name, size) != 0 || arg[size] != '=') {
+        return false;
+    }
+    value = arg + size + 1;
+    return true;
+}
+
+std::vector<std::string> split(const std::string& value) {
+    std::vector<std::string> parts;
+    std::size_t start = 0;
+    while (start <= value.size()) {
+        std::size_t end = value.find(',', start);
+        if (end == std::string::npos) {
+            end = value.size();
+        }
+        parts.push_back(value.substr(start, end - start));
+        start = end + 1;
+    }
+    return parts;
+}
+
+BenchOptions parse_options(int argc, char* argv[]) {
+    BenchOptions options;
+    std::string value;
+
+    for (int index = 1; index < argc; ++index) {
+        const char* arg = argv[index];
+
+        if (parse_option(arg, "--events", value)) {
+            options.events = std::strtod(value.c_str(), nullptr);
+        } else if (parse_option(arg, "--depth", value)) {
+            options.depth = std::atoi(value.c_str());
+        } else if (parse_option(arg, "--cardinality", value)) {
+            options.cardinality = std::atoi(value.c_str());
+        } else if (parse_option(arg, "--benchmarks", value)) {
+            options.benchmarks = split(value);
+        } else if (parse_option(arg, "--export", value)) {
+            options.export_mode = value;
+        } else if (parse_option(arg, "--output", value)) {
+            options.output = value;
+        } else if (parse_option(arg, "--chunk-size", value)) {
+            options.chunk_size = std::atoi(value.c_str());
+        } else if (parse_option(arg, "--seed", value)) {
+            options.seed = std::strtoull(value.c_str(), nullptr, 10);
+        } else {
+            throw std::invalid_argument(std::string("unknown option ") + arg);
+        }
+    }
+
+    if (options.events < 0 || options.events > 1e9) {
+        throw std::invalid_argument("--events must be in [0, 1e9]");
+    }
+    if (options.depth < 1 || options.cardinality < 1 ||
+        options.chunk_size < 1) {
+        throw std::invalid_argument(
+            "--depth, --cardinality and --chunk-size must be positive");
+    }
+    if (options.export_mode != "sexp" && options.export_mode != "stream" &&
+        options.export_mode != "none") {
+        throw std::invalid_argument("--export must be sexp, stream or none");
+    }
+
+    return options;
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        BenchOptions options = parse_options(argc, argv);
+
+        if (options.export_mode == "stream" &&
+            mkdir(options.output.c_str(), 0777) != 0 && errno != EEXIST) {
+            throw std::runtime_error("cannot create " + options.output);
+        }
+
+        char* r_argv[] = {argv[0],
+                          const_cast<char*>("--vanilla"),
+                          const_cast<char*>("--silent"),
+                          const_cast<char*>("--slave")};
+        Rf_initEmbeddedR(4, r_argv);
+
+        SyntheticProgram program(options.cardinality);
+
+        std::printf("benchmark,events,ns_per_event,allocations,"
+                    "allocations_per_event,heap_mb,arena_mb,rows,"
+                    "export_ns_per_row\n");
+
+        for (const std::string& benchmark: options.benchmarks) {
+            if (benchmark == "backtrace") {
+                write_result(bench_backtrace(options, program));
+            } else if (benchmark == "environment") {
+                write_result(bench_environment(options, program));
+            } else if (benchmark == "env_access") {
+                write_result(bench_env_access(options, program));
+            } else if (benchmark == "effects") {
+                write_result(bench_effects(options, program));
+            } else {
+                throw std::invalid_argument("unknown benchmark " + benchmark);
+            }
+        }
+
+        Rf_endEmbeddedR(0);
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "%s: %s\n", argv[0], e.what());
+        return 1;
+    }
+
+    return 0;
+}
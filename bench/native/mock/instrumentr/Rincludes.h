@@ -0,0 +1,8 @@
+#ifndef ENVTRACER_BENCH_MOCK_RINCLUDES_H
+#define ENVTRACER_BENCH_MOCK_RINCLUDES_H
+
+/* the benchmark links with the real R, only instrumentr is mocked */
+#include <R.h>
+#include <Rinternals.h>
+
+#endif /* ENVTRACER_BENCH_MOCK_RINCLUDES_H */
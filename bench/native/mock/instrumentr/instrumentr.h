@@ -0,0 +1,221 @@
+#ifndef ENVTRACER_BENCH_MOCK_INSTRUMENTR_H
+#define ENVTRACER_BENCH_MOCK_INSTRUMENTR_H
+
+#include "Rincludes.h"
+
+/* Thin mock of the parts of the instrumentr value and frame API used by
+   the benchmarked tables. Objects are plain structs owned by the
+   benchmark; every accessor is a field read, so that timings measure the
+   tables and not the mock. */
+
+typedef enum {
+    INSTRUMENTR_ENVIRONMENT_TYPE_GLOBAL,
+    INSTRUMENTR_ENVIRONMENT_TYPE_BASE,
+    INSTRUMENTR_ENVIRONMENT_TYPE_EMPTY,
+    INSTRUMENTR_ENVIRONMENT_TYPE_NAMESPACE,
+    INSTRUMENTR_ENVIRONMENT_TYPE_PACKAGE,
+    INSTRUMENTR_ENVIRONMENT_TYPE_CALL,
+    INSTRUMENTR_ENVIRONMENT_TYPE_UNKNOWN
+} instrumentr_environment_type_t;
+
+typedef enum {
+    MOCK_VALUE_NULL,
+    MOCK_VALUE_CLOSURE,
+    MOCK_VALUE_BUILTIN,
+    MOCK_VALUE_SPECIAL,
+    MOCK_VALUE_ENVIRONMENT
+} mock_value_kind_t;
+
+struct instrumentr_value_impl_t {
+    mock_value_kind_t kind;
+    int id;
+    const char* name;
+};
+
+struct instrumentr_closure_impl_t: instrumentr_value_impl_t {};
+struct instrumentr_builtin_impl_t: instrumentr_value_impl_t {};
+struct instrumentr_special_impl_t: instrumentr_value_impl_t {};
+
+struct instrumentr_call_impl_t {
+    int id;
+    instrumentr_value_impl_t* function;
+};
+
+struct instrumentr_environment_impl_t: instrumentr_value_impl_t {
+    instrumentr_environment_type_t type;
+    bool hashed;
+    instrumentr_value_impl_t* parent;
+    instrumentr_call_impl_t* call;
+};
+
+struct instrumentr_promise_impl_t {
+    int id;
+};
+
+struct instrumentr_frame_impl_t {
+    instrumentr_call_impl_t* call;
+    instrumentr_promise_impl_t* promise;
+};
+
+typedef instrumentr_value_impl_t* instrumentr_value_t;
+typedef instrumentr_closure_impl_t* instrumentr_closure_t;
+typedef instrumentr_builtin_impl_t* instrumentr_builtin_t;
+typedef instrumentr_special_impl_t* instrumentr_special_t;
+typedef instrumentr_environment_impl_t* instrumentr_environment_t;
+typedef instrumentr_call_impl_t* instrumentr_call_t;
+typedef instrumentr_promise_impl_t* instrumentr_promise_t;
+typedef instrumentr_frame_impl_t* instrumentr_frame_t;
+
+/* value */
+
+inline bool instrumentr_value_is_null(instrumentr_value_t value) {
+    return value->kind == MOCK_VALUE_NULL;
+}
+
+inline bool instrumentr_value_is_closure(instrumentr_value_t value) {
+    return value->kind == MOCK_VALUE_CLOSURE;
+}
+
+inline bool instrumentr_value_is_builtin(instrumentr_value_t value) {
+    return value->kind == MOCK_VALUE_BUILTIN;
+}
+
+inline bool instrumentr_value_is_special(instrumentr_value_t value) {
+    return value->kind == MOCK_VALUE_SPECIAL;
+}
+
+inline bool instrumentr_value_is_environment(instrumentr_value_t value) {
+    return value->kind == MOCK_VALUE_ENVIRONMENT;
+}
+
+inline instrumentr_closure_t
+instrumentr_value_as_closure(instrumentr_value_t value) {
+    return static_cast<instrumentr_closure_t>(value);
+}
+
+inline instrumentr_builtin_t
+instrumentr_value_as_builtin(instrumentr_value_t value) {
+    return static_cast<instrumentr_builtin_t>(value);
+}
+
+inline instrumentr_special_t
+instrumentr_value_as_special(instrumentr_value_t value) {
+    return static_cast<instrumentr_special_t>(value);
+}
+
+inline instrumentr_environment_t
+instrumentr_value_as_environment(instrumentr_value_t value) {
+    return static_cast<instrumentr_environment_t>(value);
+}
+
+/* functions */
+
+inline int instrumentr_closure_get_id(instrumentr_closure_t closure) {
+    return closure->id;
+}
+
+inline const char* instrumentr_closure_get_name(instrumentr_closure_t closure) {
+    return closure->name;
+}
+
+inline int instrumentr_builtin_get_id(instrumentr_builtin_t builtin) {
+    return builtin->id;
+}
+
+inline const char* instrumentr_builtin_get_name(instrumentr_builtin_t builtin) {
+    return builtin->name;
+}
+
+inline int instrumentr_special_get_id(instrumentr_special_t special) {
+    return special->id;
+}
+
+inline const char* instrumentr_special_get_name(instrumentr_special_t special) {
+    return special->name;
+}
+
+/* environment */
+
+inline int
+instrumentr_environment_get_id(instrumentr_environment_t environment) {
+    return environment->id;
+}
+
+inline const char*
+instrumentr_environment_get_name(instrumentr_environment_t environment) {
+    return environment->name;
+}
+
+inline instrumentr_environment_type_t
+instrumentr_environment_get_type(instrumentr_environment_t environment) {
+    return environment->type;
+}
+
+inline bool
+instrumentr_environment_is_hashed(instrumentr_environment_t environment) {
+    return environment->hashed;
+}
+
+inline instrumentr_value_t
+instrumentr_environment_get_parent(instrumentr_environment_t environment) {
+    return environment->parent;
+}
+
+inline instrumentr_call_t
+instrumentr_environment_get_call(instrumentr_environment_t environment) {
+    return environment->call;
+}
+
+inline const char*
+instrumentr_environment_type_to_string(instrumentr_environment_type_t type) {
+    switch (type) {
+    case INSTRUMENTR_ENVIRONMENT_TYPE_GLOBAL:
+        return "global";
+    case INSTRUMENTR_ENVIRONMENT_TYPE_BASE:
+        return "base";
+    case INSTRUMENTR_ENVIRONMENT_TYPE_EMPTY:
+        return "empty";
+    case INSTRUMENTR_ENVIRONMENT_TYPE_NAMESPACE:
+        return "namespace";
+    case INSTRUMENTR_ENVIRONMENT_TYPE_PACKAGE:
+        return "package";
+    case INSTRUMENTR_ENVIRONMENT_TYPE_CALL:
+        return "call";
+    default:
+        return "unknown";
+    }
+}
+
+/* call, promise and frame */
+
+inline int instrumentr_call_get_id(instrumentr_call_t call) {
+    return call->id;
+}
+
+inline instrumentr_value_t
+instrumentr_call_get_function(instrumentr_call_t call) {
+    return call->function;
+}
+
+inline int instrumentr_promise_get_id(instrumentr_promise_t promise) {
+    return promise->id;
+}
+
+inline bool instrumentr_frame_is_call(instrumentr_frame_t frame) {
+    return frame->call != nullptr;
+}
+
+inline bool instrumentr_frame_is_promise(instrumentr_frame_t frame) {
+    return frame->promise != nullptr;
+}
+
+inline instrumentr_call_t instrumentr_frame_as_call(instrumentr_frame_t frame) {
+    return frame->call;
+}
+
+inline instrumentr_promise_t
+instrumentr_frame_as_promise(instrumentr_frame_t frame) {
+    return frame->promise;
+}
+
+#endif /* ENVTRACER_BENCH_MOCK_INSTRUMENTR_H */
@@ -0,0 +1,79 @@
+#ifndef ENVTRACER_ANALYSIS_PROFILE_H
+#define ENVTRACER_ANALYSIS_PROFILE_H
+
+#include <cstring>
+
+/* Groups of instrumentr events that can be traced independently. Calls,
+   builtins, packages and the start and end of tracing are always traced
+   since every table depends on them. */
+enum analysis_event_t {
+    ANALYSIS_EVENT_SPECIAL = 1 << 0,
+    ANALYSIS_EVENT_PROMISE = 1 << 1,
+    ANALYSIS_EVENT_VARIABLE = 1 << 2,
+    ANALYSIS_EVENT_GC_ALLOCATION = 1 << 3,
+    ANALYSIS_EVENT_ATTRIBUTE_SET = 1 << 4,
+    ANALYSIS_EVENT_SUBSET = 1 << 5,
+    ANALYSIS_EVENT_EVAL = 1 << 6,
+    ANALYSIS_EVENT_SUBSTITUTE = 1 << 7,
+    ANALYSIS_EVENT_VALUE_FINALIZE = 1 << 8,
+    ANALYSIS_EVENT_ERROR = 1 << 9,
+    ANALYSIS_EVENT_USE_METHOD = 1 << 10
+};
+
+const int ANALYSIS_EVENT_ALL = (1 << 11) - 1;
+
+/* event set of a named event group, 0 if the name is unknown */
+inline int get_analysis_event(const char* name) {
+    static const struct {
+        const char* name;
+        analysis_event_t event;
+    } events[] = {{"special", ANALYSIS_EVENT_SPECIAL},
+                  {"promise", ANALYSIS_EVENT_PROMISE},
+                  {"variable", ANALYSIS_EVENT_VARIABLE},
+                  {"gc_allocation", ANALYSIS_EVENT_GC_ALLOCATION},
+                  {"attribute_set", ANALYSIS_EVENT_ATTRIBUTE_SET},
+                  {"subset", ANALYSIS_EVENT_SUBSET},
+                  {"eval", ANALYSIS_EVENT_EVAL},
+                  {"substitute", ANALYSIS_EVENT_SUBSTITUTE},
+                  {"value_finalize", ANALYSIS_EVENT_VALUE_FINALIZE},
+                  {"error", ANALYSIS_EVENT_ERROR},
+                  {"use_method", ANALYSIS_EVENT_USE_METHOD}};
+
+    for (const auto& entry: events) {
+        if (std::strcmp(entry.name, name) == 0) {
+            return entry.event;
+        }
+    }
+
+    return 0;
+}
+
+/* event set of a named analysis profile, 0 if the name is unknown */
+inline int get_analysis_profile(const char* name) {
+    if (std::strcmp(name, "full") == 0) {
+        return ANALYSIS_EVENT_ALL;
+    }
+
+    /* eval and substitute calls */
+    else if (std::strcmp(name, "metaprogramming") == 0) {
+        return ANALYSIS_EVENT_EVAL | ANALYSIS_EVENT_SUBSTITUTE;
+    }
+
+    /* creation, class and names of environments */
+    else if (std::strcmp(name, "construction") == 0) {
+        return ANALYSIS_EVENT_GC_ALLOCATION | ANALYSIS_EVENT_ATTRIBUTE_SET |
+               ANALYSIS_EVENT_USE_METHOD | ANALYSIS_EVENT_VALUE_FINALIZE;
+    }
+
+    /* reflective reads and writes; variable events are only recorded
+       inside eval, so eval is needed as well */
+    else if (std::strcmp(name, "access") == 0) {
+        return ANALYSIS_EVENT_VARIABLE | ANALYSIS_EVENT_SUBSET |
+               ANALYSIS_EVENT_SPECIAL | ANALYSIS_EVENT_EVAL |
+               ANALYSIS_EVENT_SUBSTITUTE;
+    }
+
+    return 0;
+}
+
+#endif /* ENVTRACER_ANALYSIS_PROFILE_H */
@@ -0,0 +1,197 @@
+#ifndef ENVTRACER_ANALYSIS_WORKER_H
+#define ENVTRACER_ANALYSIS_WORKER_H
+
+#include "SpscRing.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+/* Background thread that appends event records to their tables.
+
+   Callbacks build a record and submit it together with its table as a
+   fixed-size entry of a single-producer single-consumer ring; the worker
+   calls append on the table, which stores or streams the record without
+   using the R API. The R thread only waits when the ring is full.
+
+   Records are allocated from the arena of the tracing state, which is not
+   thread safe. Records that a table has streamed out are therefore handed
+   back through a second ring and released on the R thread. */
+class AnalysisWorker {
+  public:
+    explicit AnalysisWorker(std::size_t capacity = 1 << 16)
+        : events_(capacity)
+        , released_(capacity)
+        , submitted_(0)
+        , processed_(0)
+        , sleeping_(false)
+        , stop_(false) {
+        thread_ = std::thread(&AnalysisWorker::run_, this);
+    }
+
+    ~AnalysisWorker() {
+        try {
+            stop();
+        } catch (const std::exception& e) {
+            /* errors are reported by explicit calls to stop */
+        }
+    }
+
+    AnalysisWorker(const AnalysisWorker&) = delete;
+    AnalysisWorker& operator=(const AnalysisWorker&) = delete;
+
+    /* called on the R thread. Table::append(record) runs on the worker and
+       returns true if the record can be released with Table::release. */
+    template <typename Table, typename Record>
+    void submit(Table* table, Record* record) {
+        Entry entry = {&append_<Table, Record>,
+                       &release_<Table, Record>,
+                       table,
+                       record};
+
+        release_records_();
+
+        while (!events_.try_push(entry)) {
+            release_records_();
+            std::this_thread::yield();
+        }
+
+        ++submitted_;
+
+        if (sleeping_.load()) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            wakeup_.notify_one();
+        }
+    }
+
+    /* waits until every submitted record has been appended */
+    void drain() {
+        wait_();
+        throw_failure_();
+    }
+
+    /* the thread is joined even if an append failed, so that the failure
+       can be rethrown without leaving a joinable thread behind */
+    void stop() {
+        if (!thread_.joinable()) {
+            return;
+        }
+
+        wait_();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+            wakeup_.notify_one();
+        }
+
+        thread_.join();
+
+        throw_failure_();
+    }
+
+  private:
+    struct Entry {
+        bool (*append)(void* table, void* record);
+        void (*release)(void* table, void* record);
+        void* table;
+        void* record;
+    };
+
+    template <typename Table, typename Record>
+    static bool append_(void* table, void* record) {
+        return static_cast<Table*>(table)->append(static_cast<Record*>(record));
+    }
+
+    template <typename Table, typename Record>
+    static void release_(void* table, void* record) {
+        static_cast<Table*>(table)->release(static_cast<Record*>(record));
+    }
+
+    void wait_() {
+        while (processed_.load(std::memory_order_acquire) != submitted_) {
+            release_records_();
+            std::this_thread::yield();
+        }
+
+        release_records_();
+    }
+
+    void throw_failure_() const {
+        if (failed_.load(std::memory_order_acquire)) {
+            throw std::runtime_error(message_);
+        }
+    }
+
+    void release_records_() {
+        Entry entry;
+        while (released_.try_pop(entry)) {
+            entry.release(entry.table, entry.record);
+        }
+    }
+
+    void run_() {
+        Entry entry;
+
+        while (true) {
+            if (events_.try_pop(entry)) {
+                process_(entry);
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(mutex_);
+
+            if (stop_) {
+                return;
+            }
+
+            /* a submit racing with the flag is caught by the timeout */
+            sleeping_.store(true);
+            wakeup_.wait_for(lock, std::chrono::milliseconds(1));
+            sleeping_.store(false);
+        }
+    }
+
+    void process_(const Entry& entry) {
+        bool release = false;
+
+        if (!failed_.load(std::memory_order_relaxed)) {
+            try {
+                release = entry.append(entry.table, entry.record);
+            } catch (const std::exception& e) {
+                message_ = e.what();
+                failed_.store(true, std::memory_order_release);
+                release = true;
+            }
+        } else {
+            release = true;
+        }
+
+        if (release) {
+            while (!released_.try_push(entry)) {
+                std::this_thread::yield();
+            }
+        }
+
+        processed_.fetch_add(1, std::memory_order_release);
+    }
+
+    SpscRing<Entry> events_;
+    SpscRing<Entry> released_;
+    /* only accessed on the R thread */
+    std::size_t submitted_;
+    std::atomic<std::size_t> processed_;
+    std::atomic<bool> sleeping_;
+    std::atomic<bool> failed_{false};
+    std::string message_;
+    bool stop_;
+    std::mutex mutex_;
+    std::condition_variable wakeup_;
+    std::thread thread_;
+};
+
+#endif /* ENVTRACER_ANALYSIS_WORKER_H */
@@ -0,0 +1,116 @@
+#ifndef ENVTRACER_ARENA_H
+#define ENVTRACER_ARENA_H
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <utility>
+#include <vector>
+
+/* Number of records and bytes a table has allocated from the arena. */
+struct ArenaCounter {
+    ArenaCounter(): objects(0), bytes(0) {
+    }
+
+    double objects;
+    double bytes;
+};
+
+/* Bump allocator owning the records of all tables of a tracing state.
+   Memory is carved out of large blocks and only returned to the system
+   when the arena is destroyed. Tables run the destructors of their records
+   through destroy; the memory of a destroyed record is kept on a free list
+   for the next record of the same size, which keeps memory bounded when
+   records are streamed out as soon as they are created. */
+class Arena {
+  public:
+    explicit Arena(std::size_t block_size = 1 << 20)
+        : block_size_(block_size)
+        , current_(nullptr)
+        , remaining_(0)
+        , reserved_(0) {
+    }
+
+    ~Arena() {
+        for (char* block: blocks_) {
+            std::free(block);
+        }
+    }
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    template <typename T, typename... Args>
+    T* create(ArenaCounter& counter, Args&&... args) {
+        static_assert(alignof(T) <= ALIGNMENT, "record is overaligned");
+        void* memory = allocate_(sizeof(T));
+        ++counter.objects;
+        counter.bytes += sizeof(T);
+        return new (memory) T(std::forward<Args>(args)...);
+    }
+
+    template <typename T>
+    void destroy(T* object) {
+        object->~T();
+        release_(object, sizeof(T));
+    }
+
+    std::size_t get_reserved_bytes() const {
+        return reserved_;
+    }
+
+  private:
+    static const std::size_t ALIGNMENT = alignof(std::max_align_t);
+
+    static std::size_t round_(std::size_t size) {
+        return (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    }
+
+    void* allocate_(std::size_t size) {
+        size = round_(size);
+
+        std::size_t index = size / ALIGNMENT;
+
+        if (index < free_lists_.size() && free_lists_[index] != nullptr) {
+            void* memory = free_lists_[index];
+            free_lists_[index] = *static_cast<void**>(memory);
+            return memory;
+        }
+
+        if (size > remaining_) {
+            std::size_t block_size = size > block_size_ ? size : block_size_;
+            current_ = static_cast<char*>(std::malloc(block_size));
+            if (current_ == nullptr) {
+                throw std::bad_alloc();
+            }
+            blocks_.push_back(current_);
+            remaining_ = block_size;
+            reserved_ += block_size;
+        }
+
+        void* memory = current_;
+        current_ += size;
+        remaining_ -= size;
+        return memory;
+    }
+
+    void release_(void* memory, std::size_t size) {
+        std::size_t index = round_(size) / ALIGNMENT;
+
+        if (index >= free_lists_.size()) {
+            free_lists_.resize(index + 1, nullptr);
+        }
+
+        *static_cast<void**>(memory) = free_lists_[index];
+        free_lists_[index] = memory;
+    }
+
+    std::size_t block_size_;
+    char* current_;
+    std::size_t remaining_;
+    std::size_t reserved_;
+    std::vector<char*> blocks_;
+    std::vector<void*> free_lists_;
+};
+
+#endif /* ENVTRACER_ARENA_H */
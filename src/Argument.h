@@ -163,6 +163,7 @@ class Argument {
     }
 
     void to_sexp(int index,
+                 CharCache& cache,
                  SEXP r_arg_id,
                  SEXP r_call_id,
                  SEXP r_fun_id,
@@ -204,7 +205,7 @@ class Argument {
         SET_INTEGER_ELT(r_call_id, index, call_id_);
         SET_INTEGER_ELT(r_fun_id, index, fun_id_);
         SET_INTEGER_ELT(r_call_env_id, index, call_env_id_);
-        SET_STRING_ELT(r_arg_name, index, make_char(arg_name_));
+        SET_STRING_ELT(r_arg_name, index, cache.get(arg_name_));
         SET_INTEGER_ELT(r_formal_pos, index, formal_pos_);
         SET_INTEGER_ELT(r_dot_pos, index, dot_pos_);
         SET_INTEGER_ELT(r_force_pos, index, force_pos_);
@@ -212,9 +213,9 @@ class Argument {
         SET_LOGICAL_ELT(r_default_arg, index, default_arg_);
         SET_LOGICAL_ELT(r_vararg, index, vararg_);
         SET_LOGICAL_ELT(r_missing, index, missing_);
-        SET_STRING_ELT(r_arg_type, index, make_char(arg_type_));
-        SET_STRING_ELT(r_expr_type, index, make_char(expr_type_));
-        SET_STRING_ELT(r_val_type, index, make_char(val_type_));
+        SET_STRING_ELT(r_arg_type, index, cache.get(arg_type_));
+        SET_STRING_ELT(r_expr_type, index, cache.get(expr_type_));
+        SET_STRING_ELT(r_val_type, index, cache.get(val_type_));
         SET_INTEGER_ELT(r_preforced, index, preforced_);
         SET_INTEGER_ELT(r_cap_force, index, cap_force_);
         SET_INTEGER_ELT(r_cap_meta, index, cap_meta_);
@@ -3,7 +3,9 @@
 
 #include <vector>
 #include <string>
+#include "TableStream.h"
 #include <instrumentr/instrumentr.h>
+#include <memory>
 
 class ArgumentReflectionTable {
   public:
@@ -24,7 +26,24 @@ class ArgumentReflectionTable {
                 int call_id,
                 int arg_id,
                 int formal_pos,
-                const std::string& backtrace) {
+                int backtrace) {
+        if (stream_) {
+            stream_->put_int(ref_call_id);
+            stream_->put_string(ref_type);
+            stream_->put_logical(transitive);
+            stream_->put_int(source_fun_id);
+            stream_->put_int(source_call_id);
+            stream_->put_int(source_arg_id);
+            stream_->put_int(source_formal_pos);
+            stream_->put_int(fun_id);
+            stream_->put_int(call_id);
+            stream_->put_int(arg_id);
+            stream_->put_int(formal_pos);
+            stream_->put_int(backtrace);
+            stream_->end_row();
+            return;
+        }
+
         ref_call_id_.push_back(ref_call_id);
         ref_type_.push_back(ref_type);
         transitive_.push_back(transitive);
@@ -39,6 +58,50 @@ class ArgumentReflectionTable {
         backtrace_.push_back(backtrace);
     }
 
+    void enable_streaming(StreamWriter& writer,
+                          const std::string& filepath,
+                          int chunk_size) {
+        stream_.reset(
+            new TableStream(writer, filepath, get_schema(), chunk_size));
+    }
+
+    bool is_streaming() const {
+        return stream_ != nullptr;
+    }
+
+    void close_stream() {
+        stream_->close();
+    }
+
+    static const TableSchema& get_schema() {
+        static const TableSchema schema = {
+            {"ref_call_id",
+             "ref_type",
+             "transitive",
+             "source_fun_id",
+             "source_call_id",
+             "source_arg_id",
+             "source_formal_pos",
+             "fun_id",
+             "call_id",
+             "arg_id",
+             "formal_pos",
+             "backtrace"},
+            {ColumnType::Integer,
+             ColumnType::String,
+             ColumnType::Logical,
+             ColumnType::Integer,
+             ColumnType::Integer,
+             ColumnType::Integer,
+             ColumnType::Integer,
+             ColumnType::Integer,
+             ColumnType::Integer,
+             ColumnType::Integer,
+             ColumnType::Integer,
+             ColumnType::Integer}};
+        return schema;
+    }
+
     SEXP to_sexp() {
         int size = ref_call_id_.size();
 
@@ -53,11 +116,13 @@ class ArgumentReflectionTable {
         SEXP r_call_id = PROTECT(allocVector(INTSXP, size));
         SEXP r_arg_id = PROTECT(allocVector(INTSXP, size));
         SEXP r_formal_pos = PROTECT(allocVector(INTSXP, size));
-        SEXP r_backtrace = PROTECT(allocVector(STRSXP, size));
+        SEXP r_backtrace = PROTECT(allocVector(INTSXP, size));
+
+        CharCache cache;
 
         for (int index = 0; index < size; ++index) {
             SET_INTEGER_ELT(r_ref_call_id, index, ref_call_id_[index]);
-            SET_STRING_ELT(r_ref_type, index, make_char(ref_type_[index]));
+            SET_STRING_ELT(r_ref_type, index, cache.get(ref_type_[index]));
             SET_LOGICAL_ELT(r_transitive, index, transitive_[index]);
             SET_INTEGER_ELT(r_source_fun_id, index, source_fun_id_[index]);
             SET_INTEGER_ELT(r_source_call_id, index, source_call_id_[index]);
@@ -68,7 +133,7 @@ class ArgumentReflectionTable {
             SET_INTEGER_ELT(r_call_id, index, call_id_[index]);
             SET_INTEGER_ELT(r_arg_id, index, arg_id_[index]);
             SET_INTEGER_ELT(r_formal_pos, index, formal_pos_[index]);
-            SET_STRING_ELT(r_backtrace, index, make_char(backtrace_[index]));
+            SET_INTEGER_ELT(r_backtrace, index, backtrace_[index]);
         }
 
         std::vector<SEXP> columns({r_ref_call_id,
@@ -84,18 +149,7 @@ class ArgumentReflectionTable {
                                    r_formal_pos,
                                    r_backtrace});
 
-        std::vector<std::string> names({"ref_call_id",
-                                        "ref_type",
-                                        "transitive",
-                                        "source_fun_id",
-                                        "source_call_id",
-                                        "source_arg_id",
-                                        "source_formal_pos",
-                                        "fun_id",
-                                        "call_id",
-                                        "arg_id",
-                                        "formal_pos",
-                                        "backtrace"});
+        const std::vector<std::string>& names = get_schema().names;
 
         SEXP df = create_data_frame(names, columns);
 
@@ -105,6 +159,7 @@ class ArgumentReflectionTable {
     }
 
   private:
+    std::unique_ptr<TableStream> stream_;
     std::vector<int> ref_call_id_;
     std::vector<std::string> ref_type_;
     std::vector<bool> transitive_;
@@ -116,7 +171,7 @@ class ArgumentReflectionTable {
     std::vector<int> call_id_;
     std::vector<int> arg_id_;
     std::vector<int> formal_pos_;
-    std::vector<std::string> backtrace_;
+    std::vector<int> backtrace_;
 };
 
 #endif /* ENVTRACER_ARGUMENT_REFLECTION_TABLE_H */
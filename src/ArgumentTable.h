@@ -1,6 +1,8 @@
 #ifndef ENVTRACER_ARGUMENT_TABLE_H
 #define ENVTRACER_ARGUMENT_TABLE_H
 
+#include "CallbackProfiler.h"
+#include "Arena.h"
 #include "Argument.h"
 #include "Environment.h"
 #include "Function.h"
@@ -13,13 +15,13 @@
 
 class ArgumentTable {
   public:
-    ArgumentTable(): size_(0) {
+    explicit ArgumentTable(Arena& arena): arena_(arena), size_(0) {
     }
 
     ~ArgumentTable() {
         for (auto iter = table_.begin(); iter != table_.end(); ++iter) {
             for (auto& argument: iter->second) {
-                delete argument;
+                arena_.destroy(argument);
             }
         }
         table_.clear();
@@ -31,6 +33,8 @@ class ArgumentTable {
                 Call* call_data,
                 Function* function_data,
                 Environment* environment_data) {
+        ProfileScope scope(PROFILE_PHASE_ARGUMENT_INSERT);
+
         int dot_pos = NA_INTEGER;
 
         if (arg_name == "..." || instrumentr_value_is_dot(argument)) {
@@ -153,6 +157,8 @@ class ArgumentTable {
         SEXP r_parent_call_id = PROTECT(allocVector(INTSXP, size_));
         SEXP r_parent_arg_id = PROTECT(allocVector(INTSXP, size_));
 
+        CharCache cache;
+
         int index = 0;
 
         for (auto iter = table_.begin(); iter != table_.end(); ++iter) {
@@ -160,6 +166,7 @@ class ArgumentTable {
 
             for (Argument* argument: arguments) {
                 argument->to_sexp(index,
+                                  cache,
                                   r_arg_id,
                                   r_call_id,
                                   r_fun_id,
@@ -284,7 +291,13 @@ class ArgumentTable {
         return df;
     }
 
+    const ArenaCounter& get_allocations() const {
+        return allocations_;
+    }
+
   private:
+    Arena& arena_;
+    ArenaCounter allocations_;
     std::unordered_map<int, std::vector<Argument*>> table_;
     int size_;
 
@@ -307,20 +320,22 @@ class ArgumentTable {
         int dot_pos = 0;
         int default_arg = NA_LOGICAL;
 
-        Argument* argument_data = new Argument(arg_id,
-                                               call_id,
-                                               fun_id,
-                                               call_env_id,
-                                               arg_name,
-                                               formal_pos,
-                                               dot_pos,
-                                               default_arg,
-                                               vararg,
-                                               missing,
-                                               arg_type,
-                                               expr_type,
-                                               val_type,
-                                               preforced);
+        Argument* argument_data =
+            arena_.create<Argument>(allocations_,
+                                    arg_id,
+                                    call_id,
+                                    fun_id,
+                                    call_env_id,
+                                    arg_name,
+                                    formal_pos,
+                                    dot_pos,
+                                    default_arg,
+                                    vararg,
+                                    missing,
+                                    arg_type,
+                                    expr_type,
+                                    val_type,
+                                    preforced);
 
         insert_(argument_data);
     }
@@ -344,20 +359,22 @@ class ArgumentTable {
         int preforced = 0;
         int default_arg = NA_LOGICAL;
 
-        Argument* argument_data = new Argument(arg_id,
-                                               call_id,
-                                               fun_id,
-                                               call_env_id,
-                                               arg_name,
-                                               formal_pos,
-                                               dot_pos,
-                                               default_arg,
-                                               vararg,
-                                               missing,
-                                               arg_type,
-                                               expr_type,
-                                               val_type,
-                                               preforced);
+        Argument* argument_data =
+            arena_.create<Argument>(allocations_,
+                                    arg_id,
+                                    call_id,
+                                    fun_id,
+                                    call_env_id,
+                                    arg_name,
+                                    formal_pos,
+                                    dot_pos,
+                                    default_arg,
+                                    vararg,
+                                    missing,
+                                    arg_type,
+                                    expr_type,
+                                    val_type,
+                                    preforced);
 
         insert_(argument_data);
     }
@@ -391,20 +408,22 @@ class ArgumentTable {
         std::string val_type = instrumentr_value_type_get_name(prom_val_type);
         int preforced = instrumentr_promise_is_forced(promise);
 
-        Argument* argument_data = new Argument(arg_id,
-                                               call_id,
-                                               fun_id,
-                                               call_env_id,
-                                               arg_name,
-                                               formal_pos,
-                                               dot_pos,
-                                               default_arg,
-                                               vararg,
-                                               missing,
-                                               arg_type,
-                                               expr_type,
-                                               val_type,
-                                               preforced);
+        Argument* argument_data =
+            arena_.create<Argument>(allocations_,
+                                    arg_id,
+                                    call_id,
+                                    fun_id,
+                                    call_env_id,
+                                    arg_name,
+                                    formal_pos,
+                                    dot_pos,
+                                    default_arg,
+                                    vararg,
+                                    missing,
+                                    arg_type,
+                                    expr_type,
+                                    val_type,
+                                    preforced);
 
         insert_(argument_data);
     }
@@ -429,20 +448,22 @@ class ArgumentTable {
         int preforced = 0;
         int default_arg = NA_LOGICAL;
 
-        Argument* argument_data = new Argument(arg_id,
-                                               call_id,
-                                               fun_id,
-                                               call_env_id,
-                                               arg_name,
-                                               formal_pos,
-                                               dot_pos,
-                                               default_arg,
-                                               vararg,
-                                               missing,
-                                               arg_type,
-                                               expr_type,
-                                               val_type,
-                                               preforced);
+        Argument* argument_data =
+            arena_.create<Argument>(allocations_,
+                                    arg_id,
+                                    call_id,
+                                    fun_id,
+                                    call_env_id,
+                                    arg_name,
+                                    formal_pos,
+                                    dot_pos,
+                                    default_arg,
+                                    vararg,
+                                    missing,
+                                    arg_type,
+                                    expr_type,
+                                    val_type,
+                                    preforced);
 
         insert_(argument_data);
     }
@@ -1,24 +1,63 @@
 #ifndef ENVTRACER_BACKTRACE_H
 #define ENVTRACER_BACKTRACE_H
 
+#include "CallbackProfiler.h"
 #include "utilities.h"
+#include "TableStream.h"
 #include <instrumentr/instrumentr.h>
+#include <cstdint>
+#include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
+/* Backtraces are interned in a trie of frames. Each node stores a pointer
+   to its parent node and the textual representation of its own frame.
+   push and pop move the current node up and down the trie; events only
+   store the 32-bit id of the current node. The root node (id 0) represents
+   the empty backtrace. When streaming, nodes are written out as they are
+   created and only the nodes of the current backtrace are retained. */
 class Backtrace {
   public:
-    Backtrace() {
+    Backtrace(): current_(0), node_count_(1) {
+        parents_.push_back(NA_INTEGER);
+        frames_.push_back(ENVTRACER_NA_STRING);
     }
 
+    int get_node_id() const {
+        return current_;
+    }
+
+    /* popping the empty backtrace, as after an unbalanced exit, keeps it
+       empty; its exported parent is NA and must not become current */
     void pop() {
-        backtrace_.pop_back();
+        if (current_ == 0) {
+            return;
+        }
+
+        if (!stream_) {
+            current_ = parents_[current_];
+            return;
+        }
+
+        /* call and promise ids are not reused, so the popped node is not
+           entered again */
+        children_.erase(path_.back().key);
+        path_.pop_back();
+        current_ = path_.back().node;
     }
 
     void push(instrumentr_call_t call) {
-        std::string frame;
+        ProfileScope scope(PROFILE_PHASE_BACKTRACE_PUSH);
 
         int call_id = instrumentr_call_get_id(call);
+
+        if (enter_child_(CALL_FRAME, call_id)) {
+            return;
+        }
+
+        std::string frame;
+
         instrumentr_value_t function = instrumentr_call_get_function(call);
 
         frame.append("list(call_id = ");
@@ -39,7 +78,7 @@ class Backtrace {
 
         frame.append(")");
 
-        backtrace_.push_back(frame);
+        add_child_(CALL_FRAME, call_id, frame);
     }
 
     void push(instrumentr_frame_t frame) {
@@ -54,21 +93,114 @@ class Backtrace {
         }
     }
 
-    std::string to_string() const {
-        std::string backtrace("list(");
+    /* streaming is enabled before tracing starts, when the trie only
+       holds the root node. */
+    void enable_streaming(StreamWriter& writer,
+                          const std::string& filepath,
+                          int chunk_size) {
+        stream_.reset(
+            new TableStream(writer, filepath, get_schema(), chunk_size));
 
-        for (int i = 0; i < backtrace_.size(); ++i) {
-            backtrace.append(backtrace_[i]);
-            if (i != backtrace_.size() - 1) {
-                backtrace.append(",\n");
-            }
+        write_node_(0, NA_INTEGER, frames_[0]);
+
+        parents_.clear();
+        frames_.clear();
+        path_.push_back({0, 0});
+    }
+
+    bool is_streaming() const {
+        return stream_ != nullptr;
+    }
+
+    void close_stream() {
+        stream_->close();
+    }
+
+    static const TableSchema& get_schema() {
+        static const TableSchema schema = {
+            {"node_id", "parent_node_id", "frame"},
+            {ColumnType::Integer, ColumnType::Integer, ColumnType::String}};
+        return schema;
+    }
+
+    SEXP to_sexp() {
+        int size = parents_.size();
+
+        SEXP r_node_id = PROTECT(allocVector(INTSXP, size));
+        SEXP r_parent_node_id = PROTECT(allocVector(INTSXP, size));
+        SEXP r_frame = PROTECT(allocVector(STRSXP, size));
+
+        for (int index = 0; index < size; ++index) {
+            SET_INTEGER_ELT(r_node_id, index, index);
+            SET_INTEGER_ELT(r_parent_node_id, index, parents_[index]);
+            SET_STRING_ELT(r_frame, index, make_char(frames_[index]));
         }
 
-        backtrace.append(")");
-        return backtrace;
+        std::vector<SEXP> columns({r_node_id, r_parent_node_id, r_frame});
+
+        const std::vector<std::string>& names = get_schema().names;
+
+        SEXP df = create_data_frame(names, columns);
+
+        UNPROTECT(3);
+
+        return df;
     }
 
   private:
+    enum frame_kind_t { CALL_FRAME = 0, PROMISE_FRAME = 1 };
+
+    /* node of the current backtrace and its key in children_ */
+    struct PathNode {
+        int node;
+        std::uint64_t key;
+    };
+
+    /* call and promise ids are unique, so (parent, kind, id) identifies
+       a child without formatting its frame. */
+    std::uint64_t make_key_(frame_kind_t kind, int id) const {
+        return (static_cast<std::uint64_t>(current_) << 33) |
+               (static_cast<std::uint64_t>(kind) << 32) |
+               static_cast<std::uint32_t>(id);
+    }
+
+    /* moves to the child if it exists */
+    bool enter_child_(frame_kind_t kind, int id) {
+        std::uint64_t key = make_key_(kind, id);
+        auto iter = children_.find(key);
+
+        if (iter == children_.end()) {
+            return false;
+        }
+
+        current_ = iter->second;
+        if (stream_) {
+            path_.push_back({current_, key});
+        }
+        return true;
+    }
+
+    void add_child_(frame_kind_t kind, int id, const std::string& frame) {
+        int child = node_count_++;
+        std::uint64_t key = make_key_(kind, id);
+        if (stream_) {
+            write_node_(child, current_, frame);
+            path_.push_back({child, key});
+        } else {
+            parents_.push_back(current_);
+            frames_.push_back(frame);
+        }
+        children_.insert({key, child});
+        current_ = child;
+    }
+
+    void write_node_(int node, int parent, const std::string& frame) {
+        stream_->put_int(node);
+        stream_->put_int(parent);
+        stream_->put_string(frame);
+        stream_->end_row();
+    }
+
     void push_closure_(instrumentr_closure_t closure, std::string& frame) {
         int fun_id = instrumentr_closure_get_id(closure);
         const char* name = instrumentr_closure_get_name(closure);
@@ -103,16 +235,28 @@ class Backtrace {
     }
 
     void push_promise_(instrumentr_promise_t promise) {
-        std::string frame;
         int id = instrumentr_promise_get_id(promise);
+
+        if (enter_child_(PROMISE_FRAME, id)) {
+            return;
+        }
+
+        std::string frame;
         frame.append("list(prom_id = ");
         frame.append(std::to_string(id));
         frame.append(")");
 
-        backtrace_.push_back(frame);
+        add_child_(PROMISE_FRAME, id, frame);
     }
 
-    std::vector<std::string> backtrace_;
+    int current_;
+    int node_count_;
+    std::vector<int> parents_;
+    std::vector<std::string> frames_;
+    std::unordered_map<std::uint64_t, int> children_;
+    /* current backtrace from the root, only kept when streaming */
+    std::vector<PathNode> path_;
+    std::unique_ptr<TableStream> stream_;
 };
 
 #endif /* ENVTRACER_BACKTRACE_H */
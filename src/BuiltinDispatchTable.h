@@ -0,0 +1,109 @@
+#ifndef ENVTRACER_BUILTIN_DISPATCH_TABLE_H
+#define ENVTRACER_BUILTIN_DISPATCH_TABLE_H
+
+#include "utilities.h"
+#include "IdBitset.h"
+#include <instrumentr/instrumentr.h>
+#include <string>
+#include <unordered_map>
+
+/* Builtins handled by the builtin call exit callback. Builtins with the
+   same argument handling share a kind. */
+enum builtin_kind_t {
+    BUILTIN_IRRELEVANT = 0,
+    BUILTIN_ENV_ARG,
+    BUILTIN_LIST2ENV,
+    BUILTIN_AS_ENVIRONMENT,
+    BUILTIN_SYS_WHICH,
+    BUILTIN_SYS_N,
+    BUILTIN_SYS_OTHER,
+    BUILTIN_SYS_FRAMES,
+    BUILTIN_ENVIRONMENT,
+    BUILTIN_ENVIRONMENT_ASSIGN,
+    BUILTIN_LOCK_ENVIRONMENT,
+    BUILTIN_LOCK_BINDING,
+    BUILTIN_ENVIRONMENT_NAME,
+    BUILTIN_PARENT_ENV_ASSIGN,
+    BUILTIN_PARENT_ENV,
+    BUILTIN_SPECIAL_ENV,
+    BUILTIN_NEW_ENV
+};
+
+/* Maps builtin ids to their kind. The names of relevant builtins are
+   registered once when tracing starts; a builtin's name is only compared
+   the first time its id is seen. After that, an irrelevant builtin is
+   rejected with two bit tests. */
+class BuiltinDispatchTable {
+  public:
+    BuiltinDispatchTable() {
+        add_("length", BUILTIN_ENV_ARG);
+        add_("env2list", BUILTIN_ENV_ARG);
+        add_("list2env", BUILTIN_LIST2ENV);
+        add_("as.environment", BUILTIN_AS_ENVIRONMENT);
+        add_("pos.to.env", BUILTIN_AS_ENVIRONMENT);
+        add_("sys.call", BUILTIN_SYS_WHICH);
+        add_("sys.frame", BUILTIN_SYS_WHICH);
+        add_("sys.function", BUILTIN_SYS_WHICH);
+        add_("sys.parent", BUILTIN_SYS_N);
+        add_("parent.frame", BUILTIN_SYS_N);
+        add_("sys.calls", BUILTIN_SYS_OTHER);
+        add_("sys.parents", BUILTIN_SYS_OTHER);
+        add_("sys.on.exit", BUILTIN_SYS_OTHER);
+        add_("sys.status", BUILTIN_SYS_OTHER);
+        add_("sys.nframe", BUILTIN_SYS_OTHER);
+        add_("sys.frames", BUILTIN_SYS_FRAMES);
+        add_("environment", BUILTIN_ENVIRONMENT);
+        add_("environment<-", BUILTIN_ENVIRONMENT_ASSIGN);
+        add_("lockEnvironment", BUILTIN_LOCK_ENVIRONMENT);
+        add_("lockBinding", BUILTIN_LOCK_BINDING);
+        add_("unlockBinding", BUILTIN_LOCK_BINDING);
+        add_("environmentName", BUILTIN_ENVIRONMENT_NAME);
+        add_("parent.env<-", BUILTIN_PARENT_ENV_ASSIGN);
+        add_("parent.env", BUILTIN_PARENT_ENV);
+        add_("emptyenv", BUILTIN_SPECIAL_ENV);
+        add_("baseenv", BUILTIN_SPECIAL_ENV);
+        add_("globalenv", BUILTIN_SPECIAL_ENV);
+        add_("new.env", BUILTIN_NEW_ENV);
+    }
+
+    builtin_kind_t lookup(instrumentr_builtin_t builtin) {
+        int id = instrumentr_builtin_get_id(builtin);
+
+        if (!resolved_.contains(id)) {
+            resolve_(id, instrumentr_builtin_get_name(builtin));
+        }
+
+        if (!relevant_.contains(id)) {
+            return BUILTIN_IRRELEVANT;
+        }
+
+        return kinds_[id];
+    }
+
+  private:
+    void add_(const char* name, builtin_kind_t kind) {
+        names_.insert({name, kind});
+    }
+
+    void resolve_(int id, const char* name) {
+        resolved_.insert(id);
+
+        if (name == NULL) {
+            return;
+        }
+
+        auto iter = names_.find(name);
+
+        if (iter != names_.end()) {
+            relevant_.insert(id);
+            kinds_[id] = iter->second;
+        }
+    }
+
+    std::unordered_map<std::string, builtin_kind_t> names_;
+    IdBitset resolved_;
+    IdBitset relevant_;
+    std::unordered_map<int, builtin_kind_t> kinds_;
+};
+
+#endif /* ENVTRACER_BUILTIN_DISPATCH_TABLE_H */
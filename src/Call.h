@@ -4,10 +4,11 @@
 #include <string>
 #include <vector>
 #include "utilities.h"
+#include "TableStream.h"
 
 class Call {
   public:
-    Call(int call_id, int fun_id, int call_env_id, const std::string& call_expr)
+    Call(int call_id, int fun_id, int call_env_id, int call_site_id)
         : call_id_(call_id)
         , fun_id_(fun_id)
         , call_env_id_(call_env_id)
@@ -16,7 +17,8 @@ class Call {
         , force_order_({})
         , exit_(false)
         , esc_env_(0)
-        , call_expr_(call_expr) {
+        , call_site_id_(call_site_id)
+        , sample_weight_(1) {
     }
 
     int get_id() {
@@ -49,7 +51,13 @@ class Call {
         return fun_id_;
     }
 
+    /* number of calls this call stands for when calls are sampled */
+    void set_sample_weight(double sample_weight) {
+        sample_weight_ = sample_weight;
+    }
+
     void to_sexp(int position,
+                 CharCache& cache,
                  SEXP r_call_id,
                  SEXP r_fun_id,
                  SEXP r_call_env_id,
@@ -57,16 +65,31 @@ class Call {
                  SEXP r_result_type,
                  SEXP r_force_order,
                  SEXP r_esc_env,
-                 SEXP r_call_expr) {
+                 SEXP r_call_site_id,
+                 SEXP r_sample_weight) {
         SET_INTEGER_ELT(r_call_id, position, call_id_);
         SET_INTEGER_ELT(r_fun_id, position, fun_id_);
         SET_INTEGER_ELT(r_call_env_id, position, call_env_id_);
         SET_LOGICAL_ELT(r_successful, position, successful_);
-        SET_STRING_ELT(r_result_type, position, make_char(result_type_));
+        SET_STRING_ELT(r_result_type, position, cache.get(result_type_));
         SET_STRING_ELT(
             r_force_order, position, make_char(to_string(force_order_)));
         SET_INTEGER_ELT(r_esc_env, position, esc_env_);
-        SET_STRING_ELT(r_call_expr, position, make_char(call_expr_));
+        SET_INTEGER_ELT(r_call_site_id, position, call_site_id_);
+        SET_REAL_ELT(r_sample_weight, position, sample_weight_);
+    }
+
+    void to_stream(TableStream& stream) const {
+        stream.put_int(call_id_);
+        stream.put_int(fun_id_);
+        stream.put_int(call_env_id_);
+        stream.put_logical(successful_);
+        stream.put_string(result_type_);
+        stream.put_string(to_string(force_order_));
+        stream.put_int(esc_env_);
+        stream.put_int(call_site_id_);
+        stream.put_double(sample_weight_);
+        stream.end_row();
     }
 
   private:
@@ -78,7 +101,9 @@ class Call {
     std::vector<int> force_order_;
     bool exit_;
     int esc_env_;
-    std::string call_expr_;
+    /* id in CallSiteTable */
+    int call_site_id_;
+    double sample_weight_;
 };
 
 #endif /* ENVTRACER_CALL_H */
@@ -3,7 +3,9 @@
 
 #include <vector>
 #include <string>
+#include "TableStream.h"
 #include <instrumentr/instrumentr.h>
+#include <memory>
 
 class CallReflectionTable {
   public:
@@ -22,6 +24,20 @@ class CallReflectionTable {
                 int sink_arg_id,
                 int sink_formal_pos,
                 int depth) {
+        if (stream_) {
+            stream_->put_int(ref_call_id);
+            stream_->put_string(ref_type);
+            stream_->put_int(source_fun_id);
+            stream_->put_int(source_call_id);
+            stream_->put_int(sink_fun_id);
+            stream_->put_int(sink_call_id);
+            stream_->put_int(sink_arg_id);
+            stream_->put_int(sink_formal_pos);
+            stream_->put_int(depth);
+            stream_->end_row();
+            return;
+        }
+
         ref_call_id_.push_back(ref_call_id);
         ref_type_.push_back(ref_type);
         source_fun_id_.push_back(source_fun_id);
@@ -33,6 +49,44 @@ class CallReflectionTable {
         depth_.push_back(depth);
     }
 
+    void enable_streaming(StreamWriter& writer,
+                          const std::string& filepath,
+                          int chunk_size) {
+        stream_.reset(
+            new TableStream(writer, filepath, get_schema(), chunk_size));
+    }
+
+    bool is_streaming() const {
+        return stream_ != nullptr;
+    }
+
+    void close_stream() {
+        stream_->close();
+    }
+
+    static const TableSchema& get_schema() {
+        static const TableSchema schema = {
+            {"ref_call_id",
+             "ref_type",
+             "source_fun_id",
+             "source_call_id",
+             "sink_fun_id",
+             "sink_call_id",
+             "sink_arg_id",
+             "sink_formal_pos",
+             "depth"},
+            {ColumnType::Integer,
+             ColumnType::String,
+             ColumnType::Integer,
+             ColumnType::Integer,
+             ColumnType::Integer,
+             ColumnType::Integer,
+             ColumnType::Integer,
+             ColumnType::Integer,
+             ColumnType::Integer}};
+        return schema;
+    }
+
     SEXP to_sexp() {
         int size = ref_type_.size();
 
@@ -46,9 +100,11 @@ class CallReflectionTable {
         SEXP r_sink_formal_pos = PROTECT(allocVector(INTSXP, size));
         SEXP r_depth = PROTECT(allocVector(INTSXP, size));
 
+        CharCache cache;
+
         for (int index = 0; index < size; ++index) {
             SET_INTEGER_ELT(r_ref_call_id, index, ref_call_id_[index]);
-            SET_STRING_ELT(r_ref_type, index, make_char(ref_type_[index]));
+            SET_STRING_ELT(r_ref_type, index, cache.get(ref_type_[index]));
             SET_INTEGER_ELT(r_source_fun_id, index, source_fun_id_[index]);
             SET_INTEGER_ELT(r_source_call_id, index, source_call_id_[index]);
             SET_INTEGER_ELT(r_sink_fun_id, index, sink_fun_id_[index]);
@@ -68,15 +124,7 @@ class CallReflectionTable {
                                    r_sink_formal_pos,
                                    r_depth});
 
-        std::vector<std::string> names({"ref_call_id",
-                                        "ref_type",
-                                        "source_fun_id",
-                                        "source_call_id",
-                                        "sink_fun_id",
-                                        "sink_call_id",
-                                        "sink_arg_id",
-                                        "sink_formal_pos",
-                                        "depth"});
+        const std::vector<std::string>& names = get_schema().names;
 
         SEXP df = create_data_frame(names, columns);
 
@@ -86,6 +134,7 @@ class CallReflectionTable {
     }
 
   private:
+    std::unique_ptr<TableStream> stream_;
     std::vector<int> ref_call_id_;
     std::vector<std::string> ref_type_;
     std::vector<int> source_fun_id_;
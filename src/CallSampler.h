@@ -0,0 +1,159 @@
+#ifndef ENVTRACER_CALL_SAMPLER_H
+#define ENVTRACER_CALL_SAMPLER_H
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <instrumentr/instrumentr.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/* Sampling parameters, see trace_sampling in R/tracer.R. */
+struct SamplingSpec {
+    SamplingSpec(): rate(1), window(0), period(0), seed(0) {
+    }
+
+    bool is_enabled() const {
+        return rate > 1 || !function_rates.empty() ||
+               (window > 0 && period > window);
+    }
+
+    /* a closure call is sampled with probability 1 / rate */
+    int rate;
+    /* calls are only sampled in the first window seconds of every period */
+    double window;
+    double period;
+    /* rates of functions sampled differently than the others */
+    std::unordered_map<std::string, int> function_rates;
+    std::uint64_t seed;
+};
+
+/* Decides which closure calls are traced. Every closure call is drawn on
+   entry with the probability of its function, if it is made in a sampling
+   window, independently of the calls it is nested in. The events of a
+   call, up to the entry of its nested calls, are traced only if the call
+   is sampled; events outside of any call are always traced.
+
+   Every traced event carries the weight of the call it happens in, the
+   inverse of the probability with which that call was sampled, so that
+   counts can be scaled back up. */
+class CallSampler {
+  public:
+    explicit CallSampler(const SamplingSpec& spec)
+        : spec_(spec)
+        , enabled_(spec.is_enabled())
+        , random_(spec.seed * 2 + 1)
+        , start_(std::chrono::steady_clock::now()) {
+        windowed_ = spec.window > 0 && spec.period > spec.window;
+    }
+
+    bool is_enabled() const {
+        return enabled_;
+    }
+
+    /* true if events are currently not traced */
+    bool is_muted() const {
+        return enabled_ && !weights_.empty() && weights_.back() == 0;
+    }
+
+    /* weight of the events currently traced */
+    double get_weight() const {
+        return weights_.empty() ? 1 : weights_.back();
+    }
+
+    /* called on closure entry, returns true if the call is traced */
+    bool enter_closure(instrumentr_closure_t closure) {
+        if (!enabled_) {
+            return true;
+        }
+
+        int rate = get_rate_(closure);
+
+        if (!in_window_() || !draw_(rate)) {
+            weights_.push_back(0);
+            return false;
+        }
+
+        weights_.push_back(windowed_ ? rate * spec_.period / spec_.window
+                                     : rate);
+        return true;
+    }
+
+    /* called on closure exit, returns true if the matching entry was
+       traced */
+    bool exit_closure() {
+        if (!enabled_) {
+            return true;
+        }
+
+        if (weights_.empty()) {
+            return false;
+        }
+
+        bool sampled = weights_.back() != 0;
+        weights_.pop_back();
+        return sampled;
+    }
+
+  private:
+    int get_rate_(instrumentr_closure_t closure) {
+        if (spec_.function_rates.empty()) {
+            return spec_.rate;
+        }
+
+        int id = instrumentr_closure_get_id(closure);
+
+        if (id >= static_cast<int>(rates_.size())) {
+            rates_.resize(id + 1, 0);
+        }
+
+        /* names are only compared the first time a closure is seen */
+        if (rates_[id] == 0) {
+            const char* name = instrumentr_closure_get_name(closure);
+            auto iter = name == NULL ? spec_.function_rates.end()
+                                     : spec_.function_rates.find(name);
+            rates_[id] = iter == spec_.function_rates.end() ? spec_.rate
+                                                            : iter->second;
+        }
+
+        return rates_[id];
+    }
+
+    bool in_window_() const {
+        if (!windowed_) {
+            return true;
+        }
+
+        std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start_;
+
+        return std::fmod(elapsed.count(), spec_.period) < spec_.window;
+    }
+
+    /* true with probability 1 / rate */
+    bool draw_(int rate) {
+        if (rate <= 1) {
+            return true;
+        }
+
+        /* xorshift64* */
+        random_ ^= random_ >> 12;
+        random_ ^= random_ << 25;
+        random_ ^= random_ >> 27;
+        std::uint64_t value = random_ * 0x2545F4914F6CDD1DULL;
+
+        return (value >> 11) % rate == 0;
+    }
+
+    SamplingSpec spec_;
+    bool enabled_;
+    bool windowed_;
+    std::uint64_t random_;
+    /* weight of every closure call on the stack, 0 if it is not sampled */
+    std::vector<double> weights_;
+    std::vector<int> rates_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+#endif /* ENVTRACER_CALL_SAMPLER_H */
@@ -0,0 +1,115 @@
+#ifndef ENVTRACER_CALL_SITE_TABLE_H
+#define ENVTRACER_CALL_SITE_TABLE_H
+
+#include "utilities.h"
+#include "structural_hash.h"
+#include <instrumentr/instrumentr.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/* Distinct call expressions. Calls from the same call site share their
+   language object, so a call is first looked up by the identity of its
+   expression. Other expressions, such as the fresh ones built by do.call
+   or as.call for every call, are matched by their language structure,
+   ignoring the data of inlined values (see same_sexp_structure). Only
+   the first expression of each call site is preserved and used as an
+   identity key, so the keys' addresses are not reused and structurally
+   matched expressions are not kept alive. Expressions are only deparsed
+   when the table is exported. */
+class CallSiteTable {
+  public:
+    CallSiteTable(): r_expressions_(R_NilValue) {
+    }
+
+    ~CallSiteTable() {
+        if (r_expressions_ != R_NilValue) {
+            R_ReleaseObject(r_expressions_);
+        }
+    }
+
+    /* id of the call site of r_call_expr */
+    int insert(SEXP r_call_expr) {
+        auto iter = identities_.find(r_call_expr);
+
+        if (iter != identities_.end()) {
+            return iter->second;
+        }
+
+        std::size_t hash = hash_sexp_structure(r_call_expr, 0);
+
+        int call_site_id = find_structure_(r_call_expr, hash);
+
+        if (call_site_id != -1) {
+            return call_site_id;
+        }
+
+        call_site_id = expressions_.size();
+        expressions_.push_back(r_call_expr);
+        structures_.insert({hash, call_site_id});
+
+        preserve_(r_call_expr);
+        identities_.insert({r_call_expr, call_site_id});
+
+        return call_site_id;
+    }
+
+    int size() const {
+        return expressions_.size();
+    }
+
+    SEXP to_sexp() {
+        int size = expressions_.size();
+
+        SEXP r_call_site_id = PROTECT(allocVector(INTSXP, size));
+        SEXP r_call_expr = PROTECT(allocVector(STRSXP, size));
+
+        for (int index = 0; index < size; ++index) {
+            std::vector<std::string> call_exprs =
+                instrumentr_sexp_to_string(expressions_[index], true);
+
+            SET_INTEGER_ELT(r_call_site_id, index, index);
+            SET_STRING_ELT(r_call_expr, index, make_char(call_exprs.front()));
+        }
+
+        std::vector<SEXP> columns({r_call_site_id, r_call_expr});
+
+        std::vector<std::string> names({"call_site_id", "call_expr"});
+
+        SEXP df = create_data_frame(names, columns);
+
+        UNPROTECT(2);
+
+        return df;
+    }
+
+  private:
+    int find_structure_(SEXP r_call_expr, std::size_t hash) {
+        auto range = structures_.equal_range(hash);
+
+        for (auto iter = range.first; iter != range.second; ++iter) {
+            if (same_sexp_structure(expressions_[iter->second], r_call_expr)) {
+                return iter->second;
+            }
+        }
+
+        return -1;
+    }
+
+    void preserve_(SEXP r_call_expr) {
+        if (r_expressions_ == R_NilValue) {
+            r_expressions_ = CONS(R_NilValue, R_NilValue);
+            R_PreserveObject(r_expressions_);
+        }
+
+        SETCDR(r_expressions_, CONS(r_call_expr, CDR(r_expressions_)));
+    }
+
+    /* pairlist of expressions, preserved while tracing */
+    SEXP r_expressions_;
+    std::vector<SEXP> expressions_;
+    std::unordered_map<SEXP, int> identities_;
+    std::unordered_multimap<std::size_t, int> structures_;
+};
+
+#endif /* ENVTRACER_CALL_SITE_TABLE_H */
@@ -1,31 +1,33 @@
 #ifndef ENVTRACER_CALL_TABLE_H
 #define ENVTRACER_CALL_TABLE_H
 
+#include "CallbackProfiler.h"
+#include "Arena.h"
 #include "Call.h"
+#include "CallSiteTable.h"
+#include "TableStream.h"
 #include <unordered_map>
 #include "Function.h"
 #include "Environment.h"
 #include <instrumentr/instrumentr.h>
+#include <memory>
 
 class CallTable {
   public:
-    CallTable() {
+    explicit CallTable(Arena& arena): arena_(arena) {
     }
 
     ~CallTable() {
         for (auto iter = table_.begin(); iter != table_.end(); ++iter) {
-            delete iter->second;
+            arena_.destroy(iter->second);
         }
         table_.clear();
     }
 
     Call* insert(instrumentr_call_t call, Function* function) {
-        int call_id = instrumentr_call_get_id(call);
-
-        instrumentr_environment_t environment =
-            instrumentr_call_get_environment(call);
+        ProfileScope scope(PROFILE_PHASE_CALL_INSERT);
 
-        int env_id = instrumentr_environment_get_id(environment);
+        int call_id = instrumentr_call_get_id(call);
 
         auto iter = table_.find(call_id);
 
@@ -33,16 +35,22 @@ class CallTable {
             return iter->second;
         }
 
+        instrumentr_environment_t environment =
+            instrumentr_call_get_environment(call);
+
+        int env_id = instrumentr_environment_get_id(environment);
+
         instrumentr_language_t call_expr =
             instrumentr_call_get_expression(call);
 
-        SEXP r_call_expr = instrumentr_language_get_sexp(call_expr);
-
-        std::vector<std::string> call_exprs =
-            instrumentr_sexp_to_string(r_call_expr, true);
+        int call_site_id =
+            call_sites_.insert(instrumentr_language_get_sexp(call_expr));
 
-        Call* call_data =
-            new Call(call_id, function->get_id(), env_id, call_exprs.front());
+        Call* call_data = arena_.create<Call>(allocations_,
+                                              call_id,
+                                              function->get_id(),
+                                              env_id,
+                                              call_site_id);
 
         auto result = table_.insert({call_id, call_data});
         return result.first->second;
@@ -56,6 +64,63 @@ class CallTable {
         return result->second;
     }
 
+    /* in streaming mode, the row of an exited call is written out and the
+       call is dropped. calls are not updated after they exit since the
+       argument table, whose promises outlive calls, is not populated. */
+    void exit(Call* call, const std::string& result_type) {
+        call->exit(result_type);
+
+        if (!stream_) {
+            return;
+        }
+
+        call->to_stream(*stream_);
+        table_.erase(call->get_id());
+        arena_.destroy(call);
+    }
+
+    void enable_streaming(StreamWriter& writer,
+                          const std::string& filepath,
+                          int chunk_size) {
+        stream_.reset(
+            new TableStream(writer, filepath, get_schema(), chunk_size));
+    }
+
+    bool is_streaming() const {
+        return stream_ != nullptr;
+    }
+
+    /* calls that have not exited, as after an error, are written last */
+    void close_stream() {
+        for (auto iter = table_.begin(); iter != table_.end(); ++iter) {
+            iter->second->to_stream(*stream_);
+        }
+        stream_->close();
+    }
+
+    static const TableSchema& get_schema() {
+        static const TableSchema schema = {
+            {"call_id",
+             "fun_id",
+             "env_id",
+             "successful",
+             "result_type",
+             "force_order",
+             "esc_env",
+             "call_site_id",
+             "sample_weight"},
+            {ColumnType::Integer,
+             ColumnType::Integer,
+             ColumnType::Integer,
+             ColumnType::Logical,
+             ColumnType::String,
+             ColumnType::String,
+             ColumnType::Integer,
+             ColumnType::Integer,
+             ColumnType::Double}};
+        return schema;
+    }
+
     SEXP to_sexp() {
         int size = table_.size();
 
@@ -66,7 +131,10 @@ class CallTable {
         SEXP r_result_type = PROTECT(allocVector(STRSXP, size));
         SEXP r_force_order = PROTECT(allocVector(STRSXP, size));
         SEXP r_esc_env = PROTECT(allocVector(INTSXP, size));
-        SEXP r_call_expr = PROTECT(allocVector(STRSXP, size));
+        SEXP r_call_site_id = PROTECT(allocVector(INTSXP, size));
+        SEXP r_sample_weight = PROTECT(allocVector(REALSXP, size));
+
+        CharCache cache;
 
         int index = 0;
         for (auto iter = table_.begin(); iter != table_.end();
@@ -74,6 +142,7 @@ class CallTable {
             Call* call = iter->second;
 
             call->to_sexp(index,
+                          cache,
                           r_call_id,
                           r_fun_id,
                           r_env_id,
@@ -81,7 +150,8 @@ class CallTable {
                           r_result_type,
                           r_force_order,
                           r_esc_env,
-                          r_call_expr);
+                          r_call_site_id,
+                          r_sample_weight);
         }
 
         std::vector<SEXP> columns({r_call_id,
@@ -91,26 +161,32 @@ class CallTable {
                                    r_result_type,
                                    r_force_order,
                                    r_esc_env,
-                                   r_call_expr});
+                                   r_call_site_id,
+                                   r_sample_weight});
 
-        std::vector<std::string> names({"call_id",
-                                        "fun_id",
-                                        "env_id",
-                                        "successful",
-                                        "result_type",
-                                        "force_order",
-                                        "esc_env",
-                                        "call_expr"});
+        const std::vector<std::string>& names = get_schema().names;
 
         SEXP df = create_data_frame(names, columns);
 
-        UNPROTECT(8);
+        UNPROTECT(9);
 
         return df;
     }
 
+    CallSiteTable& get_call_sites() {
+        return call_sites_;
+    }
+
+    const ArenaCounter& get_allocations() const {
+        return allocations_;
+    }
+
   private:
+    Arena& arena_;
+    ArenaCounter allocations_;
     std::unordered_map<int, Call*> table_;
+    CallSiteTable call_sites_;
+    std::unique_ptr<TableStream> stream_;
 };
 
 #endif /* ENVTRACER_CALL_TABLE_H */
@@ -0,0 +1,135 @@
+#include "CallbackProfiler.h"
+#include "utilities.h"
+
+bool CallbackProfiler::enabled_ = false;
+std::vector<CallbackProfiler::Slot> CallbackProfiler::slots_ =
+    CallbackProfiler::create_phase_slots_();
+std::unordered_map<std::string, int> CallbackProfiler::callback_slots_;
+
+std::vector<CallbackProfiler::Slot> CallbackProfiler::create_phase_slots_() {
+    const char* names[PROFILE_PHASE_COUNT] = {"backtrace_push",
+                                              "caller_info",
+                                              "call_insert",
+                                              "environment_insert",
+                                              "function_insert",
+                                              "env_access_insert",
+                                              "env_constructor_insert",
+                                              "eval_insert",
+                                              "argument_insert",
+                                              "effects_insert"};
+
+    std::vector<Slot> slots(PROFILE_PHASE_COUNT);
+
+    for (int phase = 0; phase < PROFILE_PHASE_COUNT; ++phase) {
+        slots[phase].name = names[phase];
+        slots[phase].is_phase = true;
+        clear_(slots[phase]);
+    }
+
+    return slots;
+}
+
+void CallbackProfiler::clear_(Slot& slot) {
+    slot.count = 0;
+    slot.total = 0;
+    slot.min = 0;
+    slot.max = 0;
+    for (std::uint64_t& count: slot.histogram) {
+        count = 0;
+    }
+}
+
+void CallbackProfiler::enable() {
+    for (Slot& slot: slots_) {
+        clear_(slot);
+    }
+    enabled_ = true;
+}
+
+int CallbackProfiler::get_slot(const std::string& name) {
+    auto iter = callback_slots_.find(name);
+
+    if (iter != callback_slots_.end()) {
+        return iter->second;
+    }
+
+    Slot slot;
+    slot.name = name;
+    slot.is_phase = false;
+    clear_(slot);
+
+    int index = slots_.size();
+    slots_.push_back(slot);
+    callback_slots_.insert({name, index});
+
+    return index;
+}
+
+SEXP CallbackProfiler::to_sexp() {
+    std::vector<const Slot*> used;
+
+    for (const Slot& slot: slots_) {
+        if (slot.count != 0) {
+            used.push_back(&slot);
+        }
+    }
+
+    int size = used.size();
+
+    SEXP r_name = PROTECT(allocVector(STRSXP, size));
+    SEXP r_kind = PROTECT(allocVector(STRSXP, size));
+    SEXP r_count = PROTECT(allocVector(REALSXP, size));
+    SEXP r_total = PROTECT(allocVector(REALSXP, size));
+    SEXP r_min = PROTECT(allocVector(REALSXP, size));
+    SEXP r_max = PROTECT(allocVector(REALSXP, size));
+    SEXP r_unit = PROTECT(allocVector(STRSXP, size));
+    SEXP r_histogram = PROTECT(allocVector(STRSXP, size));
+
+#if defined(__x86_64__) || defined(__i386__)
+    const std::string unit = "tsc";
+#else
+    const std::string unit = "ns";
+#endif
+
+    CharCache cache;
+
+    for (int index = 0; index < size; ++index) {
+        const Slot& slot = *used[index];
+
+        /* bucket:count pairs of the non-empty buckets; counts are kept
+           64-bit since they can exceed the int range in long traces */
+        std::string histogram;
+        for (int bucket = 0; bucket < 65; ++bucket) {
+            if (slot.histogram[bucket] != 0) {
+                if (!histogram.empty()) {
+                    histogram.push_back('|');
+                }
+                histogram.append(std::to_string(bucket));
+                histogram.push_back(':');
+                histogram.append(std::to_string(slot.histogram[bucket]));
+            }
+        }
+
+        SET_STRING_ELT(r_name, index, make_char(slot.name));
+        SET_STRING_ELT(
+            r_kind, index, cache.get(slot.is_phase ? "phase" : "callback"));
+        SET_REAL_ELT(r_count, index, slot.count);
+        SET_REAL_ELT(r_total, index, slot.total);
+        SET_REAL_ELT(r_min, index, slot.min);
+        SET_REAL_ELT(r_max, index, slot.max);
+        SET_STRING_ELT(r_unit, index, cache.get(unit));
+        SET_STRING_ELT(r_histogram, index, make_char(histogram));
+    }
+
+    std::vector<SEXP> columns(
+        {r_name, r_kind, r_count, r_total, r_min, r_max, r_unit, r_histogram});
+
+    std::vector<std::string> names(
+        {"name", "kind", "count", "total", "min", "max", "unit", "histogram"});
+
+    SEXP df = create_data_frame(names, columns);
+
+    UNPROTECT(8);
+
+    return df;
+}
@@ -0,0 +1,149 @@
+#ifndef ENVTRACER_CALLBACK_PROFILER_H
+#define ENVTRACER_CALLBACK_PROFILER_H
+
+#include "Rincludes.h"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <time.h>
+#endif
+
+/* Parts of callbacks profiled separately. Their time is also included in
+   the time of the callbacks they run in. */
+enum profile_phase_t {
+    PROFILE_PHASE_BACKTRACE_PUSH = 0,
+    PROFILE_PHASE_CALLER_INFO,
+    PROFILE_PHASE_CALL_INSERT,
+    PROFILE_PHASE_ENVIRONMENT_INSERT,
+    PROFILE_PHASE_FUNCTION_INSERT,
+    PROFILE_PHASE_ENV_ACCESS_INSERT,
+    PROFILE_PHASE_ENV_CONSTRUCTOR_INSERT,
+    PROFILE_PHASE_EVAL_INSERT,
+    PROFILE_PHASE_ARGUMENT_INSERT,
+    PROFILE_PHASE_EFFECTS_INSERT,
+    PROFILE_PHASE_COUNT
+};
+
+/* Self-profiler of the tracer. Registered callbacks and the phases above
+   each own a slot recording their invocation count, total, minimum and
+   maximum duration and a histogram of durations by power of two.
+
+   Durations are measured with the time stamp counter where available and
+   in nanoseconds otherwise. The profiler is only enabled while tracing
+   with the profile option; otherwise a scope costs one branch. */
+class CallbackProfiler {
+  public:
+    static std::uint64_t read_clock() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        struct timespec time;
+        clock_gettime(CLOCK_MONOTONIC, &time);
+        return time.tv_sec * 1000000000ULL + time.tv_nsec;
+#endif
+    }
+
+    static bool is_enabled() {
+        return enabled_;
+    }
+
+    /* clears all slots and starts recording */
+    static void enable();
+
+    static void disable() {
+        enabled_ = false;
+    }
+
+    /* slot of a callback, the same for every tracer */
+    static int get_slot(const std::string& name);
+
+    static void record(int slot, std::uint64_t duration) {
+        Slot& entry = slots_[slot];
+
+        if (entry.count == 0 || duration < entry.min) {
+            entry.min = duration;
+        }
+        if (duration > entry.max) {
+            entry.max = duration;
+        }
+
+        ++entry.count;
+        entry.total += duration;
+        ++entry.histogram[get_bucket_(duration)];
+    }
+
+    /* data frame of the slots that were used */
+    static SEXP to_sexp();
+
+  private:
+    /* durations in [2^(bucket - 1), 2^bucket), 0 for a duration of 0 */
+    static int get_bucket_(std::uint64_t duration) {
+        return duration == 0 ? 0 : 64 - __builtin_clzll(duration);
+    }
+
+    struct Slot {
+        std::string name;
+        bool is_phase;
+        std::uint64_t count;
+        std::uint64_t total;
+        std::uint64_t min;
+        std::uint64_t max;
+        std::uint64_t histogram[65];
+    };
+
+    static std::vector<Slot> create_phase_slots_();
+
+    static void clear_(Slot& slot);
+
+    static bool enabled_;
+    static std::vector<Slot> slots_;
+    static std::unordered_map<std::string, int> callback_slots_;
+};
+
+/* records the time until the end of the enclosing scope in a slot */
+class ProfileScope {
+  public:
+    explicit ProfileScope(int slot)
+        : slot_(slot), start_(0) {
+        if (CallbackProfiler::is_enabled()) {
+            start_ = CallbackProfiler::read_clock();
+        }
+    }
+
+    ~ProfileScope() {
+        /* the profiler may have been enabled or disabled in between */
+        if (start_ != 0 && CallbackProfiler::is_enabled()) {
+            CallbackProfiler::record(slot_,
+                                     CallbackProfiler::read_clock() - start_);
+        }
+    }
+
+  private:
+    int slot_;
+    std::uint64_t start_;
+};
+
+/* Callback that profiles function. Callbacks are plain functions, so a
+   wrapper is instantiated per callback with the slot fixed at creation. */
+template <typename T, T function>
+struct ProfiledCallback;
+
+template <typename... Args, void (*function)(Args...)>
+struct ProfiledCallback<void (*)(Args...), function> {
+    static int slot;
+
+    static void invoke(Args... args) {
+        ProfileScope scope(slot);
+        function(args...);
+    }
+};
+
+template <typename... Args, void (*function)(Args...)>
+int ProfiledCallback<void (*)(Args...), function>::slot = -1;
+
+#endif /* ENVTRACER_CALLBACK_PROFILER_H */
@@ -0,0 +1,154 @@
+#ifndef ENVTRACER_CALLER_STACK_H
+#define ENVTRACER_CALLER_STACK_H
+
+#include "utilities.h"
+#include <instrumentr/instrumentr.h>
+#include <unordered_map>
+#include <vector>
+
+/* Shadow stack of the closure and promise frames on instrumentr's call
+   stack. Frames are pushed and popped by the closure call and promise force
+   callbacks. Each frame remembers its position on instrumentr's call stack
+   and the slot of its effective caller: a closure frame is its own caller
+   and a promise frame resolves to the closure frame whose call environment
+   the promise is evaluated in. This makes caller lookup independent of the
+   depth of the stack. */
+class CallerStack {
+  public:
+    CallerStack() {
+    }
+
+    void push_call(int position,
+                   instrumentr_closure_t closure,
+                   instrumentr_call_t call) {
+        prune_(position);
+
+        int slot = frames_.size();
+
+        int env_id = instrumentr_environment_get_id(
+            instrumentr_call_get_environment(call));
+
+        Frame frame;
+        frame.position = position;
+        frame.fun_id = instrumentr_closure_get_id(closure);
+        frame.call_id = instrumentr_call_get_id(call);
+        frame.env_id = env_id;
+        frame.caller = slot;
+        frame.shadowed = NA_INTEGER;
+
+        auto result = env_slots_.insert({env_id, slot});
+        if (!result.second) {
+            frame.shadowed = result.first->second;
+            result.first->second = slot;
+        }
+
+        frames_.push_back(frame);
+    }
+
+    void push_promise(int position, instrumentr_promise_t promise) {
+        prune_(position);
+
+        int slot = frames_.size();
+
+        Frame frame;
+        frame.position = position;
+        frame.fun_id = NA_INTEGER;
+        frame.call_id = NA_INTEGER;
+        frame.env_id = NA_INTEGER;
+        frame.caller = slot == 0 ? NA_INTEGER : frames_[slot - 1].caller;
+        frame.shadowed = NA_INTEGER;
+
+        instrumentr_value_t env = instrumentr_promise_get_environment(promise);
+
+        if (instrumentr_value_is_environment(env)) {
+            frame.env_id = instrumentr_value_get_id(env);
+
+            auto iter = env_slots_.find(frame.env_id);
+            frame.caller =
+                iter == env_slots_.end() ? NA_INTEGER : iter->second;
+        }
+
+        frames_.push_back(frame);
+    }
+
+    void pop_call(instrumentr_call_t call) {
+        if (!frames_.empty() &&
+            frames_.back().call_id == instrumentr_call_get_id(call)) {
+            pop_();
+        }
+    }
+
+    void pop_promise() {
+        if (!frames_.empty() && frames_.back().call_id == NA_INTEGER) {
+            pop_();
+        }
+    }
+
+    /* Returns the function and call ids of the first four callers visible
+       from frame index on an instrumentr call stack of size stack_size.
+       This mirrors a scan of the call stack starting at index where the
+       first promise frame encountered redirects the search to the closure
+       that created its environment. */
+    void get_four_callers(int stack_size, int index, int* fun_ids, int* call_ids)
+        const {
+        int limit = stack_size - index;
+
+        int slot = static_cast<int>(frames_.size()) - 1;
+
+        while (slot >= 0 && frames_[slot].position > limit) {
+            --slot;
+        }
+
+        for (int i = 0; i < 4; ++i) {
+            int caller = slot < 0 ? NA_INTEGER : frames_[slot].caller;
+
+            if (caller == NA_INTEGER) {
+                fun_ids[i] = NA_INTEGER;
+                call_ids[i] = NA_INTEGER;
+                slot = -1;
+                continue;
+            }
+
+            fun_ids[i] = frames_[caller].fun_id;
+            call_ids[i] = frames_[caller].call_id;
+            slot = caller - 1;
+        }
+    }
+
+  private:
+    struct Frame {
+        int position;
+        int fun_id;
+        int call_id;
+        int env_id;
+        int caller;
+        int shadowed;
+    };
+
+    /* frames whose position is not below a new frame were left behind by
+       exits that were not observed and are discarded. */
+    void prune_(int position) {
+        while (!frames_.empty() && frames_.back().position >= position) {
+            pop_();
+        }
+    }
+
+    void pop_() {
+        const Frame& frame = frames_.back();
+
+        if (frame.call_id != NA_INTEGER) {
+            if (frame.shadowed == NA_INTEGER) {
+                env_slots_.erase(frame.env_id);
+            } else {
+                env_slots_[frame.env_id] = frame.shadowed;
+            }
+        }
+
+        frames_.pop_back();
+    }
+
+    std::vector<Frame> frames_;
+    std::unordered_map<int, int> env_slots_;
+};
+
+#endif /* ENVTRACER_CALLER_STACK_H */
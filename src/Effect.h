@@ -0,0 +1,111 @@
+#ifndef ENVTRACER_EFFECT_H
+#define ENVTRACER_EFFECT_H
+
+#include <string>
+#include "utilities.h"
+#include "TableStream.h"
+
+class Effect {
+  public:
+    Effect(char type,
+           const std::string& var_name,
+           bool transitive,
+           int env_id,
+           int source_fun_id,
+           int source_call_id,
+           int source_arg_id,
+           int source_formal_pos,
+           int fun_id,
+           int call_id,
+           int arg_id,
+           int formal_pos,
+           int backtrace)
+        : type_(type)
+        , var_name_(var_name)
+        , transitive_(transitive)
+        , env_id_(env_id)
+        , source_fun_id_(source_fun_id)
+        , source_call_id_(source_call_id)
+        , source_arg_id_(source_arg_id)
+        , source_formal_pos_(source_formal_pos)
+        , fun_id_(fun_id)
+        , call_id_(call_id)
+        , arg_id_(arg_id)
+        , formal_pos_(formal_pos)
+        , backtrace_(backtrace)
+        , sample_weight_(1) {
+    }
+
+    /* number of events this event stands for when calls are sampled */
+    void set_sample_weight(double sample_weight) {
+        sample_weight_ = sample_weight;
+    }
+
+    void to_sexp(int position,
+                 CharCache& cache,
+                 SEXP r_type,
+                 SEXP r_var_name,
+                 SEXP r_transitive,
+                 SEXP r_env_id,
+                 SEXP r_source_fun_id,
+                 SEXP r_source_call_id,
+                 SEXP r_source_arg_id,
+                 SEXP r_source_formal_pos,
+                 SEXP r_fun_id,
+                 SEXP r_call_id,
+                 SEXP r_arg_id,
+                 SEXP r_formal_pos,
+                 SEXP r_backtrace,
+                 SEXP r_sample_weight) {
+        SET_STRING_ELT(r_type, position, cache.get(std::string(1, type_)));
+        SET_STRING_ELT(r_var_name, position, cache.get(var_name_));
+        SET_LOGICAL_ELT(r_transitive, position, transitive_);
+        SET_INTEGER_ELT(r_env_id, position, env_id_);
+        SET_INTEGER_ELT(r_source_fun_id, position, source_fun_id_);
+        SET_INTEGER_ELT(r_source_call_id, position, source_call_id_);
+        SET_INTEGER_ELT(r_source_arg_id, position, source_arg_id_);
+        SET_INTEGER_ELT(r_source_formal_pos, position, source_formal_pos_);
+        SET_INTEGER_ELT(r_fun_id, position, fun_id_);
+        SET_INTEGER_ELT(r_call_id, position, call_id_);
+        SET_INTEGER_ELT(r_arg_id, position, arg_id_);
+        SET_INTEGER_ELT(r_formal_pos, position, formal_pos_);
+        SET_INTEGER_ELT(r_backtrace, position, backtrace_);
+        SET_REAL_ELT(r_sample_weight, position, sample_weight_);
+    }
+
+    void to_stream(TableStream& stream) const {
+        stream.put_string(std::string(1, type_));
+        stream.put_string(var_name_);
+        stream.put_logical(transitive_);
+        stream.put_int(env_id_);
+        stream.put_int(source_fun_id_);
+        stream.put_int(source_call_id_);
+        stream.put_int(source_arg_id_);
+        stream.put_int(source_formal_pos_);
+        stream.put_int(fun_id_);
+        stream.put_int(call_id_);
+        stream.put_int(arg_id_);
+        stream.put_int(formal_pos_);
+        stream.put_int(backtrace_);
+        stream.put_double(sample_weight_);
+        stream.end_row();
+    }
+
+  private:
+    char type_;
+    const std::string var_name_;
+    bool transitive_;
+    int env_id_;
+    int source_fun_id_;
+    int source_call_id_;
+    int source_arg_id_;
+    int source_formal_pos_;
+    int fun_id_;
+    int call_id_;
+    int arg_id_;
+    int formal_pos_;
+    int backtrace_;
+    double sample_weight_;
+};
+
+#endif /* ENVTRACER_EFFECT_H */
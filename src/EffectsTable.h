@@ -3,17 +3,34 @@
 
 #include <vector>
 #include <string>
+#include "CallbackProfiler.h"
+#include "Effect.h"
+#include "TableStream.h"
+#include "Arena.h"
+#include "AnalysisWorker.h"
+#include "CallSampler.h"
 #include <instrumentr/instrumentr.h>
+#include <memory>
 
 class EffectsTable {
   public:
-    EffectsTable() {
+    explicit EffectsTable(Arena& arena): arena_(arena) {
     }
 
     ~EffectsTable() {
+        for (auto iter = table_.begin(); iter != table_.end(); ++iter) {
+            arena_.destroy(*iter);
+        }
+        table_.clear();
+    }
+
+    const ArenaCounter& get_allocations() const {
+        return allocations_;
     }
 
-    void insert(const char type,
+    /* the record only holds scalars; the type is formatted when the row
+       is appended, possibly on the analysis worker */
+    void insert(char type,
                 const std::string& var_name,
                 bool transitive,
                 int env_id,
@@ -25,24 +42,115 @@ class EffectsTable {
                 int call_id,
                 int arg_id,
                 int formal_pos,
-                const std::string& backtrace) {
-        type_.push_back(std::string(1, type));
-        var_name_.push_back(var_name);
-        transitive_.push_back(transitive);
-        env_id_.push_back(env_id);
-        source_fun_id_.push_back(source_fun_id);
-        source_call_id_.push_back(source_call_id);
-        source_arg_id_.push_back(source_arg_id);
-        source_formal_pos_.push_back(source_formal_pos);
-        fun_id_.push_back(fun_id);
-        call_id_.push_back(call_id);
-        arg_id_.push_back(arg_id);
-        formal_pos_.push_back(formal_pos);
-        backtrace_.push_back(backtrace);
+                int backtrace) {
+        ProfileScope scope(PROFILE_PHASE_EFFECTS_INSERT);
+
+        Effect* effect = arena_.create<Effect>(allocations_,
+                                               type,
+                                               var_name,
+                                               transitive,
+                                               env_id,
+                                               source_fun_id,
+                                               source_call_id,
+                                               source_arg_id,
+                                               source_formal_pos,
+                                               fun_id,
+                                               call_id,
+                                               arg_id,
+                                               formal_pos,
+                                               backtrace);
+
+        if (sampler_ != nullptr) {
+            effect->set_sample_weight(sampler_->get_weight());
+        }
+
+        if (worker_ != nullptr) {
+            worker_->submit(this, effect);
+            return;
+        }
+
+        if (append(effect)) {
+            release(effect);
+        }
+    }
+
+    /* stores or streams a record, possibly on the analysis worker. Returns
+       true if the record has been streamed and can be released. */
+    bool append(Effect* effect) {
+        if (stream_) {
+            effect->to_stream(*stream_);
+            return true;
+        }
+        table_.push_back(effect);
+        return false;
+    }
+
+    /* called on the R thread since the arena is not thread safe */
+    void release(Effect* effect) {
+        arena_.destroy(effect);
+    }
+
+    /* records are appended on worker instead of the calling thread, or
+       synchronously if worker is null */
+    void set_worker(AnalysisWorker* worker) {
+        worker_ = worker;
+    }
+
+    /* rows are weighted by the call they happen in */
+    void set_sampler(const CallSampler* sampler) {
+        sampler_ = sampler;
+    }
+
+    void enable_streaming(StreamWriter& writer,
+                          const std::string& filepath,
+                          int chunk_size) {
+        stream_.reset(
+            new TableStream(writer, filepath, get_schema(), chunk_size));
+    }
+
+    bool is_streaming() const {
+        return stream_ != nullptr;
+    }
+
+    void close_stream() {
+        stream_->close();
+    }
+
+    static const TableSchema& get_schema() {
+        static const TableSchema schema = {
+            {"type",
+             "var_name",
+             "transitive",
+             "env_id",
+             "source_fun_id",
+             "source_call_id",
+             "source_arg_id",
+             "source_formal_pos",
+             "fun_id",
+             "call_id",
+             "arg_id",
+             "formal_pos",
+             "backtrace",
+             "sample_weight"},
+            {ColumnType::String,
+             ColumnType::String,
+             ColumnType::Logical,
+             ColumnType::Integer,
+             ColumnType::Integer,
+             ColumnType::Integer,
+             ColumnType::Integer,
+             ColumnType::Integer,
+             ColumnType::Integer,
+             ColumnType::Integer,
+             ColumnType::Integer,
+             ColumnType::Integer,
+             ColumnType::Integer,
+             ColumnType::Double}};
+        return schema;
     }
 
     SEXP to_sexp() {
-        int size = type_.size();
+        int size = table_.size();
 
         SEXP r_type = PROTECT(allocVector(STRSXP, size));
         SEXP r_var_name = PROTECT(allocVector(STRSXP, size));
@@ -56,24 +164,28 @@ class EffectsTable {
         SEXP r_call_id = PROTECT(allocVector(INTSXP, size));
         SEXP r_arg_id = PROTECT(allocVector(INTSXP, size));
         SEXP r_formal_pos = PROTECT(allocVector(INTSXP, size));
-        SEXP r_backtrace = PROTECT(allocVector(STRSXP, size));
+        SEXP r_backtrace = PROTECT(allocVector(INTSXP, size));
+        SEXP r_sample_weight = PROTECT(allocVector(REALSXP, size));
+
+        CharCache cache;
 
-        int index = 0;
         for (int index = 0; index < size; ++index) {
-            SET_STRING_ELT(r_type, index, make_char(type_[index]));
-            SET_STRING_ELT(r_var_name, index, make_char(var_name_[index]));
-            SET_LOGICAL_ELT(r_transitive, index, transitive_[index]);
-            SET_INTEGER_ELT(r_env_id, index, env_id_[index]);
-            SET_INTEGER_ELT(r_source_fun_id, index, source_fun_id_[index]);
-            SET_INTEGER_ELT(r_source_call_id, index, source_call_id_[index]);
-            SET_INTEGER_ELT(r_source_arg_id, index, source_arg_id_[index]);
-            SET_INTEGER_ELT(
-                r_source_formal_pos, index, source_formal_pos_[index]);
-            SET_INTEGER_ELT(r_fun_id, index, fun_id_[index]);
-            SET_INTEGER_ELT(r_call_id, index, call_id_[index]);
-            SET_INTEGER_ELT(r_arg_id, index, arg_id_[index]);
-            SET_INTEGER_ELT(r_formal_pos, index, formal_pos_[index]);
-            SET_STRING_ELT(r_backtrace, index, make_char(backtrace_[index]));
+            table_[index]->to_sexp(index,
+                                   cache,
+                                   r_type,
+                                   r_var_name,
+                                   r_transitive,
+                                   r_env_id,
+                                   r_source_fun_id,
+                                   r_source_call_id,
+                                   r_source_arg_id,
+                                   r_source_formal_pos,
+                                   r_fun_id,
+                                   r_call_id,
+                                   r_arg_id,
+                                   r_formal_pos,
+                                   r_backtrace,
+                                   r_sample_weight);
         }
 
         std::vector<SEXP> columns({r_type,
@@ -88,43 +200,25 @@ class EffectsTable {
                                    r_call_id,
                                    r_arg_id,
                                    r_formal_pos,
-                                   r_backtrace});
-
-        std::vector<std::string> names({"type",
-                                        "var_name",
-                                        "transitive",
-                                        "env_id",
-                                        "source_fun_id",
-                                        "source_call_id",
-                                        "source_arg_id",
-                                        "source_formal_pos",
-                                        "fun_id",
-                                        "call_id",
-                                        "arg_id",
-                                        "formal_pos",
-                                        "backtrace"});
+                                   r_backtrace,
+                                   r_sample_weight});
+
+        const std::vector<std::string>& names = get_schema().names;
 
         SEXP df = create_data_frame(names, columns);
 
-        UNPROTECT(13);
+        UNPROTECT(14);
 
         return df;
     }
 
   private:
-    std::vector<std::string> type_;
-    std::vector<std::string> var_name_;
-    std::vector<bool> transitive_;
-    std::vector<int> env_id_;
-    std::vector<int> source_fun_id_;
-    std::vector<int> source_call_id_;
-    std::vector<int> source_arg_id_;
-    std::vector<int> source_formal_pos_;
-    std::vector<int> fun_id_;
-    std::vector<int> call_id_;
-    std::vector<int> arg_id_;
-    std::vector<int> formal_pos_;
-    std::vector<std::string> backtrace_;
+    Arena& arena_;
+    ArenaCounter allocations_;
+    std::unique_ptr<TableStream> stream_;
+    AnalysisWorker* worker_ = nullptr;
+    const CallSampler* sampler_ = nullptr;
+    std::vector<Effect*> table_;
 };
 
 #endif /* ENVTRACER_EFFECTS_TABLE_H */
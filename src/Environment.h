@@ -2,94 +2,143 @@
 #define ENVTRACER_ENVIRONMENT_H
 
 #include <string>
+#include <vector>
 #include "utilities.h"
+#include "EventSequence.h"
+
+/* Fields of an environment that are rarely touched during tracing. */
+struct EnvironmentColdData {
+    EnvironmentColdData()
+        : env_type(ENVTRACER_NA_STRING)
+        , env_name(ENVTRACER_NA_STRING)
+        , package(ENVTRACER_NA_STRING)
+        , constructor(ENVTRACER_NA_STRING) {
+    }
+
+    std::string env_type;
+    std::string env_name;
+    std::vector<std::string> classes;
+    std::string package;
+    std::string constructor;
+    EventSequence event_seq;
+};
+
+/* Storage of the environment table. Environments are numbered by dense
+   slots in order of creation. Integer fields are kept in parallel arrays
+   indexed by slot so that they can be copied to R a column at a time;
+   strings live in a side table of cold rows. */
+const int EVAL_PARENT_UNRESOLVED = -2;
+const int EVAL_PARENT_NONE = -1;
+
+struct EnvironmentColumns {
+    int add(int id, bool is_hashed, int parent_id, int call) {
+        int slot = env_id.size();
+        env_id.push_back(id);
+        hashed.push_back(is_hashed);
+        parent_env_id.push_back(parent_id);
+        call_id.push_back(call);
+        evals.push_back(0);
+        eval_parent.push_back(EVAL_PARENT_UNRESOLVED);
+        dispatch.push_back(0);
+        backtrace.push_back(NA_INTEGER);
+        for (int i = 0; i < 8; ++i) {
+            source[i].push_back(NA_INTEGER);
+        }
+        cold.emplace_back();
+        return slot;
+    }
+
+    int size() const {
+        return env_id.size();
+    }
+
+    /* bytes used by a single environment */
+    static std::size_t get_row_size() {
+        return 16 * sizeof(int) + sizeof(EnvironmentColdData);
+    }
+
+    std::vector<int> env_id;
+    std::vector<int> hashed;
+    std::vector<int> parent_env_id;
+    std::vector<int> call_id;
+    std::vector<int> evals;
+    /* slot of the next environment marked by an eval in this one, see
+       EnvironmentTable::get_eval_scope */
+    std::vector<int> eval_parent;
+    std::vector<int> dispatch;
+    std::vector<int> backtrace;
+    /* source_fun_id_1, source_call_id_1, ..., source_call_id_4 */
+    std::vector<int> source[8];
+    std::vector<EnvironmentColdData> cold;
+    EventDictionary events;
+    /* maximum number of events stored per environment, 0 if unbounded */
+    std::uint32_t event_seq_cap = 0;
+};
 
+/* Handle to an environment in the environment table. */
 class Environment {
   public:
-    Environment(int env_id, bool hashed, int parent_env_id, int call_id)
-        : env_id_(env_id)
-        , hashed_(hashed)
-        , parent_env_id_(parent_env_id)
-        , env_type_(ENVTRACER_NA_STRING)
-        , env_name_(ENVTRACER_NA_STRING)
-        , call_id_(call_id)
-        , evals_(0)
-        , eval_counter_(0)
-        , package_(ENVTRACER_NA_STRING)
-        , constructor_(ENVTRACER_NA_STRING)
-        , source_fun_id_1_(NA_INTEGER)
-        , source_call_id_1_(NA_INTEGER)
-        , source_fun_id_2_(NA_INTEGER)
-        , source_call_id_2_(NA_INTEGER)
-        , source_fun_id_3_(NA_INTEGER)
-        , source_call_id_3_(NA_INTEGER)
-        , source_fun_id_4_(NA_INTEGER)
-        , source_call_id_4_(NA_INTEGER)
-        , dispatch_(false)
-        , backtrace_(ENVTRACER_NA_STRING)
-        , event_seq_("|") {
+    Environment(EnvironmentColumns* columns, int slot)
+        : columns_(columns), slot_(slot) {
     }
 
     int get_id() {
-        return env_id_;
+        return columns_->env_id[slot_];
+    }
+
+    int get_slot() const {
+        return slot_;
     }
 
     bool has_name() const {
-        return env_name_ != ENVTRACER_NA_STRING;
+        return cold_().env_name != ENVTRACER_NA_STRING;
     }
     const std::string& get_name() const {
-        return env_name_;
+        return cold_().env_name;
     }
 
     const std::string& get_type() const {
-        return env_type_;
+        return cold_().env_type;
     }
 
     void set_name(const char* env_name) {
-        env_name_ = charptr_to_string(env_name);
+        cold_().env_name = charptr_to_string(env_name);
     }
 
     void set_type(const char* env_type) {
-        env_type_ = charptr_to_string(env_type);
+        cold_().env_type = charptr_to_string(env_type);
     }
 
     int get_call_id() const {
-        return call_id_;
+        return columns_->call_id[slot_];
     }
 
     void set_call_id(int call_id) {
-        call_id_ = call_id;
+        columns_->call_id[slot_] = call_id;
     }
 
     void update_class(const char* klass) {
-        for (const std::string& c: classes_) {
+        std::vector<std::string>& classes = cold_().classes;
+
+        for (const std::string& c: classes) {
             if (c == klass) {
                 return;
             }
         }
 
-        classes_.push_back(klass);
+        classes.push_back(klass);
     }
 
-    void push_eval() {
-        ++evals_;
-        ++eval_counter_;
-    }
-
-    void pop_eval() {
-        --eval_counter_;
-    }
-
-    bool inside_eval() const {
-        return eval_counter_ > 0;
+    void count_eval() {
+        ++columns_->evals[slot_];
     }
 
     void set_package(const std::string& package) {
-        package_ = package;
+        cold_().package = package;
     }
 
     bool is_package() const {
-        return package_ != ENVTRACER_NA_STRING;
+        return cold_().package != ENVTRACER_NA_STRING;
     }
 
     void set_source(const std::string& constructor,
@@ -101,130 +150,73 @@ class Environment {
                     int source_call_id_3,
                     int source_fun_id_4,
                     int source_call_id_4) {
-        constructor_ = constructor;
-        source_fun_id_1_ = source_fun_id_1;
-        source_call_id_1_ = source_call_id_1;
-        source_fun_id_2_ = source_fun_id_2;
-        source_call_id_2_ = source_call_id_2;
-        source_fun_id_3_ = source_fun_id_3;
-        source_call_id_3_ = source_call_id_3;
-        source_fun_id_4_ = source_fun_id_4;
-        source_call_id_4_ = source_call_id_4;
+        cold_().constructor = constructor;
+        columns_->source[0][slot_] = source_fun_id_1;
+        columns_->source[1][slot_] = source_call_id_1;
+        columns_->source[2][slot_] = source_fun_id_2;
+        columns_->source[3][slot_] = source_call_id_2;
+        columns_->source[4][slot_] = source_fun_id_3;
+        columns_->source[5][slot_] = source_call_id_3;
+        columns_->source[6][slot_] = source_fun_id_4;
+        columns_->source[7][slot_] = source_call_id_4;
     }
 
-    void set_backtrace(const std::string& backtrace) {
-        backtrace_ = backtrace;
+    void set_backtrace(int backtrace) {
+        columns_->backtrace[slot_] = backtrace;
     }
 
     void set_dispatch() {
-        dispatch_ = true;
+        columns_->dispatch[slot_] = 1;
+    }
+
+    void add_event(env_event_t event) {
+        cold_().event_seq.append(event, columns_->event_seq_cap);
     }
 
     void add_event(const std::string& event) {
-        event_seq_.append(event);
-        event_seq_.append("|");
+        cold_().event_seq.append(columns_->events.intern(event),
+                                 columns_->event_seq_cap);
     }
 
     void lookup() {
-        event_seq_.push_back('L');
+        add_event(ENV_EVENT_LOOKUP);
     }
 
     void assign() {
-        event_seq_.push_back('A');
+        add_event(ENV_EVENT_ASSIGN);
     }
 
     void define() {
-        event_seq_.push_back('D');
+        add_event(ENV_EVENT_DEFINE);
     }
 
     void remove() {
-        event_seq_.push_back('R');
+        add_event(ENV_EVENT_REMOVE);
     }
 
     void escape() {
-        event_seq_.push_back('E');
+        add_event(ENV_EVENT_ESCAPE);
     }
 
     void lock() {
-        event_seq_.push_back('+');
+        add_event(ENV_EVENT_LOCK);
     }
 
     void unlock() {
-        event_seq_.push_back('-');
+        add_event(ENV_EVENT_UNLOCK);
     }
 
     void set_parent(int parent_env_id) {
-        parent_env_id_ = parent_env_id;
-    }
-
-    void to_sexp(int position,
-                 SEXP r_env_id,
-                 SEXP r_hashed,
-                 SEXP r_parent_env_id,
-                 SEXP r_env_type,
-                 SEXP r_env_name,
-                 SEXP r_call_id,
-                 SEXP r_classes,
-                 SEXP r_evals,
-                 SEXP r_package,
-                 SEXP r_constructor,
-                 SEXP r_source_fun_id_1,
-                 SEXP r_source_call_id_1,
-                 SEXP r_source_fun_id_2,
-                 SEXP r_source_call_id_2,
-                 SEXP r_source_fun_id_3,
-                 SEXP r_source_call_id_3,
-                 SEXP r_source_fun_id_4,
-                 SEXP r_source_call_id_4,
-                 SEXP r_dispatch,
-                 SEXP r_event_seq,
-                 SEXP r_backtrace) {
-        SET_INTEGER_ELT(r_env_id, position, env_id_);
-        SET_LOGICAL_ELT(r_hashed, position, hashed_);
-        SET_INTEGER_ELT(r_parent_env_id, position, parent_env_id_);
-        SET_STRING_ELT(r_env_type, position, make_char(env_type_));
-        SET_STRING_ELT(r_env_name, position, make_char(env_name_));
-        SET_INTEGER_ELT(r_call_id, position, call_id_);
-        SET_STRING_ELT(r_classes, position, make_char(classes_));
-        SET_INTEGER_ELT(r_evals, position, evals_);
-        SET_STRING_ELT(r_package, position, make_char(package_));
-        SET_STRING_ELT(r_constructor, position, make_char(constructor_));
-        SET_INTEGER_ELT(r_source_fun_id_1, position, source_fun_id_1_);
-        SET_INTEGER_ELT(r_source_call_id_1, position, source_call_id_1_);
-        SET_INTEGER_ELT(r_source_fun_id_2, position, source_fun_id_2_);
-        SET_INTEGER_ELT(r_source_call_id_2, position, source_call_id_2_);
-        SET_INTEGER_ELT(r_source_fun_id_3, position, source_fun_id_3_);
-        SET_INTEGER_ELT(r_source_call_id_3, position, source_call_id_3_);
-        SET_INTEGER_ELT(r_source_fun_id_4, position, source_fun_id_4_);
-        SET_INTEGER_ELT(r_source_call_id_4, position, source_call_id_4_);
-        SET_LOGICAL_ELT(r_dispatch, position, dispatch_ ? 1 : 0);
-        SET_STRING_ELT(r_event_seq, position, make_char(event_seq_));
-        SET_STRING_ELT(r_backtrace, position, make_char(backtrace_));
+        columns_->parent_env_id[slot_] = parent_env_id;
     }
 
   private:
-    int env_id_;
-    bool hashed_;
-    int parent_env_id_;
-    std::string env_type_;
-    std::string env_name_;
-    int call_id_;
-    std::vector<std::string> classes_;
-    int evals_;
-    int eval_counter_;
-    std::string package_;
-    std::string constructor_;
-    int source_fun_id_1_;
-    int source_call_id_1_;
-    int source_fun_id_2_;
-    int source_call_id_2_;
-    int source_fun_id_3_;
-    int source_call_id_3_;
-    int source_fun_id_4_;
-    int source_call_id_4_;
-    bool dispatch_;
-    std::string event_seq_;
-    std::string backtrace_;
+    EnvironmentColdData& cold_() const {
+        return columns_->cold[slot_];
+    }
+
+    EnvironmentColumns* columns_;
+    int slot_;
 };
 
 #endif /* ENVTRACER_ENVIRONMENT_H */
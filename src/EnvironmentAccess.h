@@ -3,6 +3,7 @@
 
 #include <string>
 #include "utilities.h"
+#include "TableStream.h"
 
 class EnvironmentAccess {
   public:
@@ -39,7 +40,8 @@ class EnvironmentAccess {
         , source_call_id_3_(NA_INTEGER)
         , source_fun_id_4_(NA_INTEGER)
         , source_call_id_4_(NA_INTEGER)
-        , backtrace_(ENVTRACER_NA_STRING) {
+        , backtrace_(NA_INTEGER)
+        , sample_weight_(1) {
     }
 
     void set_result_env(const std::string& result_env_type, int result_env_id) {
@@ -118,11 +120,17 @@ class EnvironmentAccess {
         source_call_id_4 = source_call_id_4;
     }
 
-    void set_backtrace(const std::string& backtrace) {
+    void set_backtrace(int backtrace) {
         backtrace_ = backtrace;
     }
 
+    /* number of events this event stands for when calls are sampled */
+    void set_sample_weight(double sample_weight) {
+        sample_weight_ = sample_weight;
+    }
+
     void to_sexp(int position,
+                 CharCache& cache,
                  SEXP r_time,
                  SEXP r_depth,
                  SEXP r_fun_name,
@@ -155,44 +163,45 @@ class EnvironmentAccess {
                  SEXP r_source_call_id_3,
                  SEXP r_source_fun_id_4,
                  SEXP r_source_call_id_4,
-                 SEXP r_backtrace) {
+                 SEXP r_backtrace,
+                 SEXP r_sample_weight) {
         SET_INTEGER_ELT(r_time, position, time_);
         SET_INTEGER_ELT(r_depth, position, depth_);
-        SET_STRING_ELT(r_fun_name, position, make_char(fun_name_));
+        SET_STRING_ELT(r_fun_name, position, cache.get(fun_name_));
 
         SET_STRING_ELT(
-            r_result_env_type, position, make_char(result_env_type_));
+            r_result_env_type, position, cache.get(result_env_type_));
         SET_INTEGER_ELT(r_result_env_id, position, result_env_id_);
 
-        SET_STRING_ELT(r_arg_env_type_1, position, make_char(arg_env_type_1_));
+        SET_STRING_ELT(r_arg_env_type_1, position, cache.get(arg_env_type_1_));
         SET_INTEGER_ELT(r_arg_env_id_1, position, arg_env_id_1_);
 
-        SET_STRING_ELT(r_arg_env_type_2, position, make_char(arg_env_type_2_));
+        SET_STRING_ELT(r_arg_env_type_2, position, cache.get(arg_env_type_2_));
         SET_INTEGER_ELT(r_arg_env_id_2, position, arg_env_id_2_);
 
-        SET_STRING_ELT(r_env_name, position, make_char(env_name_));
+        SET_STRING_ELT(r_env_name, position, cache.get(env_name_));
 
-        SET_STRING_ELT(r_symbol, position, make_char(symbol_));
+        SET_STRING_ELT(r_symbol, position, cache.get(symbol_));
 
         SET_LOGICAL_ELT(r_bindings, position, bindings_);
 
-        SET_STRING_ELT(r_fun_type, position, make_char(fun_type_));
+        SET_STRING_ELT(r_fun_type, position, cache.get(fun_type_));
         SET_INTEGER_ELT(r_fun_id, position, fun_id_);
 
-        SET_STRING_ELT(r_n_type, position, make_char(n_type_));
+        SET_STRING_ELT(r_n_type, position, cache.get(n_type_));
         SET_INTEGER_ELT(r_n, position, n_);
 
-        SET_STRING_ELT(r_which_type, position, make_char(which_type_));
+        SET_STRING_ELT(r_which_type, position, cache.get(which_type_));
         SET_INTEGER_ELT(r_which, position, which_);
 
-        SET_STRING_ELT(r_x_type, position, make_char(x_type_));
+        SET_STRING_ELT(r_x_type, position, cache.get(x_type_));
         SET_INTEGER_ELT(r_x_int, position, x_int_);
         SET_STRING_ELT(r_x_char, position, make_char(x_char_));
 
         SET_STRING_ELT(r_seq_env_id, position, make_char(seq_env_id_));
 
         SET_INTEGER_ELT(r_se_env_id, position, se_env_id_);
-        SET_STRING_ELT(r_se_val_type, position, make_char(se_val_type_));
+        SET_STRING_ELT(r_se_val_type, position, cache.get(se_val_type_));
 
         SET_INTEGER_ELT(r_source_fun_id_1, position, source_fun_id_1_);
         SET_INTEGER_ELT(r_source_call_id_1, position, source_call_id_1_);
@@ -203,7 +212,46 @@ class EnvironmentAccess {
         SET_INTEGER_ELT(r_source_fun_id_4, position, source_fun_id_4_);
         SET_INTEGER_ELT(r_source_call_id_4, position, source_call_id_4_);
 
-        SET_STRING_ELT(r_backtrace, position, make_char(backtrace_));
+        SET_INTEGER_ELT(r_backtrace, position, backtrace_);
+        SET_REAL_ELT(r_sample_weight, position, sample_weight_);
+    }
+
+    void to_stream(TableStream& stream) const {
+        stream.put_int(time_);
+        stream.put_int(depth_);
+        stream.put_string(fun_name_);
+        stream.put_string(result_env_type_);
+        stream.put_int(result_env_id_);
+        stream.put_string(arg_env_type_1_);
+        stream.put_int(arg_env_id_1_);
+        stream.put_string(arg_env_type_2_);
+        stream.put_int(arg_env_id_2_);
+        stream.put_string(env_name_);
+        stream.put_string(symbol_);
+        stream.put_int(bindings_);
+        stream.put_string(fun_type_);
+        stream.put_int(fun_id_);
+        stream.put_string(n_type_);
+        stream.put_int(n_);
+        stream.put_string(which_type_);
+        stream.put_int(which_);
+        stream.put_string(x_type_);
+        stream.put_int(x_int_);
+        stream.put_string(x_char_);
+        stream.put_string(seq_env_id_);
+        stream.put_int(se_env_id_);
+        stream.put_string(se_val_type_);
+        stream.put_int(source_fun_id_1_);
+        stream.put_int(source_call_id_1_);
+        stream.put_int(source_fun_id_2_);
+        stream.put_int(source_call_id_2_);
+        stream.put_int(source_fun_id_3_);
+        stream.put_int(source_call_id_3_);
+        stream.put_int(source_fun_id_4_);
+        stream.put_int(source_call_id_4_);
+        stream.put_int(backtrace_);
+        stream.put_double(sample_weight_);
+        stream.end_row();
     }
 
   private:
@@ -253,7 +301,8 @@ class EnvironmentAccess {
     int source_fun_id_4_;
     int source_call_id_4_;
 
-    std::string backtrace_;
+    int backtrace_;
+    double sample_weight_;
 };
 
 #endif /* ENVTRACER_ENVIRONMENT_ACCESS_H */
@@ -1,28 +1,84 @@
 #ifndef ENVTRACER_ENVIRONMENT_ACCESS_TABLE_H
 #define ENVTRACER_ENVIRONMENT_ACCESS_TABLE_H
 
+#include "CallbackProfiler.h"
 #include "Call.h"
 #include <unordered_map>
 #include "Function.h"
 #include "Environment.h"
 #include "EnvironmentAccess.h"
+#include "TableStream.h"
+#include "Arena.h"
+#include "AnalysisWorker.h"
+#include "CallSampler.h"
 #include <instrumentr/instrumentr.h>
+#include <memory>
 
 class EnvironmentAccessTable {
   public:
-    EnvironmentAccessTable(): library_counter_(0) {
+    explicit EnvironmentAccessTable(Arena& arena)
+        : arena_(arena), library_counter_(0) {
     }
 
     ~EnvironmentAccessTable() {
         for (auto iter = table_.begin(); iter != table_.end(); ++iter) {
-            delete *iter;
+            arena_.destroy(*iter);
         }
         table_.clear();
     }
 
-    EnvironmentAccess* insert(EnvironmentAccess* env_access) {
+    template <typename... Args>
+    EnvironmentAccess* create(Args&&... args) {
+        return arena_.create<EnvironmentAccess>(allocations_,
+                                                std::forward<Args>(args)...);
+    }
+
+    const ArenaCounter& get_allocations() const {
+        return allocations_;
+    }
+
+    void insert(EnvironmentAccess* env_access) {
+        ProfileScope scope(PROFILE_PHASE_ENV_ACCESS_INSERT);
+
+        if (sampler_ != nullptr) {
+            env_access->set_sample_weight(sampler_->get_weight());
+        }
+
+        if (worker_ != nullptr) {
+            worker_->submit(this, env_access);
+            return;
+        }
+
+        if (append(env_access)) {
+            release(env_access);
+        }
+    }
+
+    /* stores or streams a record, possibly on the analysis worker. Returns
+       true if the record has been streamed and can be released. */
+    bool append(EnvironmentAccess* env_access) {
+        if (stream_) {
+            env_access->to_stream(*stream_);
+            return true;
+        }
         table_.push_back(env_access);
-        return env_access;
+        return false;
+    }
+
+    /* called on the R thread since the arena is not thread safe */
+    void release(EnvironmentAccess* env_access) {
+        arena_.destroy(env_access);
+    }
+
+    /* records are appended on worker instead of the calling thread, or
+       synchronously if worker is null */
+    void set_worker(AnalysisWorker* worker) {
+        worker_ = worker;
+    }
+
+    /* records are weighted by the call they happen in */
+    void set_sampler(const CallSampler* sampler) {
+        sampler_ = sampler;
     }
 
     void push_library() {
@@ -37,6 +93,94 @@ class EnvironmentAccessTable {
         return library_counter_ > 0;
     }
 
+    void enable_streaming(StreamWriter& writer,
+                          const std::string& filepath,
+                          int chunk_size) {
+        stream_.reset(
+            new TableStream(writer, filepath, get_schema(), chunk_size));
+    }
+
+    bool is_streaming() const {
+        return stream_ != nullptr;
+    }
+
+    void close_stream() {
+        stream_->close();
+    }
+
+    static const TableSchema& get_schema() {
+        static const TableSchema schema = {
+            {"time",
+             "depth",
+             "fun_name",
+             "result_env_type",
+             "result_env_id",
+             "arg_env_type_1",
+             "arg_env_id_1",
+             "arg_env_type_2",
+             "arg_env_id_2",
+             "env_name",
+             "symbol",
+             "bindings",
+             "fun_type",
+             "fun_id",
+             "n_type",
+             "n",
+             "which_type",
+             "which",
+             "x_type",
+             "x_int",
+             "x_char",
+             "seq_env_id",
+             "se_env_id",
+             "se_val_type",
+             "source_fun_id_1",
+             "source_call_id_1",
+             "source_fun_id_2",
+             "source_call_id_2",
+             "source_fun_id_3",
+             "source_call_id_3",
+             "source_fun_id_4",
+             "source_call_id_4",
+             "backtrace",
+             "sample_weight"},
+            {ColumnType::Integer,
+             ColumnType::Integer,
+             ColumnType::String,
+             ColumnType::String,
+             ColumnType::Integer,
+             ColumnType::String,
+             ColumnType::Integer,
+             ColumnType::String,
+             ColumnType::Integer,
+             ColumnType::String,
+             ColumnType::String,
+             ColumnType::Integer,
+             ColumnType::String,
+             ColumnType::Integer,
+             ColumnType::String,
+             ColumnType::Integer,
+             ColumnType::String,
+             ColumnType::Integer,
+             ColumnType::String,
+             ColumnType::Integer,
+             ColumnType::String,
+             ColumnType::String,
+             ColumnType::Integer,
+             ColumnType::String,
+             ColumnType::Integer,
+             ColumnType::Integer,
+             ColumnType::Integer,
+             ColumnType::Integer,
+             ColumnType::Integer,
+             ColumnType::Integer,
+             ColumnType::Integer,
+             ColumnType::Integer,
+             ColumnType::Integer,
+             ColumnType::Double}};
+        return schema;
+    }
+
     SEXP to_sexp() {
         int size = table_.size();
 
@@ -72,12 +216,16 @@ class EnvironmentAccessTable {
         SEXP r_source_call_id_3 = PROTECT(allocVector(INTSXP, size));
         SEXP r_source_fun_id_4 = PROTECT(allocVector(INTSXP, size));
         SEXP r_source_call_id_4 = PROTECT(allocVector(INTSXP, size));
-        SEXP r_backtrace = PROTECT(allocVector(STRSXP, size));
+        SEXP r_backtrace = PROTECT(allocVector(INTSXP, size));
+        SEXP r_sample_weight = PROTECT(allocVector(REALSXP, size));
+
+        CharCache cache;
 
         for (int index = 0; index < size; ++index) {
             EnvironmentAccess* env_access = table_[index];
 
             env_access->to_sexp(index,
+                                cache,
                                 r_time,
                                 r_depth,
                                 r_fun_name,
@@ -110,7 +258,8 @@ class EnvironmentAccessTable {
                                 r_source_call_id_3,
                                 r_source_fun_id_4,
                                 r_source_call_id_4,
-                                r_backtrace);
+                                r_backtrace,
+                                r_sample_weight);
         }
 
         std::vector<SEXP> columns({r_time,
@@ -145,50 +294,24 @@ class EnvironmentAccessTable {
                                    r_source_call_id_3,
                                    r_source_fun_id_4,
                                    r_source_call_id_4,
-                                   r_backtrace});
-
-        std::vector<std::string> names({"time",
-                                        "depth",
-                                        "fun_name",
-                                        "result_env_type",
-                                        "result_env_id",
-                                        "arg_env_type_1",
-                                        "arg_env_id_1",
-                                        "arg_env_type_2",
-                                        "arg_env_id_2",
-                                        "env_name",
-                                        "symbol",
-                                        "bindings",
-                                        "fun_type",
-                                        "fun_id",
-                                        "n_type",
-                                        "n",
-                                        "which_type",
-                                        "which",
-                                        "x_type",
-                                        "x_int",
-                                        "x_char",
-                                        "seq_env_id",
-                                        "se_env_id",
-                                        "se_val_type",
-                                        "source_fun_id_1",
-                                        "source_call_id_1",
-                                        "source_fun_id_2",
-                                        "source_call_id_2",
-                                        "source_fun_id_3",
-                                        "source_call_id_3",
-                                        "source_fun_id_4",
-                                        "source_call_id_4",
-                                        "backtrace"});
+                                   r_backtrace,
+                                   r_sample_weight});
+
+        const std::vector<std::string>& names = get_schema().names;
 
         SEXP df = create_data_frame(names, columns);
 
-        UNPROTECT(33);
+        UNPROTECT(34);
 
         return df;
     }
 
   private:
+    Arena& arena_;
+    ArenaCounter allocations_;
+    std::unique_ptr<TableStream> stream_;
+    AnalysisWorker* worker_ = nullptr;
+    const CallSampler* sampler_ = nullptr;
     int library_counter_;
     std::vector<EnvironmentAccess*> table_;
 };
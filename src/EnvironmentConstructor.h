@@ -3,6 +3,7 @@
 
 #include <string>
 #include "utilities.h"
+#include "TableStream.h"
 
 class EnvironmentConstructor {
   public:
@@ -21,7 +22,7 @@ class EnvironmentConstructor {
                            int size,
                            int frame_count,
                            const std::string& parent_type,
-                           const std::string& backtrace)
+                           int backtrace)
         : env_id_(env_id)
         , source_fun_id_1_(source_fun_id_1)
         , source_call_id_1_(source_call_id_1)
@@ -37,10 +38,17 @@ class EnvironmentConstructor {
         , size_(size)
         , frame_count_(frame_count)
         , parent_type_(parent_type)
-        , backtrace_(backtrace) {
+        , backtrace_(backtrace)
+        , sample_weight_(1) {
+    }
+
+    /* number of events this event stands for when calls are sampled */
+    void set_sample_weight(double sample_weight) {
+        sample_weight_ = sample_weight;
     }
 
     void to_sexp(int position,
+                 CharCache& cache,
                  SEXP r_env_id,
                  SEXP r_source_fun_id_1,
                  SEXP r_source_call_id_1,
@@ -56,7 +64,8 @@ class EnvironmentConstructor {
                  SEXP r_size,
                  SEXP r_frame_count,
                  SEXP r_parent_type,
-                 SEXP r_backtrace) {
+                 SEXP r_backtrace,
+                 SEXP r_sample_weight) {
         SET_INTEGER_ELT(r_env_id, position, env_id_);
         SET_INTEGER_ELT(r_source_fun_id_1, position, source_fun_id_1_);
         SET_INTEGER_ELT(r_source_call_id_1, position, source_call_id_1_);
@@ -71,8 +80,30 @@ class EnvironmentConstructor {
         SET_INTEGER_ELT(r_parent_env_depth, position, parent_env_depth_);
         SET_INTEGER_ELT(r_size, position, size_);
         SET_INTEGER_ELT(r_frame_count, position, frame_count_);
-        SET_STRING_ELT(r_parent_type, position, make_char(parent_type_));
-        SET_STRING_ELT(r_backtrace, position, make_char(backtrace_));
+        SET_STRING_ELT(r_parent_type, position, cache.get(parent_type_));
+        SET_INTEGER_ELT(r_backtrace, position, backtrace_);
+        SET_REAL_ELT(r_sample_weight, position, sample_weight_);
+    }
+
+    void to_stream(TableStream& stream) const {
+        stream.put_int(env_id_);
+        stream.put_int(source_fun_id_1_);
+        stream.put_int(source_call_id_1_);
+        stream.put_int(source_fun_id_2_);
+        stream.put_int(source_call_id_2_);
+        stream.put_int(source_fun_id_3_);
+        stream.put_int(source_call_id_3_);
+        stream.put_int(source_fun_id_4_);
+        stream.put_int(source_call_id_4_);
+        stream.put_int(hash_);
+        stream.put_int(parent_env_id_);
+        stream.put_int(parent_env_depth_);
+        stream.put_int(size_);
+        stream.put_int(frame_count_);
+        stream.put_string(parent_type_);
+        stream.put_int(backtrace_);
+        stream.put_double(sample_weight_);
+        stream.end_row();
     }
 
   private:
@@ -91,7 +122,8 @@ class EnvironmentConstructor {
     int size_;
     int frame_count_;
     const std::string parent_type_;
-    const std::string backtrace_;
+    const int backtrace_;
+    double sample_weight_;
 };
 
 #endif /* ENVTRACER_ENVIRONMENT_CONSTRUCTOR_H */
@@ -1,28 +1,137 @@
 #ifndef ENVTRACER_ENVIRONMENT_CONSTRUCTOR_TABLE_H
 #define ENVTRACER_ENVIRONMENT_CONSTRUCTOR_TABLE_H
 
+#include "CallbackProfiler.h"
 #include "Call.h"
 #include <unordered_map>
 #include "Function.h"
 #include "Environment.h"
 #include "EnvironmentConstructor.h"
+#include "TableStream.h"
+#include "Arena.h"
+#include "AnalysisWorker.h"
+#include "CallSampler.h"
 #include <instrumentr/instrumentr.h>
+#include <memory>
 
 class EnvironmentConstructorTable {
   public:
-    EnvironmentConstructorTable() {
+    explicit EnvironmentConstructorTable(Arena& arena): arena_(arena) {
     }
 
     ~EnvironmentConstructorTable() {
         for (auto iter = table_.begin(); iter != table_.end(); ++iter) {
-            delete *iter;
+            arena_.destroy(*iter);
         }
         table_.clear();
     }
 
-    EnvironmentConstructor* insert(EnvironmentConstructor* env_constructor) {
+    template <typename... Args>
+    EnvironmentConstructor* create(Args&&... args) {
+        return arena_.create<EnvironmentConstructor>(
+            allocations_, std::forward<Args>(args)...);
+    }
+
+    const ArenaCounter& get_allocations() const {
+        return allocations_;
+    }
+
+    void insert(EnvironmentConstructor* env_constructor) {
+        ProfileScope scope(PROFILE_PHASE_ENV_CONSTRUCTOR_INSERT);
+
+        if (sampler_ != nullptr) {
+            env_constructor->set_sample_weight(sampler_->get_weight());
+        }
+
+        if (worker_ != nullptr) {
+            worker_->submit(this, env_constructor);
+            return;
+        }
+
+        if (append(env_constructor)) {
+            release(env_constructor);
+        }
+    }
+
+    /* stores or streams a record, possibly on the analysis worker. Returns
+       true if the record has been streamed and can be released. */
+    bool append(EnvironmentConstructor* env_constructor) {
+        if (stream_) {
+            env_constructor->to_stream(*stream_);
+            return true;
+        }
         table_.push_back(env_constructor);
-        return env_constructor;
+        return false;
+    }
+
+    /* called on the R thread since the arena is not thread safe */
+    void release(EnvironmentConstructor* env_constructor) {
+        arena_.destroy(env_constructor);
+    }
+
+    /* records are appended on worker instead of the calling thread, or
+       synchronously if worker is null */
+    void set_worker(AnalysisWorker* worker) {
+        worker_ = worker;
+    }
+
+    /* records are weighted by the call they happen in */
+    void set_sampler(const CallSampler* sampler) {
+        sampler_ = sampler;
+    }
+
+    void enable_streaming(StreamWriter& writer,
+                          const std::string& filepath,
+                          int chunk_size) {
+        stream_.reset(
+            new TableStream(writer, filepath, get_schema(), chunk_size));
+    }
+
+    bool is_streaming() const {
+        return stream_ != nullptr;
+    }
+
+    void close_stream() {
+        stream_->close();
+    }
+
+    static const TableSchema& get_schema() {
+        static const TableSchema schema = {
+            {"env_id",
+             "source_fun_id_1",
+             "source_call_id_1",
+             "source_fun_id_2",
+             "source_call_id_2",
+             "source_fun_id_3",
+             "source_call_id_3",
+             "source_fun_id_4",
+             "source_call_id_4",
+             "hash",
+             "parent_env_id",
+             "parent_env_depth",
+             "size",
+             "frame_count",
+             "parent_type",
+             "backtrace",
+             "sample_weight"},
+            {ColumnType::Integer,
+             ColumnType::Integer,
+             ColumnType::Integer,
+             ColumnType::Integer,
+             ColumnType::Integer,
+             ColumnType::Integer,
+             ColumnType::Integer,
+             ColumnType::Integer,
+             ColumnType::Integer,
+             ColumnType::Integer,
+             ColumnType::Integer,
+             ColumnType::Integer,
+             ColumnType::Integer,
+             ColumnType::Integer,
+             ColumnType::String,
+             ColumnType::Integer,
+             ColumnType::Double}};
+        return schema;
     }
 
     SEXP to_sexp() {
@@ -43,12 +152,16 @@ class EnvironmentConstructorTable {
         SEXP r_size = PROTECT(allocVector(INTSXP, size));
         SEXP r_frame_count = PROTECT(allocVector(INTSXP, size));
         SEXP r_parent_type = PROTECT(allocVector(STRSXP, size));
-        SEXP r_backtrace = PROTECT(allocVector(STRSXP, size));
+        SEXP r_backtrace = PROTECT(allocVector(INTSXP, size));
+        SEXP r_sample_weight = PROTECT(allocVector(REALSXP, size));
+
+        CharCache cache;
 
         for (int index = 0; index < table_.size(); ++index) {
             EnvironmentConstructor* env_constructor = table_[index];
 
             env_constructor->to_sexp(index,
+                                     cache,
                                      r_env_id,
                                      r_source_fun_id_1,
                                      r_source_call_id_1,
@@ -64,7 +177,8 @@ class EnvironmentConstructorTable {
                                      r_size,
                                      r_frame_count,
                                      r_parent_type,
-                                     r_backtrace);
+                                     r_backtrace,
+                                     r_sample_weight);
         }
 
         std::vector<SEXP> columns({r_env_id,
@@ -82,33 +196,24 @@ class EnvironmentConstructorTable {
                                    r_size,
                                    r_frame_count,
                                    r_parent_type,
-                                   r_backtrace});
-
-        std::vector<std::string> names({"env_id",
-                                        "source_fun_id_1",
-                                        "source_call_id_1",
-                                        "source_fun_id_2",
-                                        "source_call_id_2",
-                                        "source_fun_id_3",
-                                        "source_call_id_3",
-                                        "source_fun_id_4",
-                                        "source_call_id_4",
-                                        "hash",
-                                        "parent_env_id",
-                                        "parent_env_depth",
-                                        "size",
-                                        "frame_count",
-                                        "parent_type",
-                                        "backtrace"});
+                                   r_backtrace,
+                                   r_sample_weight});
+
+        const std::vector<std::string>& names = get_schema().names;
 
         SEXP df = create_data_frame(names, columns);
 
-        UNPROTECT(16);
+        UNPROTECT(17);
 
         return df;
     }
 
   private:
+    Arena& arena_;
+    ArenaCounter allocations_;
+    std::unique_ptr<TableStream> stream_;
+    AnalysisWorker* worker_ = nullptr;
+    const CallSampler* sampler_ = nullptr;
     std::vector<EnvironmentConstructor*> table_;
 };
 
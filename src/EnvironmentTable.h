@@ -1,49 +1,63 @@
 #ifndef ENVTRACER_ENVIRONMENT_TABLE_H
 #define ENVTRACER_ENVIRONMENT_TABLE_H
 
+#include "CallbackProfiler.h"
+#include "Arena.h"
 #include "Environment.h"
+#include "IdBitset.h"
+#include <algorithm>
+#include <cstring>
+#include <deque>
 #include <unordered_map>
 #include <instrumentr/instrumentr.h>
 
+/* Environments are stored column-wise in EnvironmentColumns; slots_ maps
+   instrumentr environment ids to dense slots and handles_ holds a stable
+   Environment handle per slot. */
 class EnvironmentTable {
   public:
     EnvironmentTable() {
     }
 
-    ~EnvironmentTable() {
-        for (auto iter = table_.begin(); iter != table_.end(); ++iter) {
-            delete iter->second;
-        }
-        table_.clear();
-    }
-
+    /* Known environments are found with a single probe; the call of a call
+       environment is only looked up again while it is still unknown. */
     Environment* insert(instrumentr_environment_t environment) {
-        int env_id = instrumentr_environment_get_id(environment);
+        ProfileScope scope(PROFILE_PHASE_ENVIRONMENT_INSERT);
 
-        bool hashed = instrumentr_environment_is_hashed(environment);
+        int env_id = instrumentr_environment_get_id(environment);
 
-        int parent_env_id = get_parent_id_(environment);
+        auto iter = slots_.find(env_id);
 
-        int call_id = NA_INTEGER;
+        if (iter != slots_.end()) {
+            Environment* env = &handles_[iter->second];
+            if (!resolved_calls_.contains(iter->second)) {
+                instrumentr_environment_type_t type =
+                    instrumentr_environment_get_type(environment);
+                env->set_call_id(get_call_id_(environment, type));
+                resolve_call_(iter->second, type, env->get_call_id());
+            }
+            return env;
+        }
 
         instrumentr_environment_type_t type =
             instrumentr_environment_get_type(environment);
 
-        if (type == INSTRUMENTR_ENVIRONMENT_TYPE_CALL) {
-            instrumentr_call_t call =
-                instrumentr_environment_get_call(environment);
-            call_id = instrumentr_call_get_id(call);
-        }
+        int call_id = get_call_id_(environment, type);
 
-        auto iter = table_.find(env_id);
+        bool hashed = instrumentr_environment_is_hashed(environment);
 
-        if (iter != table_.end()) {
-            iter->second->set_call_id(call_id);
-            return iter->second;
-        }
+        int parent_env_id = get_parent_id_(environment);
+
+        int slot = columns_.add(env_id, hashed, parent_env_id, call_id);
+
+        slots_.insert({env_id, slot});
+        handles_.emplace_back(&columns_, slot);
+        resolve_call_(slot, type, call_id);
+
+        ++allocations_.objects;
+        allocations_.bytes += EnvironmentColumns::get_row_size();
 
-        Environment* env =
-            new Environment(env_id, hashed, parent_env_id, call_id);
+        Environment* env = &handles_.back();
 
         const char* env_name = instrumentr_environment_get_name(environment);
         env->set_name(env_name);
@@ -51,70 +65,116 @@ class EnvironmentTable {
         const char* env_type = instrumentr_environment_type_to_string(type);
         env->set_type(env_type);
 
-        auto result = table_.insert({env_id, env});
-        return result.first->second;
+        return env;
+    }
+
+    /* Fills slots with the environment an eval in environment marks and
+       its ancestors, stopping before the first package or namespace
+       environment. Each environment's next marked ancestor is resolved
+       through instrumentr once and then followed by slot, so the walk is
+       linear in the number of marked environments; it is not avoided
+       since each of them gets its own evals row and event. */
+    void get_eval_scope(instrumentr_environment_t environment,
+                        std::vector<int>& slots) {
+        if (is_eval_boundary_(environment)) {
+            return;
+        }
+
+        int slot = insert(environment)->get_slot();
+
+        /* environment of slot while links are resolved through
+           instrumentr; once a resolved link is followed, all further
+           links are resolved as well */
+        instrumentr_environment_t current = environment;
+
+        while (slot != EVAL_PARENT_NONE) {
+            slots.push_back(slot);
+
+            int next = columns_.eval_parent[slot];
+
+            if (next == EVAL_PARENT_UNRESOLVED) {
+                if (current == nullptr) {
+                    break;
+                }
+                next = resolve_eval_parent_(current);
+                columns_.eval_parent[slot] = next;
+            } else {
+                current = nullptr;
+            }
+
+            slot = next;
+        }
+    }
+
+    /* called when the parent of an environment is changed */
+    void invalidate_eval_parents() {
+        std::fill(columns_.eval_parent.begin(),
+                  columns_.eval_parent.end(),
+                  EVAL_PARENT_UNRESOLVED);
+    }
+
+    Environment* get(int slot) {
+        return &handles_[slot];
+    }
+
+    void set_event_seq_cap(int cap) {
+        columns_.event_seq_cap = cap;
     }
 
     Environment* lookup(int environment_id) {
-        auto result = table_.find(environment_id);
-        if (result == table_.end()) {
+        auto result = slots_.find(environment_id);
+        if (result == slots_.end()) {
             return NULL;
         }
-        return result->second;
+        return &handles_[result->second];
     }
 
     SEXP to_sexp() {
-        int size = table_.size();
+        int size = columns_.size();
 
-        SEXP r_env_id = PROTECT(allocVector(INTSXP, size));
-        SEXP r_hashed = PROTECT(allocVector(LGLSXP, size));
-        SEXP r_parent_env_id = PROTECT(allocVector(INTSXP, size));
+        SEXP r_env_id = PROTECT(copy_column_(INTSXP, columns_.env_id));
+        SEXP r_hashed = PROTECT(copy_column_(LGLSXP, columns_.hashed));
+        SEXP r_parent_env_id =
+            PROTECT(copy_column_(INTSXP, columns_.parent_env_id));
         SEXP r_env_type = PROTECT(allocVector(STRSXP, size));
         SEXP r_env_name = PROTECT(allocVector(STRSXP, size));
-        SEXP r_call_id = PROTECT(allocVector(INTSXP, size));
+        SEXP r_call_id = PROTECT(copy_column_(INTSXP, columns_.call_id));
         SEXP r_classes = PROTECT(allocVector(STRSXP, size));
-        SEXP r_evals = PROTECT(allocVector(INTSXP, size));
+        SEXP r_evals = PROTECT(copy_column_(INTSXP, columns_.evals));
         SEXP r_package = PROTECT(allocVector(STRSXP, size));
         SEXP r_constructor = PROTECT(allocVector(STRSXP, size));
-        SEXP r_source_fun_id_1 = PROTECT(allocVector(INTSXP, size));
-        SEXP r_source_call_id_1 = PROTECT(allocVector(INTSXP, size));
-        SEXP r_source_fun_id_2 = PROTECT(allocVector(INTSXP, size));
-        SEXP r_source_call_id_2 = PROTECT(allocVector(INTSXP, size));
-        SEXP r_source_fun_id_3 = PROTECT(allocVector(INTSXP, size));
-        SEXP r_source_call_id_3 = PROTECT(allocVector(INTSXP, size));
-        SEXP r_source_fun_id_4 = PROTECT(allocVector(INTSXP, size));
-        SEXP r_source_call_id_4 = PROTECT(allocVector(INTSXP, size));
-        SEXP r_dispatch = PROTECT(allocVector(LGLSXP, size));
+        SEXP r_source_fun_id_1 =
+            PROTECT(copy_column_(INTSXP, columns_.source[0]));
+        SEXP r_source_call_id_1 =
+            PROTECT(copy_column_(INTSXP, columns_.source[1]));
+        SEXP r_source_fun_id_2 =
+            PROTECT(copy_column_(INTSXP, columns_.source[2]));
+        SEXP r_source_call_id_2 =
+            PROTECT(copy_column_(INTSXP, columns_.source[3]));
+        SEXP r_source_fun_id_3 =
+            PROTECT(copy_column_(INTSXP, columns_.source[4]));
+        SEXP r_source_call_id_3 =
+            PROTECT(copy_column_(INTSXP, columns_.source[5]));
+        SEXP r_source_fun_id_4 =
+            PROTECT(copy_column_(INTSXP, columns_.source[6]));
+        SEXP r_source_call_id_4 =
+            PROTECT(copy_column_(INTSXP, columns_.source[7]));
+        SEXP r_dispatch = PROTECT(copy_column_(LGLSXP, columns_.dispatch));
         SEXP r_event_seq = PROTECT(allocVector(STRSXP, size));
-        SEXP r_backtrace = PROTECT(allocVector(STRSXP, size));
-
-        int index = 0;
-        for (auto iter = table_.begin(); iter != table_.end();
-             ++iter, ++index) {
-            Environment* environment = iter->second;
-
-            environment->to_sexp(index,
-                                 r_env_id,
-                                 r_hashed,
-                                 r_parent_env_id,
-                                 r_env_type,
-                                 r_env_name,
-                                 r_call_id,
-                                 r_classes,
-                                 r_evals,
-                                 r_package,
-                                 r_constructor,
-                                 r_source_fun_id_1,
-                                 r_source_call_id_1,
-                                 r_source_fun_id_2,
-                                 r_source_call_id_2,
-                                 r_source_fun_id_3,
-                                 r_source_call_id_3,
-                                 r_source_fun_id_4,
-                                 r_source_call_id_4,
-                                 r_dispatch,
-                                 r_event_seq,
-                                 r_backtrace);
+        SEXP r_backtrace = PROTECT(copy_column_(INTSXP, columns_.backtrace));
+
+        CharCache cache;
+
+        for (int index = 0; index < size; ++index) {
+            const EnvironmentColdData& cold = columns_.cold[index];
+            SET_STRING_ELT(r_env_type, index, cache.get(cold.env_type));
+            SET_STRING_ELT(r_env_name, index, cache.get(cold.env_name));
+            SET_STRING_ELT(r_classes, index, make_char(cold.classes));
+            SET_STRING_ELT(r_package, index, cache.get(cold.package));
+            SET_STRING_ELT(r_constructor, index, cache.get(cold.constructor));
+            SET_STRING_ELT(r_event_seq,
+                           index,
+                           make_char(cold.event_seq.decode(columns_.events)));
         }
 
         std::vector<SEXP> columns({r_env_id,          r_hashed,
@@ -148,8 +208,72 @@ class EnvironmentTable {
         return df;
     }
 
+    const ArenaCounter& get_allocations() const {
+        return allocations_;
+    }
+
   private:
-    std::unordered_map<int, Environment*> table_;
+    static bool is_eval_boundary_(instrumentr_environment_t environment) {
+        instrumentr_environment_type_t type =
+            instrumentr_environment_get_type(environment);
+        return type == INSTRUMENTR_ENVIRONMENT_TYPE_NAMESPACE ||
+               type == INSTRUMENTR_ENVIRONMENT_TYPE_PACKAGE;
+    }
+
+    /* resolves the link of environment, which becomes its parent */
+    int resolve_eval_parent_(instrumentr_environment_t& environment) {
+        instrumentr_value_t parent =
+            instrumentr_environment_get_parent(environment);
+
+        if (!instrumentr_value_is_environment(parent)) {
+            return EVAL_PARENT_NONE;
+        }
+
+        environment = instrumentr_value_as_environment(parent);
+
+        if (is_eval_boundary_(environment)) {
+            return EVAL_PARENT_NONE;
+        }
+
+        return insert(environment)->get_slot();
+    }
+
+    /* the call of slot is final once it is known or if slot is not a call
+       environment */
+    void resolve_call_(int slot,
+                       instrumentr_environment_type_t type,
+                       int call_id) {
+        if (type != INSTRUMENTR_ENVIRONMENT_TYPE_CALL ||
+            call_id != NA_INTEGER) {
+            resolved_calls_.insert(slot);
+        }
+    }
+
+    static int get_call_id_(instrumentr_environment_t environment,
+                            instrumentr_environment_type_t type) {
+        if (type != INSTRUMENTR_ENVIRONMENT_TYPE_CALL) {
+            return NA_INTEGER;
+        }
+
+        instrumentr_call_t call = instrumentr_environment_get_call(environment);
+        return instrumentr_call_get_id(call);
+    }
+
+    static SEXP copy_column_(SEXPTYPE type, const std::vector<int>& column) {
+        SEXP r_column = allocVector(type, column.size());
+        if (!column.empty()) {
+            int* output =
+                type == INTSXP ? INTEGER(r_column) : LOGICAL(r_column);
+            std::memcpy(output, column.data(), column.size() * sizeof(int));
+        }
+        return r_column;
+    }
+
+    ArenaCounter allocations_;
+    EnvironmentColumns columns_;
+    std::unordered_map<int, int> slots_;
+    std::deque<Environment> handles_;
+    IdBitset resolved_calls_;
 
     int get_parent_id_(instrumentr_environment_t environment) {
         int parent_id = NA_INTEGER;
@@ -3,6 +3,7 @@
 
 #include <string>
 #include "utilities.h"
+#include "TableStream.h"
 
 class Eval {
   public:
@@ -18,7 +19,7 @@ class Eval {
          int source_call_id_3,
          int source_fun_id_4,
          int source_call_id_4,
-         const std::string& backtrace)
+         int backtrace)
         : time_(time)
         , env_id_(env_id)
         , direct_(direct)
@@ -31,7 +32,13 @@ class Eval {
         , source_call_id_3_(source_call_id_3)
         , source_fun_id_4_(source_fun_id_4)
         , source_call_id_4_(source_call_id_4)
-        , backtrace_(backtrace) {
+        , backtrace_(backtrace)
+        , sample_weight_(1) {
+    }
+
+    /* number of events this event stands for when calls are sampled */
+    void set_sample_weight(double sample_weight) {
+        sample_weight_ = sample_weight;
     }
 
     void to_sexp(int position,
@@ -47,7 +54,8 @@ class Eval {
                  SEXP r_source_call_id_3,
                  SEXP r_source_fun_id_4,
                  SEXP r_source_call_id_4,
-                 SEXP r_backtrace) {
+                 SEXP r_backtrace,
+                 SEXP r_sample_weight) {
         SET_INTEGER_ELT(r_time, position, time_);
         SET_INTEGER_ELT(r_env_id, position, env_id_);
         SET_LOGICAL_ELT(r_direct, position, direct_);
@@ -60,7 +68,26 @@ class Eval {
         SET_INTEGER_ELT(r_source_call_id_3, position, source_call_id_3_);
         SET_INTEGER_ELT(r_source_fun_id_4, position, source_fun_id_4_);
         SET_INTEGER_ELT(r_source_call_id_4, position, source_call_id_4_);
-        SET_STRING_ELT(r_backtrace, position, make_char(backtrace_));
+        SET_INTEGER_ELT(r_backtrace, position, backtrace_);
+        SET_REAL_ELT(r_sample_weight, position, sample_weight_);
+    }
+
+    void to_stream(TableStream& stream) const {
+        stream.put_int(time_);
+        stream.put_int(env_id_);
+        stream.put_logical(direct_);
+        stream.put_string(expression_);
+        stream.put_int(source_fun_id_1_);
+        stream.put_int(source_call_id_1_);
+        stream.put_int(source_fun_id_2_);
+        stream.put_int(source_call_id_2_);
+        stream.put_int(source_fun_id_3_);
+        stream.put_int(source_call_id_3_);
+        stream.put_int(source_fun_id_4_);
+        stream.put_int(source_call_id_4_);
+        stream.put_int(backtrace_);
+        stream.put_double(sample_weight_);
+        stream.end_row();
     }
 
   private:
@@ -76,7 +103,8 @@ class Eval {
     int source_call_id_3_;
     int source_fun_id_4_;
     int source_call_id_4_;
-    const std::string backtrace_;
+    const int backtrace_;
+    double sample_weight_;
 };
 
 #endif /* ENVTRACER_EVAL_H */
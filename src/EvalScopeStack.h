@@ -0,0 +1,71 @@
+#ifndef ENVTRACER_EVAL_SCOPE_STACK_H
+#define ENVTRACER_EVAL_SCOPE_STACK_H
+
+#include "IdBitset.h"
+#include <vector>
+
+/* Environments under evaluation. An eval marks the environment it
+   evaluates in and its ancestors up to the first package or namespace
+   environment. Each active eval is a scope holding the slots it marked,
+   so that exiting it does not walk the parent chain again. A slot is
+   under eval while some scope holds it; variable callbacks check this
+   with a single bit test. */
+class EvalScopeStack {
+  public:
+    EvalScopeStack(): depth_(0) {
+    }
+
+    /* empty scope to be filled with slots before calling enter */
+    std::vector<int>& prepare() {
+        if (depth_ == scopes_.size()) {
+            scopes_.emplace_back();
+        }
+        scopes_[depth_].clear();
+        return scopes_[depth_];
+    }
+
+    /* activates the prepared scope */
+    void enter() {
+        for (int slot: scopes_[depth_]) {
+            if (slot >= static_cast<int>(counts_.size())) {
+                counts_.resize(slot + 1, 0);
+            }
+            if (counts_[slot]++ == 0) {
+                under_eval_.insert(slot);
+            }
+        }
+        ++depth_;
+    }
+
+    /* deactivates the innermost scope and returns its slots */
+    const std::vector<int>& exit() {
+        static const std::vector<int> empty;
+
+        if (depth_ == 0) {
+            return empty;
+        }
+
+        --depth_;
+
+        for (int slot: scopes_[depth_]) {
+            if (--counts_[slot] == 0) {
+                under_eval_.erase(slot);
+            }
+        }
+
+        return scopes_[depth_];
+    }
+
+    bool is_under_eval(int slot) const {
+        return under_eval_.contains(slot);
+    }
+
+  private:
+    /* scopes are reused so that their slot vectors keep their capacity */
+    std::vector<std::vector<int>> scopes_;
+    std::size_t depth_;
+    std::vector<int> counts_;
+    IdBitset under_eval_;
+};
+
+#endif /* ENVTRACER_EVAL_SCOPE_STACK_H */
@@ -1,28 +1,130 @@
 #ifndef ENVTRACER_EVAL_TABLE_H
 #define ENVTRACER_EVAL_TABLE_H
 
+#include "CallbackProfiler.h"
 #include "Call.h"
 #include <unordered_map>
 #include "Function.h"
 #include "Environment.h"
 #include "Eval.h"
+#include "TableStream.h"
+#include "Arena.h"
+#include "AnalysisWorker.h"
+#include "CallSampler.h"
 #include <instrumentr/instrumentr.h>
+#include <memory>
 
 class EvalTable {
   public:
-    EvalTable() {
+    explicit EvalTable(Arena& arena): arena_(arena) {
     }
 
     ~EvalTable() {
         for (auto iter = table_.begin(); iter != table_.end(); ++iter) {
-            delete *iter;
+            arena_.destroy(*iter);
         }
         table_.clear();
     }
 
-    Eval* insert(Eval* eval) {
+    template <typename... Args>
+    Eval* create(Args&&... args) {
+        return arena_.create<Eval>(allocations_, std::forward<Args>(args)...);
+    }
+
+    const ArenaCounter& get_allocations() const {
+        return allocations_;
+    }
+
+    void insert(Eval* eval) {
+        ProfileScope scope(PROFILE_PHASE_EVAL_INSERT);
+
+        if (sampler_ != nullptr) {
+            eval->set_sample_weight(sampler_->get_weight());
+        }
+
+        if (worker_ != nullptr) {
+            worker_->submit(this, eval);
+            return;
+        }
+
+        if (append(eval)) {
+            release(eval);
+        }
+    }
+
+    /* stores or streams a record, possibly on the analysis worker. Returns
+       true if the record has been streamed and can be released. */
+    bool append(Eval* eval) {
+        if (stream_) {
+            eval->to_stream(*stream_);
+            return true;
+        }
         table_.push_back(eval);
-        return eval;
+        return false;
+    }
+
+    /* called on the R thread since the arena is not thread safe */
+    void release(Eval* eval) {
+        arena_.destroy(eval);
+    }
+
+    /* records are appended on worker instead of the calling thread, or
+       synchronously if worker is null */
+    void set_worker(AnalysisWorker* worker) {
+        worker_ = worker;
+    }
+
+    /* records are weighted by the call they happen in */
+    void set_sampler(const CallSampler* sampler) {
+        sampler_ = sampler;
+    }
+
+    void enable_streaming(StreamWriter& writer,
+                          const std::string& filepath,
+                          int chunk_size) {
+        stream_.reset(
+            new TableStream(writer, filepath, get_schema(), chunk_size));
+    }
+
+    bool is_streaming() const {
+        return stream_ != nullptr;
+    }
+
+    void close_stream() {
+        stream_->close();
+    }
+
+    static const TableSchema& get_schema() {
+        static const TableSchema schema = {
+            {"time",
+             "env_id",
+             "direct",
+             "expression",
+             "source_fun_id_1",
+             "source_call_id_1",
+             "source_fun_id_2",
+             "source_call_id_2",
+             "source_fun_id_3",
+             "source_call_id_3",
+             "source_fun_id_4",
+             "source_call_id_4",
+             "backtrace",
+             "sample_weight"},
+            {ColumnType::Integer,
+             ColumnType::Integer,
+             ColumnType::Logical,
+             ColumnType::String,
+             ColumnType::Integer,
+             ColumnType::Integer,
+             ColumnType::Integer,
+             ColumnType::Integer,
+             ColumnType::Integer,
+             ColumnType::Integer,
+             ColumnType::Integer,
+             ColumnType::Integer,
+             ColumnType::Integer,
+             ColumnType::Double}};
+        return schema;
     }
 
     SEXP to_sexp() {
@@ -40,7 +142,8 @@ class EvalTable {
         SEXP r_source_call_id_3 = PROTECT(allocVector(INTSXP, size));
         SEXP r_source_fun_id_4 = PROTECT(allocVector(INTSXP, size));
         SEXP r_source_call_id_4 = PROTECT(allocVector(INTSXP, size));
-        SEXP r_backtrace = PROTECT(allocVector(STRSXP, size));
+        SEXP r_backtrace = PROTECT(allocVector(INTSXP, size));
+        SEXP r_sample_weight = PROTECT(allocVector(REALSXP, size));
 
         for (int index = 0; index < table_.size(); ++index) {
             Eval* eval = table_[index];
@@ -58,7 +161,8 @@ class EvalTable {
                           r_source_call_id_3,
                           r_source_fun_id_4,
                           r_source_call_id_4,
-                          r_backtrace);
+                          r_backtrace,
+                          r_sample_weight);
         }
 
         std::vector<SEXP> columns({r_time,
@@ -73,30 +177,24 @@ class EvalTable {
                                    r_source_call_id_3,
                                    r_source_fun_id_4,
                                    r_source_call_id_4,
-                                   r_backtrace});
-
-        std::vector<std::string> names({"time",
-                                        "env_id",
-                                        "direct",
-                                        "expression",
-                                        "source_fun_id_1",
-                                        "source_call_id_1",
-                                        "source_fun_id_2",
-                                        "source_call_id_2",
-                                        "source_fun_id_3",
-                                        "source_call_id_3",
-                                        "source_fun_id_4",
-                                        "source_call_id_4",
-                                        "backtrace"});
+                                   r_backtrace,
+                                   r_sample_weight});
+
+        const std::vector<std::string>& names = get_schema().names;
 
         SEXP df = create_data_frame(names, columns);
 
-        UNPROTECT(13);
+        UNPROTECT(14);
 
         return df;
     }
 
   private:
+    Arena& arena_;
+    ArenaCounter allocations_;
+    std::unique_ptr<TableStream> stream_;
+    AnalysisWorker* worker_ = nullptr;
+    const CallSampler* sampler_ = nullptr;
     std::vector<Eval*> table_;
 };
 
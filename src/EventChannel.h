@@ -0,0 +1,400 @@
+#ifndef ENVTRACER_EVENT_CHANNEL_H
+#define ENVTRACER_EVENT_CHANNEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <mutex>
+#include <new>
+#include <signal.h>
+#include <spawn.h>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+/* NOTE: this header does not depend on R so that the analyzer executable
+   can read the channel outside of an R session. */
+
+extern char** environ;
+
+/* Byte ring in POSIX shared memory that carries table events from the
+   traced process to an analyzer process.
+
+   The traced process creates the segment, spawns the analyzer and then
+   only copies messages into the ring. Each message is a header followed by
+   its payload; messages wrap around the end of the ring.
+
+   header:  uint32 payload size, uint16 kind, uint16 table
+   open:    uint32 path length, path bytes, uint32 column count,
+            per column: uint8 type, uint32 name length, name bytes
+   row:     per integer or logical column: int32 value
+            per double column: float64 value
+            per string column: int32 length (-1 for NA), length bytes
+   close:   empty
+   end:     empty */
+
+#define ENVTRACER_CHANNEL_MAGIC "ENVCHN01"
+#define ENVTRACER_CHANNEL_CAPACITY (64 << 20)
+
+enum class ChannelMessageKind : std::uint16_t {
+    Open = 1,
+    Row = 2,
+    Close = 3,
+    End = 4
+};
+
+struct ChannelMessageHeader {
+    std::uint32_t size;
+    std::uint16_t kind;
+    std::uint16_t table;
+};
+
+class EventChannel {
+  public:
+    /* creates the shared memory segment on the traced side */
+    static EventChannel* create(const std::string& name,
+                                std::size_t capacity) {
+        int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd == -1) {
+            throw std::runtime_error("cannot create shared memory '" + name +
+                                     "': " + std::strerror(errno));
+        }
+
+        std::size_t size = sizeof(Layout) + capacity;
+
+        if (ftruncate(fd, size) == -1) {
+            int code = errno;
+            close(fd);
+            shm_unlink(name.c_str());
+            throw std::runtime_error("cannot resize shared memory '" + name +
+                                     "': " + std::strerror(code));
+        }
+
+        EventChannel* channel = new EventChannel(name, fd, size, true);
+        Layout* layout = channel->layout_;
+        std::memcpy(layout->magic, ENVTRACER_CHANNEL_MAGIC, 8);
+        layout->capacity = capacity;
+        new (&layout->head) std::atomic<std::uint64_t>(0);
+        new (&layout->tail) std::atomic<std::uint64_t>(0);
+        return channel;
+    }
+
+    /* maps an existing segment on the analyzer side and removes its name */
+    static EventChannel* attach(const std::string& name) {
+        int fd = shm_open(name.c_str(), O_RDWR, 0600);
+        if (fd == -1) {
+            throw std::runtime_error("cannot open shared memory '" + name +
+                                     "': " + std::strerror(errno));
+        }
+
+        struct stat info;
+        if (fstat(fd, &info) == -1) {
+            int code = errno;
+            close(fd);
+            throw std::runtime_error("cannot stat shared memory '" + name +
+                                     "': " + std::strerror(code));
+        }
+
+        EventChannel* channel = new EventChannel(name, fd, info.st_size, false);
+        channel->producer_ = getppid();
+
+        if (std::memcmp(channel->layout_->magic,
+                        ENVTRACER_CHANNEL_MAGIC,
+                        8) != 0) {
+            delete channel;
+            throw std::runtime_error("'" + name + "' is not an event channel");
+        }
+
+        /* the mapping stays valid; unlinking here keeps the segment from
+           leaking if the traced process crashes */
+        shm_unlink(name.c_str());
+
+        return channel;
+    }
+
+    ~EventChannel() {
+        if (consumer_ != -1) {
+            kill(consumer_, SIGTERM);
+            waitpid(consumer_, nullptr, 0);
+        }
+        munmap(layout_, size_);
+        if (owner_) {
+            shm_unlink(name_.c_str());
+        }
+    }
+
+    EventChannel(const EventChannel&) = delete;
+    EventChannel& operator=(const EventChannel&) = delete;
+
+    const std::string& get_name() const {
+        return name_;
+    }
+
+    /* starts the analyzer process that consumes the channel */
+    void spawn_consumer(const std::vector<std::string>& arguments) {
+        std::vector<char*> argv;
+        for (const std::string& argument: arguments) {
+            argv.push_back(const_cast<char*>(argument.c_str()));
+        }
+        argv.push_back(nullptr);
+
+        pid_t pid;
+        int code = posix_spawn(
+            &pid, argv[0], nullptr, nullptr, argv.data(), environ);
+
+        if (code != 0) {
+            throw std::runtime_error("cannot start analyzer '" + arguments[0] +
+                                     "': " + std::strerror(code));
+        }
+
+        consumer_ = pid;
+        connected_ = true;
+    }
+
+    /* producer side, safe to call from several threads of the traced
+       process. Returns the table id used by subsequent messages. */
+    std::uint16_t open_table(const std::string& filepath,
+                             const std::vector<std::string>& names,
+                             const std::vector<std::uint8_t>& types) {
+        std::string payload;
+        append_u32_(payload, filepath.size());
+        payload.append(filepath);
+        append_u32_(payload, names.size());
+        for (std::size_t i = 0; i < names.size(); ++i) {
+            payload.push_back(static_cast<char>(types[i]));
+            append_u32_(payload, names[i].size());
+            payload.append(names[i]);
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::uint16_t table = table_count_++;
+        send_(ChannelMessageKind::Open, table, payload.data(), payload.size());
+        return table;
+    }
+
+    /* rows are sent from instrumentr callbacks, where an exception would
+       abort the R session. The first failure is recorded instead, later
+       rows are dropped and finish reports it. */
+    void send_row(std::uint16_t table, const std::string& row) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        post_(ChannelMessageKind::Row, table, row.data(), row.size());
+    }
+
+    void close_table(std::uint16_t table) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        post_(ChannelMessageKind::Close, table, nullptr, 0);
+    }
+
+    /* sends the end message and waits for the analyzer to write out all
+       tables */
+    void finish() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!failure_.empty()) {
+                throw std::runtime_error(failure_);
+            }
+            send_(ChannelMessageKind::End, 0, nullptr, 0);
+        }
+
+        if (consumer_ == -1) {
+            return;
+        }
+
+        int status = 0;
+        pid_t pid = consumer_;
+        consumer_ = -1;
+        connected_ = false;
+
+        if (waitpid(pid, &status, 0) == -1) {
+            throw std::runtime_error(std::string("cannot wait for analyzer: ") +
+                                     std::strerror(errno));
+        }
+
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            throw std::runtime_error("analyzer failed with status " +
+                                     std::to_string(status));
+        }
+    }
+
+    /* consumer side, blocks until a message is available. The payload is
+       only valid until the next call. */
+    const std::string& receive(ChannelMessageHeader& header) {
+        std::uint64_t head = layout_->head.load(std::memory_order_relaxed);
+
+        wait_([&] {
+            return layout_->tail.load(std::memory_order_acquire) != head;
+        });
+
+        read_(head, &header, sizeof(header));
+        payload_.resize(header.size);
+        read_(head + sizeof(header), &payload_[0], header.size);
+
+        layout_->head.store(head + sizeof(header) + header.size,
+                            std::memory_order_release);
+        return payload_;
+    }
+
+  private:
+    /* the indices grow monotonically and are reduced modulo the capacity;
+       padding keeps them on separate cache lines */
+    struct Layout {
+        char magic[8];
+        std::uint64_t capacity;
+        char pad0[48];
+        std::atomic<std::uint64_t> head;
+        char pad1[56];
+        std::atomic<std::uint64_t> tail;
+        char pad2[56];
+    };
+
+    EventChannel(const std::string& name,
+                 int fd,
+                 std::size_t size,
+                 bool owner)
+        : name_(name)
+        , size_(size)
+        , owner_(owner)
+        , consumer_(-1)
+        , producer_(-1)
+        , connected_(false)
+        , table_count_(0) {
+        void* memory =
+            mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        int code = errno;
+        close(fd);
+
+        if (memory == MAP_FAILED) {
+            if (owner) {
+                shm_unlink(name.c_str());
+            }
+            throw std::runtime_error("cannot map shared memory '" + name +
+                                     "': " + std::strerror(code));
+        }
+
+        layout_ = static_cast<Layout*>(memory);
+        data_ = static_cast<char*>(memory) + sizeof(Layout);
+    }
+
+    void send_(ChannelMessageKind kind,
+               std::uint16_t table,
+               const void* payload,
+               std::size_t size) {
+        std::uint64_t capacity = layout_->capacity;
+        std::uint64_t total = sizeof(ChannelMessageHeader) + size;
+
+        /* nothing would drain the ring once the analyzer is gone */
+        if (!connected_) {
+            throw std::runtime_error("analyzer is not running");
+        }
+
+        if (total > capacity) {
+            throw std::runtime_error("event of " + std::to_string(size) +
+                                     " bytes does not fit the channel");
+        }
+
+        std::uint64_t tail = layout_->tail.load(std::memory_order_relaxed);
+
+        wait_([&] {
+            std::uint64_t head = layout_->head.load(std::memory_order_acquire);
+            return capacity - (tail - head) >= total;
+        });
+
+        ChannelMessageHeader header = {static_cast<std::uint32_t>(size),
+                                       static_cast<std::uint16_t>(kind),
+                                       table};
+        write_(tail, &header, sizeof(header));
+        write_(tail + sizeof(header), payload, size);
+
+        layout_->tail.store(tail + total, std::memory_order_release);
+    }
+
+    void post_(ChannelMessageKind kind,
+               std::uint16_t table,
+               const void* payload,
+               std::size_t size) {
+        if (!failure_.empty()) {
+            return;
+        }
+
+        try {
+            send_(kind, table, payload, size);
+        } catch (const std::exception& e) {
+            failure_ = e.what();
+        }
+    }
+
+    /* spins briefly and then sleeps until ready returns true. Either side
+       gives up once the other process has exited. */
+    template <typename Predicate>
+    void wait_(Predicate ready) {
+        for (int spin = 0; !ready(); ++spin) {
+            if (spin < 64) {
+                continue;
+            }
+
+            if (consumer_ != -1 && waitpid(consumer_, nullptr, WNOHANG) != 0) {
+                consumer_ = -1;
+                connected_ = false;
+                throw std::runtime_error("analyzer exited before the end of "
+                                         "tracing");
+            }
+
+            if (producer_ != -1 && getppid() != producer_) {
+                throw std::runtime_error("traced process exited before the "
+                                         "end of tracing");
+            }
+
+            usleep(spin < 1024 ? 0 : 50);
+        }
+    }
+
+    void write_(std::uint64_t position, const void* source, std::size_t size) {
+        std::uint64_t capacity = layout_->capacity;
+        std::size_t offset = position % capacity;
+        std::size_t first = std::min<std::size_t>(size, capacity - offset);
+        const char* bytes = static_cast<const char*>(source);
+
+        std::memcpy(data_ + offset, bytes, first);
+        std::memcpy(data_, bytes + first, size - first);
+    }
+
+    void read_(std::uint64_t position, void* target, std::size_t size) {
+        std::uint64_t capacity = layout_->capacity;
+        std::size_t offset = position % capacity;
+        std::size_t first = std::min<std::size_t>(size, capacity - offset);
+        char* bytes = static_cast<char*>(target);
+
+        std::memcpy(bytes, data_ + offset, first);
+        std::memcpy(bytes + first, data_, size - first);
+    }
+
+    static void append_u32_(std::string& buffer, std::uint32_t value) {
+        buffer.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    std::string name_;
+    std::size_t size_;
+    bool owner_;
+    /* analyzer process, only known to the traced side */
+    pid_t consumer_;
+    /* traced process, only known to the analyzer */
+    pid_t producer_;
+    /* true while the analyzer can receive messages */
+    bool connected_;
+    std::uint16_t table_count_;
+    /* first failed send of the traced side */
+    std::string failure_;
+    Layout* layout_;
+    char* data_;
+    std::mutex mutex_;
+    std::string payload_;
+};
+
+#endif /* ENVTRACER_EVENT_CHANNEL_H */
@@ -0,0 +1,298 @@
+#ifndef ENVTRACER_EVENT_LOG_H
+#define ENVTRACER_EVENT_LOG_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+/* NOTE: this header does not depend on R so that event logs can be
+   replayed outside of an R session. */
+
+/* Binary log of the instrumentr events received by the tracer.
+
+   header:  magic "ENVLOG01"
+   record:  uint8 tag
+   name:    uint32 length, length bytes; the names of a log are numbered
+            from 0 in the order they are defined
+   event:   uint32 event name, int32 call stack size delta,
+            uint8 operand count, operands
+   operand: uint8 kind, int32 id, uint8 type, uint32 name
+
+   Names are defined before the first event that refers to them. The type
+   of an operand is the SEXPTYPE of its value, or of the result for calls;
+   ENVTRACER_LOG_NO_TYPE if it is not known. */
+
+#define ENVTRACER_LOG_MAGIC "ENVLOG01"
+#define ENVTRACER_LOG_MAGIC_SIZE 8
+#define ENVTRACER_LOG_NO_TYPE 0xFF
+#define ENVTRACER_LOG_NO_NAME 0xFFFFFFFF
+
+enum class LogRecordTag : std::uint8_t { Name = 0, Event = 1 };
+
+enum class LogOperandKind : std::uint8_t {
+    Closure = 0,
+    Builtin = 1,
+    Special = 2,
+    Call = 3,
+    Environment = 4,
+    Promise = 5,
+    Value = 6,
+    Symbol = 7,
+    /* id is the number of elements */
+    Character = 8
+};
+
+struct LogOperand {
+    LogOperandKind kind;
+    std::int32_t id;
+    std::uint8_t type;
+    std::uint32_t name;
+};
+
+struct LogEvent {
+    std::uint32_t name;
+    std::int32_t stack_delta;
+    std::vector<LogOperand> operands;
+};
+
+/* Buffered writer. Records are only flushed whole, so a log cut short by a
+   crash still ends at a record boundary of the last flush. */
+class EventLogWriter {
+  public:
+    explicit EventLogWriter(const std::string& filepath,
+                            std::size_t buffer_size = 1 << 20)
+        : filepath_(filepath)
+        , file_(std::fopen(filepath.c_str(), "wb"))
+        , buffer_size_(buffer_size)
+        , stack_size_(0) {
+        if (file_ == nullptr) {
+            throw std::runtime_error("cannot open '" + filepath +
+                                     "' for writing");
+        }
+        buffer_.reserve(buffer_size + 4096);
+        buffer_.append(ENVTRACER_LOG_MAGIC, ENVTRACER_LOG_MAGIC_SIZE);
+    }
+
+    ~EventLogWriter() {
+        try {
+            close();
+        } catch (const std::exception& e) {
+            /* errors are reported by explicit calls to close */
+        }
+    }
+
+    EventLogWriter(const EventLogWriter&) = delete;
+    EventLogWriter& operator=(const EventLogWriter&) = delete;
+
+    /* returns the id of name, defining it if it is new */
+    std::uint32_t intern(const char* name) {
+        if (name == nullptr) {
+            return ENVTRACER_LOG_NO_NAME;
+        }
+
+        auto iter = names_.find(name);
+        if (iter != names_.end()) {
+            return iter->second;
+        }
+
+        std::uint32_t id = names_.size();
+        names_.emplace(name, id);
+
+        std::uint32_t size = std::strlen(name);
+        put_(static_cast<std::uint8_t>(LogRecordTag::Name));
+        put_(size);
+        buffer_.append(name, size);
+        return id;
+    }
+
+    /* the names of operands have to be interned first, since they are
+       defined by records of their own */
+    void write_event(std::uint32_t name,
+                     int stack_size,
+                     const LogOperand* operands,
+                     std::size_t count) {
+        if (buffer_.size() >= buffer_size_) {
+            flush();
+        }
+
+        put_(static_cast<std::uint8_t>(LogRecordTag::Event));
+        put_(name);
+        put_(static_cast<std::int32_t>(stack_size - stack_size_));
+        put_(static_cast<std::uint8_t>(count));
+
+        stack_size_ = stack_size;
+
+        for (std::size_t index = 0; index < count; ++index) {
+            put_(static_cast<std::uint8_t>(operands[index].kind));
+            put_(operands[index].id);
+            put_(operands[index].type);
+            put_(operands[index].name);
+        }
+    }
+
+    void flush() {
+        if (!buffer_.empty() &&
+            std::fwrite(buffer_.data(), 1, buffer_.size(), file_) !=
+                buffer_.size()) {
+            throw std::runtime_error("cannot write to '" + filepath_ + "'");
+        }
+        buffer_.clear();
+    }
+
+    void close() {
+        if (file_ != nullptr) {
+            flush();
+            std::fclose(file_);
+            file_ = nullptr;
+        }
+    }
+
+  private:
+    template <typename T>
+    void put_(T value) {
+        buffer_.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    std::string filepath_;
+    std::FILE* file_;
+    std::size_t buffer_size_;
+    std::string buffer_;
+    std::unordered_map<std::string, std::uint32_t> names_;
+    int stack_size_;
+};
+
+/* Reads a log through a read only mapping of the whole file. */
+class EventLogReader {
+  public:
+    explicit EventLogReader(const std::string& filepath)
+        : filepath_(filepath), data_(nullptr), size_(0), offset_(0) {
+        int fd = open(filepath.c_str(), O_RDONLY);
+        if (fd == -1) {
+            throw std::runtime_error("cannot open '" + filepath + "'");
+        }
+
+        struct stat info;
+        if (fstat(fd, &info) == -1) {
+            close(fd);
+            throw std::runtime_error("cannot stat '" + filepath + "'");
+        }
+
+        size_ = info.st_size;
+
+        if (size_ != 0) {
+            void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data == MAP_FAILED) {
+                close(fd);
+                throw std::runtime_error("cannot map '" + filepath + "'");
+            }
+            data_ = static_cast<const char*>(data);
+            madvise(data, size_, MADV_SEQUENTIAL);
+        }
+
+        close(fd);
+
+        if (size_ < ENVTRACER_LOG_MAGIC_SIZE ||
+            std::memcmp(data_, ENVTRACER_LOG_MAGIC, ENVTRACER_LOG_MAGIC_SIZE) !=
+                0) {
+            unmap_();
+            throw std::runtime_error("'" + filepath + "' is not an event log");
+        }
+
+        offset_ = ENVTRACER_LOG_MAGIC_SIZE;
+    }
+
+    ~EventLogReader() {
+        unmap_();
+    }
+
+    EventLogReader(const EventLogReader&) = delete;
+    EventLogReader& operator=(const EventLogReader&) = delete;
+
+    /* name with the given id, or an empty string for ENVTRACER_LOG_NO_NAME */
+    const std::string& get_name(std::uint32_t id) const {
+        static const std::string empty;
+        return id < names_.size() ? names_[id] : empty;
+    }
+
+    std::size_t get_name_count() const {
+        return names_.size();
+    }
+
+    /* reads the next event into event, defining the names before it.
+       Returns false at the end of the log. */
+    bool next_event(LogEvent& event) {
+        while (offset_ < size_) {
+            LogRecordTag tag = static_cast<LogRecordTag>(get_<std::uint8_t>());
+
+            if (tag == LogRecordTag::Name) {
+                std::uint32_t size = get_<std::uint32_t>();
+                names_.emplace_back(advance_(size), size);
+                continue;
+            }
+
+            if (tag != LogRecordTag::Event) {
+                throw std::runtime_error("corrupt record in '" + filepath_ +
+                                         "'");
+            }
+
+            event.name = get_<std::uint32_t>();
+            event.stack_delta = get_<std::int32_t>();
+            std::uint8_t count = get_<std::uint8_t>();
+
+            event.operands.resize(count);
+
+            for (LogOperand& operand: event.operands) {
+                operand.kind =
+                    static_cast<LogOperandKind>(get_<std::uint8_t>());
+                operand.id = get_<std::int32_t>();
+                operand.type = get_<std::uint8_t>();
+                operand.name = get_<std::uint32_t>();
+            }
+
+            return true;
+        }
+
+        return false;
+    }
+
+  private:
+    const char* advance_(std::size_t size) {
+        if (offset_ + size > size_) {
+            throw std::runtime_error("truncated record in '" + filepath_ +
+                                     "'");
+        }
+        const char* data = data_ + offset_;
+        offset_ += size;
+        return data;
+    }
+
+    template <typename T>
+    T get_() {
+        T value;
+        std::memcpy(&value, advance_(sizeof(T)), sizeof(T));
+        return value;
+    }
+
+    void unmap_() {
+        if (data_ != nullptr) {
+            munmap(const_cast<char*>(data_), size_);
+            data_ = nullptr;
+        }
+    }
+
+    std::string filepath_;
+    const char* data_;
+    std::size_t size_;
+    std::size_t offset_;
+    std::vector<std::string> names_;
+};
+
+#endif /* ENVTRACER_EVENT_LOG_H */
@@ -0,0 +1,16 @@
+#include "EventRecorder.h"
+
+std::unique_ptr<EventLogWriter> EventRecorder::writer_;
+int EventRecorder::generation_ = 0;
+
+void EventRecorder::open(const std::string& filepath) {
+    writer_.reset(new EventLogWriter(filepath));
+    ++generation_;
+}
+
+void EventRecorder::close() {
+    std::unique_ptr<EventLogWriter> writer(std::move(writer_));
+    if (writer) {
+        writer->close();
+    }
+}
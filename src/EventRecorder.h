@@ -0,0 +1,224 @@
+#ifndef ENVTRACER_EVENT_RECORDER_H
+#define ENVTRACER_EVENT_RECORDER_H
+
+#include "CallbackProfiler.h"
+#include "EventLog.h"
+#include "utilities.h"
+#include <instrumentr/instrumentr.h>
+#include <memory>
+#include <string>
+
+/* Records the events received by the callbacks into an event log so that
+   they can be replayed without R. Events are logged before the callback
+   runs and before they are filtered. The log is opened by the tracing
+   entry callback, so that event is implied by the start of the log. */
+class EventRecorder {
+  public:
+    static void open(const std::string& filepath);
+
+    /* writes out the buffered events and reports write errors */
+    static void close();
+
+    static bool is_recording() {
+        return writer_ != nullptr;
+    }
+
+    static EventLogWriter& get_writer() {
+        return *writer_;
+    }
+
+    /* incremented for every log so that cached name ids are renewed */
+    static int get_generation() {
+        return generation_;
+    }
+
+  private:
+    static std::unique_ptr<EventLogWriter> writer_;
+    static int generation_;
+};
+
+/* operands of a single event, filled from the callback arguments */
+struct RecordedOperands {
+    int stack_size = 0;
+    std::size_t count = 0;
+    LogOperand operands[8];
+
+    void add(LogOperandKind kind,
+             int id,
+             int type = ENVTRACER_LOG_NO_TYPE,
+             const char* name = nullptr) {
+        EventLogWriter& writer = EventRecorder::get_writer();
+        /* NA_INTEGER for unbound values */
+        if (type < 0 || type >= ENVTRACER_LOG_NO_TYPE) {
+            type = ENVTRACER_LOG_NO_TYPE;
+        }
+        operands[count++] = {
+            kind, id, static_cast<std::uint8_t>(type), writer.intern(name)};
+    }
+};
+
+inline void record_operand(RecordedOperands& operands,
+                           instrumentr_tracer_t tracer) {
+}
+
+inline void record_operand(RecordedOperands& operands,
+                           instrumentr_callback_t callback) {
+}
+
+inline void record_operand(RecordedOperands& operands,
+                           instrumentr_application_t application) {
+}
+
+inline void record_operand(RecordedOperands& operands,
+                           instrumentr_state_t state) {
+    operands.stack_size = instrumentr_call_stack_get_size(
+        instrumentr_state_get_call_stack(state));
+}
+
+inline void record_operand(RecordedOperands& operands,
+                           instrumentr_closure_t closure) {
+    operands.add(LogOperandKind::Closure,
+                 instrumentr_closure_get_id(closure),
+                 CLOSXP,
+                 instrumentr_closure_get_name(closure));
+}
+
+inline void record_operand(RecordedOperands& operands,
+                           instrumentr_builtin_t builtin) {
+    operands.add(LogOperandKind::Builtin,
+                 instrumentr_builtin_get_id(builtin),
+                 BUILTINSXP,
+                 instrumentr_builtin_get_name(builtin));
+}
+
+inline void record_operand(RecordedOperands& operands,
+                           instrumentr_special_t special) {
+    operands.add(LogOperandKind::Special,
+                 instrumentr_special_get_id(special),
+                 SPECIALSXP,
+                 instrumentr_special_get_name(special));
+}
+
+inline void record_operand(RecordedOperands& operands,
+                           instrumentr_call_t call) {
+    int type = ENVTRACER_LOG_NO_TYPE;
+    if (instrumentr_call_has_result(call)) {
+        type = get_sexp_typeof(
+            instrumentr_value_get_sexp(instrumentr_call_get_result(call)));
+    }
+    operands.add(LogOperandKind::Call, instrumentr_call_get_id(call), type);
+}
+
+inline void record_operand(RecordedOperands& operands,
+                           instrumentr_environment_t environment) {
+    operands.add(LogOperandKind::Environment,
+                 instrumentr_environment_get_id(environment),
+                 ENVSXP,
+                 instrumentr_environment_get_name(environment));
+}
+
+inline void record_operand(RecordedOperands& operands,
+                           instrumentr_promise_t promise) {
+    operands.add(
+        LogOperandKind::Promise, instrumentr_promise_get_id(promise), PROMSXP);
+}
+
+inline void record_operand(RecordedOperands& operands,
+                           instrumentr_value_t value) {
+    operands.add(LogOperandKind::Value,
+                 instrumentr_value_get_id(value),
+                 get_sexp_typeof(instrumentr_value_get_sexp(value)));
+}
+
+/* symbols are identified by their name */
+inline void record_operand(RecordedOperands& operands,
+                           instrumentr_symbol_t symbol) {
+    operands.add(LogOperandKind::Symbol,
+                 -1,
+                 SYMSXP,
+                 instrumentr_char_get_element(
+                     instrumentr_symbol_get_element(symbol)));
+}
+
+inline void record_operand(RecordedOperands& operands,
+                           instrumentr_character_t character) {
+    operands.add(LogOperandKind::Character,
+                 instrumentr_character_get_size(character),
+                 STRSXP);
+}
+
+/* Callback that logs its event before calling next, which is the
+   callback itself or its profiled wrapper. */
+template <typename T, T function>
+struct RecordedCallback;
+
+template <typename... Args, void (*function)(Args...)>
+struct RecordedCallback<void (*)(Args...), function> {
+    static const char* name;
+    static void (*next)(Args...);
+
+    static void invoke(Args... args) {
+        if (EventRecorder::is_recording()) {
+            record_(args...);
+        }
+        next(args...);
+    }
+
+  private:
+    static void record_(Args... args) {
+        static int generation = -1;
+        static std::uint32_t event = ENVTRACER_LOG_NO_NAME;
+
+        EventLogWriter& writer = EventRecorder::get_writer();
+
+        if (generation != EventRecorder::get_generation()) {
+            generation = EventRecorder::get_generation();
+            event = writer.intern(name);
+        }
+
+        RecordedOperands operands;
+        /* braced list to record the arguments in order */
+        int expand[] = {(record_operand(operands, args), 0)...};
+        (void) expand;
+
+        writer.write_event(
+            event, operands.stack_size, operands.operands, operands.count);
+    }
+};
+
+template <typename... Args, void (*function)(Args...)>
+const char* RecordedCallback<void (*)(Args...), function>::name = nullptr;
+
+template <typename... Args, void (*function)(Args...)>
+void (*RecordedCallback<void (*)(Args...), function>::next)(Args...) =
+    nullptr;
+
+/* wrappers that are put around the callbacks */
+struct CallbackMode {
+    bool profiling;
+    bool recording;
+};
+
+/* function itself, or its profiled and recorded wrapper */
+template <typename T, T function>
+void* get_callback(const CallbackMode& mode, const char* name) {
+    T callback = function;
+
+    if (mode.profiling) {
+        ProfiledCallback<T, function>::slot = CallbackProfiler::get_slot(name);
+        callback = &ProfiledCallback<T, function>::invoke;
+    }
+
+    if (mode.recording) {
+        RecordedCallback<T, function>::name = name;
+        RecordedCallback<T, function>::next = callback;
+        callback = &RecordedCallback<T, function>::invoke;
+    }
+
+    return (void*) (callback);
+}
+
+#define ENVTRACER_CALLBACK(mode, function) \
+    get_callback<decltype(&function), &function>(mode, #function)
+
+#endif /* ENVTRACER_EVENT_RECORDER_H */
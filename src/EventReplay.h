@@ -0,0 +1,50 @@
+#ifndef ENVTRACER_EVENT_REPLAY_H
+#define ENVTRACER_EVENT_REPLAY_H
+
+#include "EventLog.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/* NOTE: this header does not depend on R. */
+
+/* Drives an analysis with the events of a log.
+
+   The analysis provides
+
+       int get_handler(const std::string& callback);
+       void on_event(int handler, const LogEvent& event, int stack_size);
+
+   get_handler is asked once per callback name of the log, so that events
+   are dispatched on an integer instead of their name. stack_size is the
+   call stack size at the event, reconstructed from the recorded deltas.
+   Returns the number of replayed events. */
+template <typename Analysis>
+std::size_t replay_event_log(EventLogReader& reader, Analysis& analysis) {
+    std::vector<int> handlers;
+    std::vector<bool> resolved;
+    LogEvent event;
+    int stack_size = 0;
+    std::size_t count = 0;
+
+    while (reader.next_event(event)) {
+        if (event.name >= handlers.size()) {
+            handlers.resize(reader.get_name_count(), -1);
+            resolved.resize(reader.get_name_count(), false);
+        }
+
+        if (!resolved[event.name]) {
+            handlers[event.name] =
+                analysis.get_handler(reader.get_name(event.name));
+            resolved[event.name] = true;
+        }
+
+        stack_size += event.stack_delta;
+        analysis.on_event(handlers[event.name], event, stack_size);
+        ++count;
+    }
+
+    return count;
+}
+
+#endif /* ENVTRACER_EVENT_REPLAY_H */
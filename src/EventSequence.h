@@ -0,0 +1,180 @@
+#ifndef ENVTRACER_EVENT_SEQUENCE_H
+#define ENVTRACER_EVENT_SEQUENCE_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/* Events with a fixed code. Other events are interned on first use. */
+enum env_event_t {
+    ENV_EVENT_CALL_ENTRY = 0,
+    ENV_EVENT_CALL_EXIT,
+    ENV_EVENT_RETURN,
+    ENV_EVENT_ARGUMENT,
+    ENV_EVENT_EVAL_ENTRY_DIRECT,
+    ENV_EVENT_EVAL_ENTRY_INDIRECT,
+    ENV_EVENT_EVAL_EXIT_DIRECT,
+    ENV_EVENT_EVAL_EXIT_INDIRECT,
+    ENV_EVENT_SUBSTITUTE,
+    ENV_EVENT_LOOKUP,
+    ENV_EVENT_ASSIGN,
+    ENV_EVENT_DEFINE,
+    ENV_EVENT_REMOVE,
+    ENV_EVENT_ESCAPE,
+    ENV_EVENT_LOCK,
+    ENV_EVENT_UNLOCK
+};
+
+/* Maps events to small integer codes. The text of an event is what it
+   contributes to the exported event_seq, including its separator. */
+class EventDictionary {
+  public:
+    EventDictionary() {
+        add_("CallEntry", true);
+        add_("CallExit", true);
+        add_("Return", true);
+        add_("Argument", true);
+        add_("EvalEntryDirect", true);
+        add_("EvalEntryIndirect", true);
+        add_("EvalExitDirect", true);
+        add_("EvalExitIndirect", true);
+        add_("substitute", true);
+        /* single character events are not separated */
+        add_("L", false);
+        add_("A", false);
+        add_("D", false);
+        add_("R", false);
+        add_("E", false);
+        add_("+", false);
+        add_("-", false);
+    }
+
+    int intern(const std::string& event) {
+        auto iter = codes_.find(event);
+
+        if (iter != codes_.end()) {
+            return iter->second;
+        }
+
+        return add_(event, true);
+    }
+
+    const std::string& get_text(int code) const {
+        return texts_[code];
+    }
+
+  private:
+    int add_(const std::string& event, bool separated) {
+        int code = texts_.size();
+        if (separated) {
+            texts_.push_back(event + "|");
+            codes_.insert({event, code});
+        } else {
+            texts_.push_back(event);
+        }
+        return code;
+    }
+
+    std::vector<std::string> texts_;
+    std::unordered_map<std::string, int> codes_;
+};
+
+/* Run-length encoded sequence of event codes. Runs are stored as pairs of
+   LEB128 varints (code, count); codes below 128 take a single byte. The
+   last run is kept open so that repeating an event only increments a
+   counter. Once cap events have been stored, further events are only
+   counted. */
+class EventSequence {
+  public:
+    EventSequence(): last_code_(-1), last_count_(0), size_(0), dropped_(0) {
+    }
+
+    void append(int code, std::uint32_t cap) {
+        if (cap != 0 && size_ >= cap) {
+            ++dropped_;
+            return;
+        }
+
+        ++size_;
+
+        if (code == last_code_) {
+            ++last_count_;
+            return;
+        }
+
+        close_run_();
+        last_code_ = code;
+        last_count_ = 1;
+    }
+
+    std::string decode(const EventDictionary& dictionary) const {
+        std::string result("|");
+
+        std::size_t offset = 0;
+
+        while (offset < runs_.size()) {
+            std::uint32_t code = read_varint_(offset);
+            std::uint32_t count = read_varint_(offset);
+            append_run_(result, dictionary.get_text(code), count);
+        }
+
+        if (last_code_ != -1) {
+            append_run_(result, dictionary.get_text(last_code_), last_count_);
+        }
+
+        if (dropped_ != 0) {
+            result.append("<truncated:");
+            result.append(std::to_string(dropped_));
+            result.append(">|");
+        }
+
+        return result;
+    }
+
+  private:
+    static void append_run_(std::string& result,
+                            const std::string& text,
+                            std::uint32_t count) {
+        result.reserve(result.size() + text.size() * count);
+        for (std::uint32_t i = 0; i < count; ++i) {
+            result.append(text);
+        }
+    }
+
+    void close_run_() {
+        if (last_code_ == -1) {
+            return;
+        }
+        write_varint_(last_code_);
+        write_varint_(last_count_);
+    }
+
+    void write_varint_(std::uint32_t value) {
+        while (value >= 0x80) {
+            runs_.push_back(static_cast<std::uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        runs_.push_back(static_cast<std::uint8_t>(value));
+    }
+
+    std::uint32_t read_varint_(std::size_t& offset) const {
+        std::uint32_t value = 0;
+        int shift = 0;
+        std::uint8_t byte;
+        do {
+            byte = runs_[offset++];
+            value |= static_cast<std::uint32_t>(byte & 0x7F) << shift;
+            shift += 7;
+        } while (byte & 0x80);
+        return value;
+    }
+
+    std::vector<std::uint8_t> runs_;
+    int last_code_;
+    std::uint32_t last_count_;
+    std::uint32_t size_;
+    std::uint32_t dropped_;
+};
+
+#endif /* ENVTRACER_EVENT_SEQUENCE_H */
@@ -7,10 +7,7 @@
 
 class Function {
   public:
-    Function(int fun_id,
-             int fun_env_id,
-             const std::string& fun_hash,
-             const std::string& fun_def)
+    Function(int fun_id, int fun_env_id, int def_id)
         : fun_id_(fun_id)
         , fun_name_(ENVTRACER_NA_STRING)
         , anonymous_(FALSE)
@@ -18,8 +15,7 @@ class Function {
         , parent_fun_id_(NA_INTEGER)
         , fun_env_id_(fun_env_id)
         , call_count_(0)
-        , fun_hash_(fun_hash)
-        , fun_def_(fun_def) {
+        , def_id_(def_id) {
     }
 
     int get_id() {
@@ -67,8 +63,9 @@ class Function {
         return qual_name_ != ENVTRACER_NA_STRING;
     }
 
-    const std::string& get_hash() const {
-        return fun_hash_;
+    /* id in FunctionDefinitionTable */
+    int get_definition_id() const {
+        return def_id_;
     }
 
     void call() {
@@ -86,9 +83,7 @@ class Function {
                  SEXP r_qual_name,
                  SEXP r_parent_fun_id,
                  SEXP r_fun_env_id,
-                 SEXP r_call_count,
-                 SEXP r_fun_hash,
-                 SEXP r_fun_def) {
+                 SEXP r_call_count) {
         SET_INTEGER_ELT(r_fun_id, index, fun_id_);
         SET_STRING_ELT(r_fun_name, index, make_char(fun_name_));
         SET_LOGICAL_ELT(r_anonymous, index, anonymous_);
@@ -96,8 +91,6 @@ class Function {
         SET_INTEGER_ELT(r_parent_fun_id, index, parent_fun_id_);
         SET_INTEGER_ELT(r_fun_env_id, index, fun_env_id_);
         SET_INTEGER_ELT(r_call_count, index, call_count_);
-        SET_STRING_ELT(r_fun_hash, index, make_char(fun_hash_));
-        SET_STRING_ELT(r_fun_def, index, make_char(fun_def_));
     }
 
   private:
@@ -108,8 +101,7 @@ class Function {
     int parent_fun_id_;
     int fun_env_id_;
     int call_count_;
-    std::string fun_hash_;
-    std::string fun_def_;
+    int def_id_;
 };
 
 #endif /* ENVTRACER_FUNCTION_H */
@@ -0,0 +1,160 @@
+#ifndef ENVTRACER_FUNCTION_DEFINITION_TABLE_H
+#define ENVTRACER_FUNCTION_DEFINITION_TABLE_H
+
+#include "utilities.h"
+#include "structural_hash.h"
+#include <instrumentr/instrumentr.h>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/* Distinct closure definitions. Closures created by evaluating the same
+   function expression share their formals, body and srcref, so a closure
+   is first looked up by the identity of these. A definition seen for the
+   first time is compared structurally with the known ones, so that copies
+   of the same function are stored once.
+
+   Every identity key is kept alive by a shell closure with the same
+   formals, body and attributes, so that its addresses are not reused. The
+   shells do not keep any environment alive. The text and hash of a
+   definition are only computed when they are exported. */
+class FunctionDefinitionTable {
+  public:
+    FunctionDefinitionTable(): r_shells_(R_NilValue) {
+    }
+
+    ~FunctionDefinitionTable() {
+        if (r_shells_ != R_NilValue) {
+            R_ReleaseObject(r_shells_);
+        }
+    }
+
+    /* id of the definition of r_closure */
+    int insert(SEXP r_closure) {
+        Identity identity = {
+            FORMALS(r_closure), BODY(r_closure), ATTRIB(r_closure)};
+
+        auto iter = identities_.find(identity);
+
+        if (iter != identities_.end()) {
+            return iter->second;
+        }
+
+        std::size_t hash = hash_sexp_structure(identity.r_formals, 0);
+        hash = hash_sexp_structure(identity.r_body, hash);
+
+        SEXP r_shell = preserve_(identity);
+
+        int def_id = find_structure_(identity, hash);
+
+        if (def_id == -1) {
+            def_id = definitions_.size();
+            definitions_.push_back({r_shell, false, "", ""});
+            structures_.insert({hash, def_id});
+        }
+
+        identities_.insert({identity, def_id});
+
+        return def_id;
+    }
+
+    int size() const {
+        return definitions_.size();
+    }
+
+    /* deparsed definition, computed on first use */
+    const std::string& get_text(int def_id) {
+        materialize_(def_id);
+        return definitions_[def_id].text;
+    }
+
+    /* hash of the deparsed definition, computed on first use */
+    const std::string& get_hash(int def_id) {
+        materialize_(def_id);
+        return definitions_[def_id].text_hash;
+    }
+
+  private:
+    struct Identity {
+        SEXP r_formals;
+        SEXP r_body;
+        SEXP r_attrib;
+
+        bool operator==(const Identity& other) const {
+            return r_formals == other.r_formals && r_body == other.r_body &&
+                   r_attrib == other.r_attrib;
+        }
+    };
+
+    struct IdentityHash {
+        std::size_t operator()(const Identity& identity) const {
+            std::hash<SEXP> hash;
+            std::size_t seed = hash(identity.r_formals);
+            seed = combine_hash(seed, hash(identity.r_body));
+            return combine_hash(seed, hash(identity.r_attrib));
+        }
+    };
+
+    struct Definition {
+        SEXP r_shell;
+        bool materialized;
+        std::string text;
+        std::string text_hash;
+    };
+
+    int find_structure_(const Identity& identity, std::size_t hash) {
+        auto range = structures_.equal_range(hash);
+
+        for (auto iter = range.first; iter != range.second; ++iter) {
+            SEXP r_shell = definitions_[iter->second].r_shell;
+
+            /* attributes hold the srcref, which is deparsed instead of
+               the body when present */
+            if (ATTRIB(r_shell) == identity.r_attrib &&
+                R_compute_identical(FORMALS(r_shell), identity.r_formals, 16) &&
+                R_compute_identical(BODY(r_shell), identity.r_body, 16)) {
+                return iter->second;
+            }
+        }
+
+        return -1;
+    }
+
+    SEXP preserve_(const Identity& identity) {
+        if (r_shells_ == R_NilValue) {
+            r_shells_ = CONS(R_NilValue, R_NilValue);
+            R_PreserveObject(r_shells_);
+        }
+
+        SEXP r_shell = PROTECT(
+            mkCLOSXP(identity.r_formals, identity.r_body, R_GlobalEnv));
+        SET_ATTRIB(r_shell, identity.r_attrib);
+        SETCDR(r_shells_, CONS(r_shell, CDR(r_shells_)));
+        UNPROTECT(1);
+
+        return r_shell;
+    }
+
+    void materialize_(int def_id) {
+        Definition& definition = definitions_[def_id];
+
+        if (definition.materialized) {
+            return;
+        }
+
+        std::vector<std::string> texts =
+            instrumentr_sexp_to_string(definition.r_shell, true);
+        definition.text = texts.front();
+        definition.text_hash = instrumentr_compute_hash(definition.text);
+        definition.materialized = true;
+    }
+
+    /* pairlist of shells, preserved while tracing */
+    SEXP r_shells_;
+    std::vector<Definition> definitions_;
+    std::unordered_map<Identity, int, IdentityHash> identities_;
+    std::unordered_multimap<std::size_t, int> structures_;
+};
+
+#endif /* ENVTRACER_FUNCTION_DEFINITION_TABLE_H */
@@ -1,8 +1,11 @@
 #ifndef ENVTRACER_FUNCTION_TABLE_H
 #define ENVTRACER_FUNCTION_TABLE_H
 
+#include "CallbackProfiler.h"
+#include "Arena.h"
 #include "Function.h"
 #include "Environment.h"
+#include "FunctionDefinitionTable.h"
 #include <unordered_map>
 #include <instrumentr/instrumentr.h>
 
@@ -10,17 +13,19 @@ class FunctionTable {
   public:
     const std::string QUALIFIED_NAME_SEPARATOR = "*$#$*";
 
-    FunctionTable() {
+    explicit FunctionTable(Arena& arena): arena_(arena) {
     }
 
     ~FunctionTable() {
         for (auto iter = table_.begin(); iter != table_.end(); ++iter) {
-            delete iter->second;
+            arena_.destroy(iter->second);
         }
         table_.clear();
     }
 
     Function* insert(instrumentr_closure_t closure) {
+        ProfileScope scope(PROFILE_PHASE_FUNCTION_INSERT);
+
         int fun_id = instrumentr_closure_get_id(closure);
 
         auto iter = table_.find(fun_id);
@@ -34,16 +39,11 @@ class FunctionTable {
 
         int fun_env_id = instrumentr_environment_get_id(environment);
 
-        SEXP r_fun_def = instrumentr_closure_get_sexp(closure);
-
-        std::vector<std::string> fun_defs =
-            instrumentr_sexp_to_string(r_fun_def, true);
-        std::string fun_def = fun_defs.front();
-
-        std::string fun_hash = instrumentr_compute_hash(fun_def);
+        int def_id =
+            definitions_.insert(instrumentr_closure_get_sexp(closure));
 
         Function* function =
-            new Function(fun_id, fun_env_id, fun_hash, fun_def);
+            arena_.create<Function>(allocations_, fun_id, fun_env_id, def_id);
 
         table_.insert({fun_id, function});
 
@@ -75,6 +75,10 @@ class FunctionTable {
         SEXP r_fun_hash = PROTECT(allocVector(STRSXP, size));
         SEXP r_fun_def = PROTECT(allocVector(STRSXP, size));
 
+        /* CHARSXPs of each definition, shared by its functions */
+        std::vector<SEXP> r_hashes(definitions_.size(), NULL);
+        std::vector<SEXP> r_defs(definitions_.size(), NULL);
+
         int index = 0;
 
         for (auto iter = table_.begin(); iter != table_.end();
@@ -88,9 +92,21 @@ class FunctionTable {
                               r_qual_name,
                               r_parent_fun_id,
                               r_fun_env_id,
-                              r_call_count,
-                              r_fun_hash,
-                              r_fun_def);
+                              r_call_count);
+
+            int def_id = function->get_definition_id();
+
+            /* a new CHARSXP is only protected once it is stored in its
+               column, so it is stored before the next one is created */
+            if (r_hashes[def_id] == NULL) {
+                r_hashes[def_id] = make_char(definitions_.get_hash(def_id));
+            }
+            SET_STRING_ELT(r_fun_hash, index, r_hashes[def_id]);
+
+            if (r_defs[def_id] == NULL) {
+                r_defs[def_id] = make_char(definitions_.get_text(def_id));
+            }
+            SET_STRING_ELT(r_fun_def, index, r_defs[def_id]);
         }
 
         std::vector<SEXP> columns({r_fun_id,
@@ -128,8 +144,15 @@ class FunctionTable {
         }
     }
 
+    const ArenaCounter& get_allocations() const {
+        return allocations_;
+    }
+
   private:
+    Arena& arena_;
+    ArenaCounter allocations_;
     std::unordered_map<int, Function*> table_;
+    FunctionDefinitionTable definitions_;
 
     std::string infer_qualified_name_helper_(Function* fun,
                                              EnvironmentTable& env_tab) {
@@ -145,7 +168,7 @@ class FunctionTable {
         if (fun->has_name()) {
             fun_name = fun->get_name();
         } else {
-            fun_name = fun->get_hash();
+            fun_name = definitions_.get_hash(fun->get_definition_id());
             anonymous = true;
         }
 
@@ -0,0 +1,41 @@
+#ifndef ENVTRACER_ID_BITSET_H
+#define ENVTRACER_ID_BITSET_H
+
+#include <cstdint>
+#include <vector>
+
+/* Set of non-negative ids stored as a bitset that grows on insertion. */
+class IdBitset {
+  public:
+    IdBitset() {
+    }
+
+    bool contains(int id) const {
+        std::size_t word = id / 64;
+        return word < words_.size() && (words_[word] >> (id % 64)) & 1;
+    }
+
+    void insert(int id) {
+        std::size_t word = id / 64;
+        if (word >= words_.size()) {
+            words_.resize(word + 1, 0);
+        }
+        words_[word] |= std::uint64_t(1) << (id % 64);
+    }
+
+    void erase(int id) {
+        std::size_t word = id / 64;
+        if (word < words_.size()) {
+            words_[word] &= ~(std::uint64_t(1) << (id % 64));
+        }
+    }
+
+    void clear() {
+        words_.clear();
+    }
+
+  private:
+    std::vector<std::uint64_t> words_;
+};
+
+#endif /* ENVTRACER_ID_BITSET_H */
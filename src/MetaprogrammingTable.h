@@ -3,6 +3,7 @@
 
 #include <vector>
 #include <string>
+#include "CallSampler.h"
 #include <instrumentr/instrumentr.h>
 
 class MetaprogrammingTable {
@@ -21,6 +22,9 @@ class MetaprogrammingTable {
                 int sink_fun_id,
                 int sink_call_id,
                 int depth) {
+        double sample_weight =
+            sampler_ == nullptr ? 1 : sampler_->get_weight();
+
         /* to avoid double counting, expression metaprogramming case is not
            added after a substitute with same fields */
         if (meta_type == "expression") {
@@ -43,6 +47,12 @@ class MetaprogrammingTable {
         sink_fun_id_.push_back(sink_fun_id);
         sink_call_id_.push_back(sink_call_id);
         depth_.push_back(depth);
+        sample_weight_.push_back(sample_weight);
+    }
+
+    /* rows are weighted by the call they happen in */
+    void set_sampler(const CallSampler* sampler) {
+        sampler_ = sampler;
     }
 
     SEXP to_sexp() {
@@ -56,9 +66,12 @@ class MetaprogrammingTable {
         SEXP r_sink_fun_id = PROTECT(allocVector(INTSXP, size));
         SEXP r_sink_call_id = PROTECT(allocVector(INTSXP, size));
         SEXP r_depth = PROTECT(allocVector(INTSXP, size));
+        SEXP r_sample_weight = PROTECT(allocVector(REALSXP, size));
+
+        CharCache cache;
 
         for (int index = 0; index < size; ++index) {
-            SET_STRING_ELT(r_meta_type, index, make_char(meta_type_[index]));
+            SET_STRING_ELT(r_meta_type, index, cache.get(meta_type_[index]));
             SET_INTEGER_ELT(r_source_fun_id, index, source_fun_id_[index]);
             SET_INTEGER_ELT(r_source_call_id, index, source_call_id_[index]);
             SET_INTEGER_ELT(r_source_arg_id, index, source_arg_id_[index]);
@@ -67,6 +80,7 @@ class MetaprogrammingTable {
             SET_INTEGER_ELT(r_sink_fun_id, index, sink_fun_id_[index]);
             SET_INTEGER_ELT(r_sink_call_id, index, sink_call_id_[index]);
             SET_INTEGER_ELT(r_depth, index, depth_[index]);
+            SET_REAL_ELT(r_sample_weight, index, sample_weight_[index]);
         }
 
         std::vector<SEXP> columns({r_meta_type,
@@ -76,7 +90,8 @@ class MetaprogrammingTable {
                                    r_source_formal_pos,
                                    r_sink_fun_id,
                                    r_sink_call_id,
-                                   r_depth});
+                                   r_depth,
+                                   r_sample_weight});
 
         std::vector<std::string> names({"meta_type",
                                         "source_fun_id",
@@ -85,16 +100,18 @@ class MetaprogrammingTable {
                                         "source_formal_pos",
                                         "sink_fun_id",
                                         "sink_call_id",
-                                        "depth"});
+                                        "depth",
+                                        "sample_weight"});
 
         SEXP df = create_data_frame(names, columns);
 
-        UNPROTECT(8);
+        UNPROTECT(9);
 
         return df;
     }
 
   private:
+    const CallSampler* sampler_ = nullptr;
     std::vector<std::string> meta_type_;
     std::vector<int> source_fun_id_;
     std::vector<int> source_call_id_;
@@ -103,6 +120,7 @@ class MetaprogrammingTable {
     std::vector<int> sink_fun_id_;
     std::vector<int> sink_call_id_;
     std::vector<int> depth_;
+    std::vector<double> sample_weight_;
 };
 
 #endif /* ENVTRACER_METAPROGRAMMING_TABLE_H */
@@ -0,0 +1,146 @@
+#ifndef ENVTRACER_NAMESPACE_CATALOG_H
+#define ENVTRACER_NAMESPACE_CATALOG_H
+
+#include "Rincludes.h"
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+/* path of bindings from a package environment to a nested environment */
+typedef std::vector<std::string> BindingPath;
+
+/* On-disk catalog of the environments nested in package environments.
+   Entries are keyed by the kind of the package environment and the name
+   and version of its package, so they stay valid until the package is
+   reinstalled with another version. An entry is a file listing one
+   binding path per line, in the order the environments were found, with
+   path components separated by tabs. */
+class NamespaceCatalog {
+  public:
+    explicit NamespaceCatalog(const std::string& directory)
+        : directory_(directory) {
+    }
+
+    bool is_enabled() const {
+        return !directory_.empty();
+    }
+
+    /* key of a namespace or package environment, empty if its package
+       version cannot be determined */
+    static std::string get_key(SEXP r_env, const std::string& kind) {
+        SEXP r_namespace = r_env;
+        SEXP r_package_name = R_PackageEnvName(r_env);
+
+        /* attached packages share the version of their namespace; it is
+           only looked up if the namespace is already loaded */
+        if (r_package_name != R_NilValue) {
+            std::string name = CHAR(STRING_ELT(r_package_name, 0));
+            const std::string prefix = "package:";
+            if (name.compare(0, prefix.size(), prefix) != 0) {
+                return "";
+            }
+            std::string package = name.substr(prefix.size());
+            r_namespace =
+                findVarInFrame(R_NamespaceRegistry, install(package.c_str()));
+            if (r_namespace == R_UnboundValue) {
+                return "";
+            }
+        }
+
+        SEXP r_spec = R_NamespaceEnvSpec(r_namespace);
+
+        if (r_spec == R_NilValue || TYPEOF(r_spec) != STRSXP ||
+            Rf_length(r_spec) < 2) {
+            return "";
+        }
+
+        return kind + "-" + CHAR(STRING_ELT(r_spec, 0)) + "-" +
+               CHAR(STRING_ELT(r_spec, 1));
+    }
+
+    /* reads the entry of key into paths, returns false if there is none */
+    bool lookup(const std::string& key, std::vector<BindingPath>& paths) const {
+        std::ifstream file(get_filepath_(key));
+
+        if (!file) {
+            return false;
+        }
+
+        std::string line;
+
+        if (!std::getline(file, line) || line != MAGIC) {
+            return false;
+        }
+
+        while (std::getline(file, line)) {
+            BindingPath path;
+            std::size_t start = 0;
+            std::size_t end;
+            while ((end = line.find('\t', start)) != std::string::npos) {
+                path.push_back(line.substr(start, end - start));
+                start = end + 1;
+            }
+            path.push_back(line.substr(start));
+            paths.push_back(path);
+        }
+
+        return true;
+    }
+
+    /* writes the entry of key. Concurrent tracers may store the same entry,
+       so it is written to a private file that is then renamed. Bindings
+       that cannot be represented are not stored at all. */
+    void store(const std::string& key,
+               const std::vector<BindingPath>& paths) const {
+        for (const BindingPath& path: paths) {
+            for (const std::string& binding: path) {
+                if (binding.find_first_of("\t\n\r") != std::string::npos) {
+                    return;
+                }
+            }
+        }
+
+        std::string filepath = get_filepath_(key);
+        std::string temppath = filepath + "." + std::to_string(getpid());
+
+        {
+            std::ofstream file(temppath);
+
+            if (!file) {
+                return;
+            }
+
+            file << MAGIC << '\n';
+
+            for (const BindingPath& path: paths) {
+                for (std::size_t i = 0; i < path.size(); ++i) {
+                    file << (i == 0 ? "" : "\t") << path[i];
+                }
+                file << '\n';
+            }
+
+            if (!file) {
+                file.close();
+                std::remove(temppath.c_str());
+                return;
+            }
+        }
+
+        if (std::rename(temppath.c_str(), filepath.c_str()) != 0) {
+            std::remove(temppath.c_str());
+        }
+    }
+
+  private:
+    std::string get_filepath_(const std::string& key) const {
+        return directory_ + "/" + key + ".catalog";
+    }
+
+    static constexpr const char* MAGIC = "envtracer-catalog 2";
+
+    std::string directory_;
+};
+
+#endif /* ENVTRACER_NAMESPACE_CATALOG_H */
@@ -0,0 +1,133 @@
+#ifndef ENVTRACER_REFLECTIVE_FUNCTION_TABLE_H
+#define ENVTRACER_REFLECTIVE_FUNCTION_TABLE_H
+
+#include "utilities.h"
+#include "IdBitset.h"
+#include <instrumentr/instrumentr.h>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+
+/* Variable and environment events reported by instrumentr. */
+enum variable_event_t {
+    VARIABLE_LOOKUP = 0,
+    VARIABLE_ASSIGN,
+    VARIABLE_DEFINE,
+    VARIABLE_EXISTS,
+    VARIABLE_REMOVE,
+    ENVIRONMENT_LS
+};
+
+inline const char* get_variable_event_name(variable_event_t event) {
+    static const char* names[] = {"L", "A", "D", "E", "R", "ls"};
+    return names[event];
+}
+
+/* base functions that access environments reflectively through the
+   variable events above. */
+enum reflective_fun_t {
+    REFLECTIVE_NONE = 0,
+    REFLECTIVE_GET,
+    REFLECTIVE_GET0,
+    REFLECTIVE_MGET,
+    REFLECTIVE_ASSIGN,
+    REFLECTIVE_EXISTS,
+    REFLECTIVE_REMOVE,
+    REFLECTIVE_RM,
+    REFLECTIVE_LS,
+    REFLECTIVE_OBJECTS,
+    REFLECTIVE_DYNGET
+};
+
+inline const char* get_reflective_fun_name(reflective_fun_t fun) {
+    static const char* names[] = {"",
+                                  "get",
+                                  "get0",
+                                  "mget",
+                                  "assign",
+                                  "exists",
+                                  "remove",
+                                  "rm",
+                                  "ls",
+                                  "objects",
+                                  "dynGet"};
+    return names[fun];
+}
+
+/* true if fun performs event on behalf of its caller */
+inline bool is_reflective_access(variable_event_t event, reflective_fun_t fun) {
+    switch (event) {
+    case VARIABLE_LOOKUP:
+        return fun == REFLECTIVE_GET || fun == REFLECTIVE_GET0 ||
+               fun == REFLECTIVE_MGET;
+    case VARIABLE_ASSIGN:
+    case VARIABLE_DEFINE:
+        return fun == REFLECTIVE_ASSIGN;
+    case VARIABLE_EXISTS:
+        return fun == REFLECTIVE_EXISTS;
+    case VARIABLE_REMOVE:
+        return fun == REFLECTIVE_REMOVE || fun == REFLECTIVE_RM;
+    case ENVIRONMENT_LS:
+        return fun == REFLECTIVE_LS || fun == REFLECTIVE_OBJECTS;
+    }
+    return false;
+}
+
+/* Classifies closures by id. Like BuiltinDispatchTable, the name and
+   package of a closure are only compared the first time its id is seen. */
+class ReflectiveFunctionTable {
+  public:
+    ReflectiveFunctionTable() {
+        for (int fun = REFLECTIVE_GET; fun <= REFLECTIVE_DYNGET; ++fun) {
+            names_.insert({get_reflective_fun_name(
+                               static_cast<reflective_fun_t>(fun)),
+                           static_cast<reflective_fun_t>(fun)});
+        }
+    }
+
+    reflective_fun_t lookup(instrumentr_closure_t closure) {
+        int id = instrumentr_closure_get_id(closure);
+
+        if (!resolved_.contains(id)) {
+            resolve_(id, closure);
+        }
+
+        if (!relevant_.contains(id)) {
+            return REFLECTIVE_NONE;
+        }
+
+        return kinds_[id];
+    }
+
+  private:
+    void resolve_(int id, instrumentr_closure_t closure) {
+        resolved_.insert(id);
+
+        const char* name = instrumentr_closure_get_name(closure);
+
+        if (name == NULL) {
+            return;
+        }
+
+        auto iter = names_.find(name);
+
+        if (iter == names_.end()) {
+            return;
+        }
+
+        const char* pack_name = instrumentr_environment_get_name(
+            instrumentr_closure_get_environment(closure));
+
+        if (pack_name != NULL && std::strcmp(pack_name, "base") == 0) {
+            relevant_.insert(id);
+            kinds_[id] = iter->second;
+        }
+    }
+
+    std::unordered_map<std::string, reflective_fun_t> names_;
+    IdBitset resolved_;
+    IdBitset relevant_;
+    std::unordered_map<int, reflective_fun_t> kinds_;
+};
+
+#endif /* ENVTRACER_REFLECTIVE_FUNCTION_TABLE_H */
@@ -0,0 +1,219 @@
+#ifndef ENVTRACER_SHARD_MANIFEST_H
+#define ENVTRACER_SHARD_MANIFEST_H
+
+#include "TableReader.h"
+#include "TableStream.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <dirent.h>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+/* NOTE: like TableStream.h, this header does not depend on R so that
+   shards can be inspected and merged outside of an R session. */
+
+#define ENVTRACER_SHARD_MANIFEST "manifest.tbl"
+
+/* Id space of a column, empty if the column does not hold ids. Columns
+   named <role>_<space>_id or <role>_<space>_id_<n> hold ids of <space>, so
+   call_id, parent_call_id and source_call_id_2 all hold call ids. Columns
+   holding ids under another name are listed explicitly: backtrace holds
+   node ids of the backtraces table. */
+inline std::string get_id_space(const std::string& column) {
+    static const struct {
+        const char* column;
+        const char* space;
+    } named_columns[] = {{"backtrace", "node"}};
+
+    for (const auto& named: named_columns) {
+        if (column == named.column) {
+            return named.space;
+        }
+    }
+
+    std::size_t end = column.rfind("_id");
+
+    if (end == std::string::npos || end == 0) {
+        return "";
+    }
+
+    std::size_t suffix = end + 3;
+
+    if (suffix != column.size()) {
+        if (column[suffix] != '_' || suffix + 1 == column.size()) {
+            return "";
+        }
+        for (std::size_t i = suffix + 1; i < column.size(); ++i) {
+            if (!std::isdigit(static_cast<unsigned char>(column[i]))) {
+                return "";
+            }
+        }
+    }
+
+    std::size_t start = column.rfind('_', end - 1);
+    start = start == std::string::npos ? 0 : start + 1;
+
+    std::string space = column.substr(start, end - start);
+
+    if (space == "site") {
+        return "call_site";
+    }
+
+    return space;
+}
+
+/* names of the tables in dir, without their extension */
+inline std::vector<std::string> list_tables(const std::string& dir) {
+    DIR* handle = opendir(dir.c_str());
+
+    if (handle == nullptr) {
+        throw std::runtime_error("cannot open directory '" + dir + "'");
+    }
+
+    const std::string extension = ".tbl";
+    std::vector<std::string> tables;
+
+    while (struct dirent* entry = readdir(handle)) {
+        std::string name = entry->d_name;
+
+        if (name.size() > extension.size() &&
+            name.compare(name.size() - extension.size(),
+                         extension.size(),
+                         extension) == 0) {
+            tables.push_back(name.substr(0, name.size() - extension.size()));
+        }
+    }
+
+    closedir(handle);
+
+    return tables;
+}
+
+/* Range of ids used by a shard in each id space. Tracing in forked
+   workers starts every shard from the id counters of the parent session,
+   so shards overlap; the ranges tell a merger how far to shift the ids of
+   each shard. Negative and NA values are sentinels and not counted. */
+class ShardManifest {
+  public:
+    /* adds the ids of every table in dir except the manifest itself */
+    void add_directory(const std::string& dir) {
+        for (const std::string& table: list_tables(dir)) {
+            if (table + ".tbl" != ENVTRACER_SHARD_MANIFEST) {
+                add_table(dir + "/" + table + ".tbl");
+            }
+        }
+    }
+
+    void add_table(const std::string& filepath) {
+        TableReader reader(filepath);
+
+        const TableSchema& schema = reader.get_schema();
+        std::vector<std::pair<std::size_t, std::string>> columns;
+
+        for (std::size_t i = 0; i < schema.names.size(); ++i) {
+            if (schema.types[i] != ColumnType::Integer) {
+                continue;
+            }
+            std::string space = get_id_space(schema.names[i]);
+            if (!space.empty()) {
+                columns.push_back({i, space});
+            }
+        }
+
+        if (columns.empty()) {
+            return;
+        }
+
+        TableChunkView chunk;
+
+        /* only the pages of the id columns are touched */
+        while (reader.next_chunk(chunk)) {
+            for (const auto& column: columns) {
+                add_ids_(column.second,
+                         chunk.values[column.first],
+                         chunk.row_count);
+            }
+        }
+    }
+
+    /* ranges by id space, as inclusive (min, max) pairs */
+    const std::map<std::string, std::pair<std::int32_t, std::int32_t>>&
+    get_ranges() const {
+        return ranges_;
+    }
+
+    /* writes the ranges as a table with columns space, min_id and max_id */
+    void write(const std::string& filepath) const {
+        TableSchema schema;
+        schema.names = {"space", "min_id", "max_id"};
+        schema.types = {
+            ColumnType::String, ColumnType::Integer, ColumnType::Integer};
+
+        TableChunk chunk;
+        chunk.row_count = ranges_.size();
+        chunk.columns.resize(3);
+        chunk.columns[0].type = ColumnType::String;
+        chunk.columns[1].type = ColumnType::Integer;
+        chunk.columns[2].type = ColumnType::Integer;
+
+        for (const auto& range: ranges_) {
+            chunk.columns[0].values.push_back(range.first.size());
+            chunk.columns[0].bytes.append(range.first);
+            chunk.columns[1].values.push_back(range.second.first);
+            chunk.columns[2].values.push_back(range.second.second);
+        }
+
+        TableFile file(filepath, schema);
+        file.write_chunk(chunk);
+        file.close();
+    }
+
+  private:
+    void add_ids_(const std::string& space,
+                  const std::int32_t* values,
+                  std::uint32_t row_count) {
+        bool found = false;
+        std::int32_t min = 0;
+        std::int32_t max = 0;
+
+        for (std::uint32_t row = 0; row < row_count; ++row) {
+            std::int32_t value;
+            /* mapped chunks are not necessarily aligned */
+            std::memcpy(&value, values + row, sizeof(value));
+
+            if (value < 0) {
+                continue;
+            }
+
+            if (!found || value < min) {
+                min = value;
+            }
+            if (!found || value > max) {
+                max = value;
+            }
+            found = true;
+        }
+
+        if (!found) {
+            return;
+        }
+
+        auto iter = ranges_.find(space);
+
+        if (iter == ranges_.end()) {
+            ranges_.insert({space, {min, max}});
+        } else {
+            iter->second.first = std::min(iter->second.first, min);
+            iter->second.second = std::max(iter->second.second, max);
+        }
+    }
+
+    std::map<std::string, std::pair<std::int32_t, std::int32_t>> ranges_;
+};
+
+#endif /* ENVTRACER_SHARD_MANIFEST_H */
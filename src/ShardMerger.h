@@ -0,0 +1,788 @@
+#ifndef ENVTRACER_SHARD_MERGER_H
+#define ENVTRACER_SHARD_MERGER_H
+
+#include "ShardManifest.h"
+#include "TableReader.h"
+#include "TableStream.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+/* NOTE: like TableStream.h, this header does not depend on R. */
+
+/* separator of qualified function names, see FunctionTable.h */
+#define ENVTRACER_QUALIFIED_NAME_SEPARATOR "*$#$*"
+
+/* Merges trace shards written by trace_files into one trace.
+
+   Ids of every id space are shifted so that the ranges recorded in the
+   shard manifests do not overlap. Functions are deduplicated by fun_hash:
+   the first shard defining a function provides its row and the call counts
+   of all shards are summed. Function ids without a row in any functions
+   table are shifted into a range after the deduplicated ones.
+
+   Tables are streamed chunk by chunk from the memory mapped shards and are
+   merged in parallel, one table per thread. Every thread holds at most
+   memory_budget / threads bytes of copied rows at a time; larger chunks
+   are split. Summaries per function and per package are written along
+   with the merged tables, and the output is itself a shard. */
+class ShardMerger {
+  public:
+    ShardMerger(const std::vector<std::string>& shards,
+                const std::string& output,
+                int threads,
+                std::size_t memory_budget)
+        : output_(output)
+        , threads_(std::max(threads, 1))
+        , memory_budget_(memory_budget)
+        , function_count_(0) {
+        for (const std::string& dir: shards) {
+            shards_.push_back(Shard());
+            shards_.back().dir = dir;
+        }
+    }
+
+    void merge() {
+        load_manifests_();
+        merge_functions_();
+        merge_tables_();
+        write_summaries_();
+
+        ShardManifest manifest;
+        manifest.add_directory(output_);
+        manifest.write(output_ + "/" + ENVTRACER_SHARD_MANIFEST);
+    }
+
+  private:
+    typedef std::map<std::string, std::pair<std::int32_t, std::int32_t>>
+        Ranges;
+
+    struct Shard {
+        std::string dir;
+        Ranges ranges;
+        /* added to the ids of each space except fun */
+        std::map<std::string, std::int64_t> offsets;
+        /* added to the fun ids without a row in any functions table */
+        std::int64_t fun_offset = 0;
+        /* global ids of the functions in the functions table */
+        std::unordered_map<std::int32_t, std::int32_t> fun_ids;
+    };
+
+    struct FunctionSummary {
+        bool has_hash;
+        std::string fun_hash;
+        bool has_qual_name;
+        std::string qual_name;
+        std::int64_t call_count;
+        int shard_count;
+        /* shard and row that define the function */
+        int shard;
+        std::size_t row;
+    };
+
+    /* reads successive values of a string column of a chunk */
+    class StringCursor {
+      public:
+        StringCursor(const TableChunkView& chunk, std::size_t column)
+            : lengths_(chunk.values[column]), bytes_(chunk.bytes[column]) {
+        }
+
+        /* returns false if the value is NA */
+        bool next(std::string& value) {
+            std::int32_t length;
+            std::memcpy(&length, lengths_++, sizeof(length));
+            if (length == -1) {
+                return false;
+            }
+            value.assign(bytes_, length);
+            bytes_ += length;
+            return true;
+        }
+
+      private:
+        const std::int32_t* lengths_;
+        const char* bytes_;
+    };
+
+    static std::string get_filepath_(const std::string& dir,
+                                     const std::string& table) {
+        return dir + "/" + table + ".tbl";
+    }
+
+    static bool exists_(const std::string& filepath) {
+        return access(filepath.c_str(), R_OK) == 0;
+    }
+
+    static std::size_t find_column_(const TableSchema& schema,
+                                    const std::string& name,
+                                    const std::string& filepath) {
+        for (std::size_t i = 0; i < schema.names.size(); ++i) {
+            if (schema.names[i] == name) {
+                return i;
+            }
+        }
+        throw std::runtime_error("'" + filepath + "' has no column '" + name +
+                                 "'");
+    }
+
+    static Ranges read_manifest_(const std::string& dir) {
+        std::string filepath = dir + "/" + ENVTRACER_SHARD_MANIFEST;
+
+        /* shards traced before manifests existed are scanned instead */
+        if (!exists_(filepath)) {
+            ShardManifest manifest;
+            manifest.add_directory(dir);
+            return manifest.get_ranges();
+        }
+
+        Ranges ranges;
+        TableReader reader(filepath);
+        const TableSchema& schema = reader.get_schema();
+        std::size_t space = find_column_(schema, "space", filepath);
+        std::size_t min_id = find_column_(schema, "min_id", filepath);
+        std::size_t max_id = find_column_(schema, "max_id", filepath);
+        TableChunkView chunk;
+
+        while (reader.next_chunk(chunk)) {
+            StringCursor spaces(chunk, space);
+            for (std::uint32_t row = 0; row < chunk.row_count; ++row) {
+                std::string name;
+                std::int32_t min;
+                std::int32_t max;
+                spaces.next(name);
+                std::memcpy(&min, chunk.values[min_id] + row, sizeof(min));
+                std::memcpy(&max, chunk.values[max_id] + row, sizeof(max));
+                ranges[name] = {min, max};
+            }
+        }
+
+        return ranges;
+    }
+
+    /* lays the id ranges of the shards out one after the other */
+    void load_manifests_() {
+        std::map<std::string, std::int64_t> bases;
+
+        for (Shard& shard: shards_) {
+            shard.ranges = read_manifest_(shard.dir);
+
+            for (const auto& range: shard.ranges) {
+                if (range.first == "fun") {
+                    continue;
+                }
+                std::int64_t& base = bases[range.first];
+                shard.offsets[range.first] = base - range.second.first;
+                base += range.second.second - range.second.first + 1;
+                check_id_(base);
+            }
+        }
+    }
+
+    void merge_functions_() {
+        std::unordered_map<std::string, std::int32_t> hashes;
+
+        for (std::size_t index = 0; index < shards_.size(); ++index) {
+            collect_functions_(index, hashes);
+        }
+
+        function_count_ = summaries_.size();
+
+        std::int64_t base = function_count_;
+
+        for (Shard& shard: shards_) {
+            auto range = shard.ranges.find("fun");
+            if (range != shard.ranges.end()) {
+                shard.fun_offset = base - range->second.first;
+                base += range->second.second - range->second.first + 1;
+                check_id_(base);
+            }
+        }
+
+        write_functions_();
+    }
+
+    /* assigns global ids to the functions of a shard */
+    void collect_functions_(
+        std::size_t index,
+        std::unordered_map<std::string, std::int32_t>& hashes) {
+        Shard& shard = shards_[index];
+        std::string filepath = get_filepath_(shard.dir, "functions");
+
+        if (!exists_(filepath)) {
+            return;
+        }
+
+        TableReader reader(filepath);
+        const TableSchema& schema = reader.get_schema();
+        std::size_t fun_id = find_column_(schema, "fun_id", filepath);
+        std::size_t fun_hash = find_column_(schema, "fun_hash", filepath);
+        std::size_t qual_name = find_column_(schema, "qual_name", filepath);
+        std::size_t call_count = find_column_(schema, "call_count", filepath);
+        TableChunkView chunk;
+        std::size_t row_offset = 0;
+
+        while (reader.next_chunk(chunk)) {
+            StringCursor hash_cursor(chunk, fun_hash);
+            StringCursor name_cursor(chunk, qual_name);
+
+            for (std::uint32_t row = 0; row < chunk.row_count; ++row) {
+                std::int32_t local_id;
+                std::int32_t count;
+                std::memcpy(&local_id, chunk.values[fun_id] + row, 4);
+                std::memcpy(&count, chunk.values[call_count] + row, 4);
+
+                FunctionSummary summary;
+                summary.has_hash = hash_cursor.next(summary.fun_hash);
+                summary.has_qual_name = name_cursor.next(summary.qual_name);
+
+                std::int32_t global_id = summaries_.size();
+
+                if (summary.has_hash) {
+                    auto iter = hashes.find(summary.fun_hash);
+                    if (iter != hashes.end()) {
+                        global_id = iter->second;
+                    } else {
+                        hashes.insert({summary.fun_hash, global_id});
+                    }
+                }
+
+                if (global_id == static_cast<std::int32_t>(summaries_.size())) {
+                    summary.call_count = 0;
+                    summary.shard_count = 0;
+                    summary.shard = index;
+                    summary.row = row_offset + row;
+                    summaries_.push_back(summary);
+                    last_shards_.push_back(-1);
+                    check_id_(summaries_.size());
+                }
+
+                FunctionSummary& defined = summaries_[global_id];
+
+                if (count != std::numeric_limits<std::int32_t>::min()) {
+                    defined.call_count += count;
+                }
+
+                if (last_shards_[global_id] != static_cast<int>(index)) {
+                    last_shards_[global_id] = index;
+                    ++defined.shard_count;
+                }
+
+                shard.fun_ids.insert({local_id, global_id});
+            }
+
+            row_offset += chunk.row_count;
+        }
+    }
+
+    /* writes the defining row of every function with remapped ids */
+    void write_functions_() {
+        std::unique_ptr<TableFile> file;
+        TableSchema schema;
+        TableChunk output;
+
+        for (std::size_t index = 0; index < shards_.size(); ++index) {
+            std::string filepath = get_filepath_(shards_[index].dir,
+                                                 "functions");
+            if (!exists_(filepath)) {
+                continue;
+            }
+
+            TableReader reader(filepath);
+
+            if (!file) {
+                schema = reader.get_schema();
+                file.reset(new TableFile(
+                    get_filepath_(output_, "functions"), schema));
+                reset_chunk_(output, schema);
+            } else {
+                check_schema_(schema, reader.get_schema(), filepath);
+            }
+
+            std::size_t fun_id = find_column_(schema, "fun_id", filepath);
+            std::size_t call_count =
+                find_column_(schema, "call_count", filepath);
+            std::vector<std::string> spaces = get_spaces_(schema);
+            TableChunkView chunk;
+            std::size_t row_offset = 0;
+            std::vector<const char*> bytes;
+
+            while (reader.next_chunk(chunk)) {
+                bytes = chunk.bytes;
+
+                for (std::uint32_t row = 0; row < chunk.row_count; ++row) {
+                    std::int32_t local_id;
+                    std::memcpy(&local_id,
+                                chunk.values[fun_id] + row,
+                                sizeof(local_id));
+                    std::int32_t global_id =
+                        shards_[index].fun_ids.at(local_id);
+                    const FunctionSummary& summary = summaries_[global_id];
+                    bool defining = summary.shard == static_cast<int>(index) &&
+                                    summary.row == row_offset + row;
+
+                    append_row_(output,
+                                chunk,
+                                row,
+                                bytes,
+                                defining ? &spaces : nullptr,
+                                shards_[index]);
+
+                    if (!defining) {
+                        continue;
+                    }
+
+                    std::int64_t count = std::min<std::int64_t>(
+                        summary.call_count,
+                        std::numeric_limits<std::int32_t>::max());
+                    output.columns[call_count].values.back() = count;
+                    ++output.row_count;
+
+                    if (output.row_count == FUNCTION_CHUNK_ROWS) {
+                        file->write_chunk(output);
+                        reset_chunk_(output, schema);
+                    }
+                }
+
+                row_offset += chunk.row_count;
+            }
+        }
+
+        if (file) {
+            if (output.row_count != 0) {
+                file->write_chunk(output);
+            }
+            file->close();
+        }
+    }
+
+    /* copies a row into output if spaces is given, otherwise only skips
+       over its string bytes */
+    void append_row_(TableChunk& output,
+                     const TableChunkView& chunk,
+                     std::uint32_t row,
+                     std::vector<const char*>& bytes,
+                     const std::vector<std::string>* spaces,
+                     const Shard& shard) const {
+        for (std::size_t i = 0; i < output.columns.size(); ++i) {
+            TableColumn& column = output.columns[i];
+
+            if (column.type == ColumnType::Double) {
+                if (spaces != nullptr) {
+                    double real;
+                    std::memcpy(&real, chunk.reals[i] + row, sizeof(real));
+                    column.reals.push_back(real);
+                }
+                continue;
+            }
+
+            std::int32_t value;
+            std::memcpy(&value, chunk.values[i] + row, sizeof(value));
+
+            if (column.type == ColumnType::String) {
+                if (spaces != nullptr) {
+                    column.values.push_back(value);
+                    if (value > 0) {
+                        column.bytes.append(bytes[i], value);
+                    }
+                }
+                if (value > 0) {
+                    bytes[i] += value;
+                }
+                continue;
+            }
+
+            if (spaces == nullptr) {
+                continue;
+            }
+
+            if (!(*spaces)[i].empty()) {
+                remap_ids_((*spaces)[i], shard, &value, 1);
+            }
+
+            column.values.push_back(value);
+        }
+    }
+
+    /* merges every table except functions, one table per thread */
+    void merge_tables_() {
+        std::set<std::string> names;
+
+        for (const Shard& shard: shards_) {
+            for (const std::string& name: list_tables(shard.dir)) {
+                if (name != "functions" && name != "function_summary" &&
+                    name != "package_summary" &&
+                    name + ".tbl" != ENVTRACER_SHARD_MANIFEST) {
+                    names.insert(name);
+                }
+            }
+        }
+
+        std::vector<std::string> tables(names.begin(), names.end());
+        std::atomic<std::size_t> next(0);
+        std::mutex mutex;
+        std::string message;
+        std::size_t thread_count =
+            std::min<std::size_t>(threads_, tables.size());
+        std::size_t budget = memory_budget_ / std::max<std::size_t>(
+                                                  thread_count, 1);
+        std::vector<std::thread> threads;
+
+        for (std::size_t i = 0; i < thread_count; ++i) {
+            threads.emplace_back([&]() {
+                std::size_t index;
+                while ((index = next++) < tables.size()) {
+                    try {
+                        merge_table_(tables[index], budget);
+                    } catch (const std::exception& e) {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        if (message.empty()) {
+                            message = e.what();
+                        }
+                    }
+                }
+            });
+        }
+
+        for (std::thread& thread: threads) {
+            thread.join();
+        }
+
+        if (!message.empty()) {
+            throw std::runtime_error(message);
+        }
+    }
+
+    void merge_table_(const std::string& table, std::size_t budget) const {
+        std::unique_ptr<TableFile> file;
+        TableSchema schema;
+        std::vector<std::string> spaces;
+        TableChunk output;
+
+        for (const Shard& shard: shards_) {
+            std::string filepath = get_filepath_(shard.dir, table);
+
+            if (!exists_(filepath)) {
+                continue;
+            }
+
+            TableReader reader(filepath);
+
+            if (!file) {
+                schema = reader.get_schema();
+                spaces = get_spaces_(schema);
+                file.reset(
+                    new TableFile(get_filepath_(output_, table), schema));
+            } else {
+                check_schema_(schema, reader.get_schema(), filepath);
+            }
+
+            TableChunkView chunk;
+
+            while (reader.next_chunk(chunk)) {
+                std::uint32_t rows = get_slice_rows_(schema, chunk, budget);
+                std::vector<const char*> bytes = chunk.bytes;
+
+                for (std::uint32_t start = 0; start < chunk.row_count;
+                     start += rows) {
+                    std::uint32_t end =
+                        std::min<std::uint32_t>(start + rows, chunk.row_count);
+                    copy_slice_(output, schema, spaces, chunk, bytes,
+                                start, end, shard);
+                    file->write_chunk(output);
+                }
+            }
+        }
+
+        if (file) {
+            file->close();
+        }
+    }
+
+    /* rows of a chunk copied at once so that a slice fits the budget */
+    static std::uint32_t get_slice_rows_(const TableSchema& schema,
+                                         const TableChunkView& chunk,
+                                         std::size_t budget) {
+        if (chunk.row_count == 0) {
+            return 1;
+        }
+
+        std::size_t bytes = 0;
+
+        for (std::size_t i = 0; i < schema.types.size(); ++i) {
+            if (schema.types[i] == ColumnType::Double) {
+                bytes += chunk.row_count * sizeof(double);
+            } else {
+                bytes += chunk.row_count * sizeof(std::int32_t);
+            }
+            if (schema.types[i] == ColumnType::String) {
+                for (std::uint32_t row = 0; row < chunk.row_count; ++row) {
+                    std::int32_t length;
+                    std::memcpy(&length, chunk.values[i] + row, 4);
+                    bytes += std::max(length, 0);
+                }
+            }
+        }
+
+        if (bytes <= budget) {
+            return chunk.row_count;
+        }
+
+        std::size_t rows = chunk.row_count * budget / bytes;
+
+        return std::max<std::size_t>(rows, 1);
+    }
+
+    void copy_slice_(TableChunk& output,
+                     const TableSchema& schema,
+                     const std::vector<std::string>& spaces,
+                     const TableChunkView& chunk,
+                     std::vector<const char*>& bytes,
+                     std::uint32_t start,
+                     std::uint32_t end,
+                     const Shard& shard) const {
+        std::uint32_t rows = end - start;
+
+        reset_chunk_(output, schema);
+        output.row_count = rows;
+
+        for (std::size_t i = 0; i < schema.types.size(); ++i) {
+            TableColumn& column = output.columns[i];
+
+            if (column.type == ColumnType::Double) {
+                column.reals.resize(rows);
+                std::memcpy(column.reals.data(),
+                            chunk.reals[i] + start,
+                            rows * sizeof(double));
+                continue;
+            }
+
+            column.values.resize(rows);
+            std::memcpy(column.values.data(),
+                        chunk.values[i] + start,
+                        rows * sizeof(std::int32_t));
+
+            if (column.type == ColumnType::String) {
+                std::size_t size = 0;
+                for (std::int32_t length: column.values) {
+                    size += std::max(length, 0);
+                }
+                column.bytes.assign(bytes[i], size);
+                bytes[i] += size;
+            } else if (!spaces[i].empty()) {
+                remap_ids_(spaces[i], shard, column.values.data(), rows);
+            }
+        }
+    }
+
+    void remap_ids_(const std::string& space,
+                    const Shard& shard,
+                    std::int32_t* values,
+                    std::size_t size) const {
+        if (space == "fun") {
+            for (std::size_t i = 0; i < size; ++i) {
+                if (values[i] < 0) {
+                    continue;
+                }
+                auto iter = shard.fun_ids.find(values[i]);
+                values[i] = iter != shard.fun_ids.end()
+                                ? iter->second
+                                : values[i] + shard.fun_offset;
+            }
+            return;
+        }
+
+        auto iter = shard.offsets.find(space);
+
+        /* the manifest covers every id of the shard */
+        if (iter == shard.offsets.end()) {
+            return;
+        }
+
+        std::int32_t offset = iter->second;
+
+        for (std::size_t i = 0; i < size; ++i) {
+            if (values[i] >= 0) {
+                values[i] += offset;
+            }
+        }
+    }
+
+    void write_summaries_() const {
+        TableChunk functions;
+        TableSchema function_schema;
+        function_schema.names = {"fun_id",
+                                 "fun_hash",
+                                 "qual_name",
+                                 "package",
+                                 "call_count",
+                                 "shard_count"};
+        function_schema.types = {ColumnType::Integer,
+                                 ColumnType::String,
+                                 ColumnType::String,
+                                 ColumnType::String,
+                                 ColumnType::Double,
+                                 ColumnType::Integer};
+        reset_chunk_(functions, function_schema);
+
+        struct PackageSummary {
+            std::int32_t function_count = 0;
+            double call_count = 0;
+            std::set<int> shards;
+        };
+
+        std::map<std::string, PackageSummary> packages;
+
+        for (std::size_t id = 0; id < summaries_.size(); ++id) {
+            const FunctionSummary& summary = summaries_[id];
+            std::string package;
+            bool has_package = get_package_(summary, package);
+
+            functions.columns[0].values.push_back(id);
+            put_string_(functions.columns[1], summary.has_hash,
+                        summary.fun_hash);
+            put_string_(functions.columns[2], summary.has_qual_name,
+                        summary.qual_name);
+            put_string_(functions.columns[3], has_package, package);
+            functions.columns[4].reals.push_back(summary.call_count);
+            functions.columns[5].values.push_back(summary.shard_count);
+            ++functions.row_count;
+
+            if (has_package) {
+                PackageSummary& package_summary = packages[package];
+                ++package_summary.function_count;
+                package_summary.call_count += summary.call_count;
+            }
+        }
+
+        /* a package is counted once per shard in which it was called */
+        for (std::size_t index = 0; index < shards_.size(); ++index) {
+            for (const auto& fun_id: shards_[index].fun_ids) {
+                std::string package;
+                if (get_package_(summaries_[fun_id.second], package)) {
+                    packages[package].shards.insert(index);
+                }
+            }
+        }
+
+        TableFile function_file(get_filepath_(output_, "function_summary"),
+                                function_schema);
+        function_file.write_chunk(functions);
+        function_file.close();
+
+        TableChunk package_chunk;
+        TableSchema package_schema;
+        package_schema.names = {
+            "package", "function_count", "call_count", "shard_count"};
+        package_schema.types = {ColumnType::String,
+                                ColumnType::Integer,
+                                ColumnType::Double,
+                                ColumnType::Integer};
+        reset_chunk_(package_chunk, package_schema);
+
+        for (const auto& package: packages) {
+            put_string_(package_chunk.columns[0], true, package.first);
+            package_chunk.columns[1].values.push_back(
+                package.second.function_count);
+            package_chunk.columns[2].reals.push_back(
+                package.second.call_count);
+            package_chunk.columns[3].values.push_back(
+                package.second.shards.size());
+            ++package_chunk.row_count;
+        }
+
+        TableFile package_file(get_filepath_(output_, "package_summary"),
+                               package_schema);
+        package_file.write_chunk(package_chunk);
+        package_file.close();
+    }
+
+    /* package of a function from the first component of its qualified
+       name, false if it has none */
+    static bool get_package_(const FunctionSummary& summary,
+                             std::string& package) {
+        if (!summary.has_qual_name) {
+            return false;
+        }
+
+        std::size_t end =
+            summary.qual_name.find(ENVTRACER_QUALIFIED_NAME_SEPARATOR);
+
+        if (end == std::string::npos || end == 0) {
+            return false;
+        }
+
+        package = summary.qual_name.substr(0, end);
+        return package != "<NA>";
+    }
+
+    static void put_string_(TableColumn& column,
+                            bool present,
+                            const std::string& value) {
+        if (!present) {
+            column.values.push_back(-1);
+            return;
+        }
+        column.values.push_back(value.size());
+        column.bytes.append(value);
+    }
+
+    static std::vector<std::string> get_spaces_(const TableSchema& schema) {
+        std::vector<std::string> spaces;
+        for (std::size_t i = 0; i < schema.names.size(); ++i) {
+            spaces.push_back(schema.types[i] == ColumnType::Integer
+                                 ? get_id_space(schema.names[i])
+                                 : "");
+        }
+        return spaces;
+    }
+
+    static void reset_chunk_(TableChunk& chunk, const TableSchema& schema) {
+        chunk.row_count = 0;
+        chunk.columns.clear();
+        chunk.columns.resize(schema.types.size());
+        for (std::size_t i = 0; i < schema.types.size(); ++i) {
+            chunk.columns[i].type = schema.types[i];
+        }
+    }
+
+    static void check_schema_(const TableSchema& expected,
+                              const TableSchema& actual,
+                              const std::string& filepath) {
+        if (expected.names != actual.names ||
+            expected.types != actual.types) {
+            throw std::runtime_error("'" + filepath +
+                                     "' does not match the schema of the "
+                                     "same table in the first shard");
+        }
+    }
+
+    static void check_id_(std::int64_t id) {
+        if (id > std::numeric_limits<std::int32_t>::max()) {
+            throw std::runtime_error("merged ids do not fit in 32 bits");
+        }
+    }
+
+    static const std::uint32_t FUNCTION_CHUNK_ROWS = 65536;
+
+    std::string output_;
+    int threads_;
+    std::size_t memory_budget_;
+    std::vector<Shard> shards_;
+    std::vector<FunctionSummary> summaries_;
+    std::vector<int> last_shards_;
+    std::int32_t function_count_;
+};
+
+#endif /* ENVTRACER_SHARD_MERGER_H */
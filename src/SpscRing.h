@@ -0,0 +1,80 @@
+#ifndef ENVTRACER_SPSC_RING_H
+#define ENVTRACER_SPSC_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+/* Bounded lock-free queue for exactly one producer and one consumer
+   thread. The capacity is rounded up to a power of two. Each side keeps a
+   cached copy of the other side's index so that the shared indices are
+   only read when the ring looks full or empty. */
+template <typename T>
+class SpscRing {
+  public:
+    explicit SpscRing(std::size_t capacity)
+        : head_(0), cached_tail_(0), tail_(0), cached_head_(0) {
+        std::size_t size = 2;
+        while (size < capacity) {
+            size *= 2;
+        }
+        slots_.resize(size);
+        mask_ = size - 1;
+    }
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    /* producer side, returns false if the ring is full */
+    bool try_push(const T& value) {
+        std::size_t tail = tail_.load(std::memory_order_relaxed);
+
+        if (tail - cached_head_ == slots_.size()) {
+            cached_head_ = head_.load(std::memory_order_acquire);
+            if (tail - cached_head_ == slots_.size()) {
+                return false;
+            }
+        }
+
+        slots_[tail & mask_] = value;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /* consumer side, returns false if the ring is empty */
+    bool try_pop(T& value) {
+        std::size_t head = head_.load(std::memory_order_relaxed);
+
+        if (head == cached_tail_) {
+            cached_tail_ = tail_.load(std::memory_order_acquire);
+            if (head == cached_tail_) {
+                return false;
+            }
+        }
+
+        value = slots_[head & mask_];
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+  private:
+    /* padding keeps the two sides on separate cache lines; alignas would
+       need over-aligned new, which is not available before C++17 */
+    static const std::size_t PAD = 64 - sizeof(std::size_t);
+
+    std::vector<T> slots_;
+    std::size_t mask_;
+    char pad0_[PAD];
+    /* written by the consumer */
+    std::atomic<std::size_t> head_;
+    /* consumer's copy of tail_ */
+    std::size_t cached_tail_;
+    char pad1_[PAD];
+    /* written by the producer */
+    std::atomic<std::size_t> tail_;
+    /* producer's copy of head_ */
+    std::size_t cached_head_;
+    char pad2_[PAD];
+};
+
+#endif /* ENVTRACER_SPSC_RING_H */
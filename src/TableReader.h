@@ -0,0 +1,174 @@
+#ifndef ENVTRACER_TABLE_READER_H
+#define ENVTRACER_TABLE_READER_H
+
+#include "TableStream.h"
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+/* Zero-copy view of one chunk of a table file. Pointers refer to the
+   memory mapped file and stay valid as long as the reader is alive. */
+struct TableChunkView {
+    std::uint32_t row_count;
+    /* values for integer and logical columns, lengths for string columns */
+    std::vector<const std::int32_t*> values;
+    std::vector<const double*> reals;
+    std::vector<const char*> bytes;
+};
+
+/* Reads a table file written by TableFile by memory mapping it and
+   iterating over its chunks. */
+class TableReader {
+  public:
+    explicit TableReader(const std::string& filepath)
+        : filepath_(filepath), data_(nullptr), size_(0), offset_(0) {
+        int fd = open(filepath.c_str(), O_RDONLY);
+
+        if (fd == -1) {
+            throw std::runtime_error("cannot open '" + filepath + "'");
+        }
+
+        struct stat info;
+
+        if (fstat(fd, &info) == -1) {
+            ::close(fd);
+            throw std::runtime_error("cannot stat '" + filepath + "'");
+        }
+
+        size_ = info.st_size;
+
+        if (size_ != 0) {
+            void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data == MAP_FAILED) {
+                ::close(fd);
+                throw std::runtime_error("cannot map '" + filepath + "'");
+            }
+            data_ = static_cast<const char*>(data);
+        }
+
+        ::close(fd);
+
+        read_header_();
+        chunks_offset_ = offset_;
+    }
+
+    ~TableReader() {
+        if (data_ != nullptr) {
+            munmap(const_cast<char*>(data_), size_);
+        }
+    }
+
+    TableReader(const TableReader&) = delete;
+    TableReader& operator=(const TableReader&) = delete;
+
+    const TableSchema& get_schema() const {
+        return schema_;
+    }
+
+    void rewind() {
+        offset_ = chunks_offset_;
+    }
+
+    bool next_chunk(TableChunkView& chunk) {
+        if (offset_ == size_) {
+            return false;
+        }
+
+        std::size_t column_count = schema_.types.size();
+
+        chunk.row_count = read_u32_();
+        chunk.values.assign(column_count, nullptr);
+        chunk.reals.assign(column_count, nullptr);
+        chunk.bytes.assign(column_count, nullptr);
+
+        for (std::size_t i = 0; i < column_count; ++i) {
+            std::uint32_t byte_count = 0;
+
+            if (schema_.types[i] == ColumnType::String) {
+                byte_count = read_u32_();
+            }
+
+            if (schema_.types[i] == ColumnType::Double) {
+                chunk.reals[i] = reinterpret_cast<const double*>(
+                    advance_(chunk.row_count * sizeof(double)));
+                continue;
+            }
+
+            chunk.values[i] = reinterpret_cast<const std::int32_t*>(
+                advance_(chunk.row_count * sizeof(std::int32_t)));
+
+            if (schema_.types[i] == ColumnType::String) {
+                chunk.bytes[i] = advance_(byte_count);
+            }
+        }
+
+        return true;
+    }
+
+    /* counts rows by skipping over chunks without touching their data */
+    std::size_t count_rows() {
+        std::size_t offset = offset_;
+        std::size_t rows = 0;
+        TableChunkView chunk;
+
+        rewind();
+
+        while (next_chunk(chunk)) {
+            rows += chunk.row_count;
+        }
+
+        offset_ = offset;
+        return rows;
+    }
+
+  private:
+    void read_header_() {
+        const char* magic = advance_(ENVTRACER_TABLE_MAGIC_SIZE);
+
+        if (std::memcmp(magic, ENVTRACER_TABLE_MAGIC,
+                        ENVTRACER_TABLE_MAGIC_SIZE) != 0) {
+            throw std::runtime_error("'" + filepath_ +
+                                     "' is not an envtracer table");
+        }
+
+        std::uint32_t column_count = read_u32_();
+
+        for (std::uint32_t i = 0; i < column_count; ++i) {
+            std::uint8_t type = *advance_(1);
+            std::uint32_t length = read_u32_();
+            const char* name = advance_(length);
+            schema_.types.push_back(static_cast<ColumnType>(type));
+            schema_.names.push_back(std::string(name, length));
+        }
+    }
+
+    const char* advance_(std::size_t size) {
+        if (offset_ + size > size_) {
+            throw std::runtime_error("'" + filepath_ + "' is truncated");
+        }
+        const char* pointer = data_ + offset_;
+        offset_ += size;
+        return pointer;
+    }
+
+    std::uint32_t read_u32_() {
+        std::uint32_t value;
+        std::memcpy(&value, advance_(sizeof(value)), sizeof(value));
+        return value;
+    }
+
+    std::string filepath_;
+    const char* data_;
+    std::size_t size_;
+    std::size_t offset_;
+    std::size_t chunks_offset_;
+    TableSchema schema_;
+};
+
+#endif /* ENVTRACER_TABLE_READER_H */
@@ -0,0 +1,400 @@
+#ifndef ENVTRACER_TABLE_STREAM_H
+#define ENVTRACER_TABLE_STREAM_H
+
+#include "EventChannel.h"
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/* NOTE: this header does not depend on R so that tables can be written
+   and read outside of an R session. */
+
+extern const std::string ENVTRACER_NA_STRING;
+
+/* Binary columnar table format.
+
+   header: magic "ENVTRC01"
+           uint32 column count
+           per column: uint8 type, uint32 name length, name bytes
+   chunk:  uint32 row count
+           per integer or logical column: row count int32 values
+           per double column: row count float64 values
+           per string column: uint32 byte count, row count int32 lengths
+                              (-1 for NA), byte count bytes
+
+   Chunks follow each other until the end of the file. */
+
+#define ENVTRACER_TABLE_MAGIC "ENVTRC01"
+#define ENVTRACER_TABLE_MAGIC_SIZE 8
+
+enum class ColumnType : std::uint8_t {
+    Integer = 0,
+    Logical = 1,
+    String = 2,
+    Double = 3
+};
+
+struct TableColumn {
+    ColumnType type;
+    /* values for integer and logical columns, lengths for string columns */
+    std::vector<std::int32_t> values;
+    std::vector<double> reals;
+    std::string bytes;
+};
+
+struct TableChunk {
+    std::uint32_t row_count;
+    std::vector<TableColumn> columns;
+};
+
+struct TableSchema {
+    std::vector<std::string> names;
+    std::vector<ColumnType> types;
+};
+
+/* Writes the header and chunks of a table file. Not thread safe; a file is
+   only ever written by one thread at a time. */
+class TableFile {
+  public:
+    TableFile(const std::string& filepath, const TableSchema& schema)
+        : filepath_(filepath), file_(std::fopen(filepath.c_str(), "wb")) {
+        if (file_ == nullptr) {
+            throw std::runtime_error("cannot open '" + filepath +
+                                     "' for writing");
+        }
+
+        write_(ENVTRACER_TABLE_MAGIC, ENVTRACER_TABLE_MAGIC_SIZE);
+
+        write_u32_(schema.names.size());
+
+        for (std::size_t i = 0; i < schema.names.size(); ++i) {
+            std::uint8_t type = static_cast<std::uint8_t>(schema.types[i]);
+            write_(&type, sizeof(type));
+            write_u32_(schema.names[i].size());
+            write_(schema.names[i].data(), schema.names[i].size());
+        }
+    }
+
+    ~TableFile() {
+        close();
+    }
+
+    const std::string& get_filepath() const {
+        return filepath_;
+    }
+
+    void write_chunk(const TableChunk& chunk) {
+        write_u32_(chunk.row_count);
+
+        for (const TableColumn& column: chunk.columns) {
+            if (column.type == ColumnType::String) {
+                write_u32_(column.bytes.size());
+            }
+            write_(column.values.data(),
+                   column.values.size() * sizeof(std::int32_t));
+            write_(column.reals.data(), column.reals.size() * sizeof(double));
+            if (column.type == ColumnType::String) {
+                write_(column.bytes.data(), column.bytes.size());
+            }
+        }
+    }
+
+    void close() {
+        if (file_ != nullptr) {
+            std::fclose(file_);
+            file_ = nullptr;
+        }
+    }
+
+  private:
+    void write_(const void* data, std::size_t size) {
+        if (size != 0 && std::fwrite(data, 1, size, file_) != size) {
+            throw std::runtime_error("cannot write to '" + filepath_ + "'");
+        }
+    }
+
+    void write_u32_(std::uint32_t value) {
+        write_(&value, sizeof(value));
+    }
+
+    std::string filepath_;
+    std::FILE* file_;
+};
+
+/* Background thread that writes full chunks to their files. The queue is
+   bounded; producers wait when it is full so that memory stays bounded
+   even if the disk is slower than the tracer. */
+class StreamWriter {
+  public:
+    explicit StreamWriter(std::size_t max_pending = 16)
+        : max_pending_(max_pending), stop_(false), channel_(nullptr) {
+        thread_ = std::thread(&StreamWriter::run_, this);
+    }
+
+    /* streams of this writer send their rows over the channel to an
+       analyzer process, which writes the files instead */
+    explicit StreamWriter(EventChannel& channel)
+        : max_pending_(0), stop_(true), channel_(&channel) {
+    }
+
+    EventChannel* get_channel() const {
+        return channel_;
+    }
+
+    ~StreamWriter() {
+        stop();
+    }
+
+    void submit(TableFile* file, TableChunk&& chunk) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_full_.wait(lock, [this] { return queue_.size() < max_pending_; });
+        queue_.emplace_back(file, std::move(chunk));
+        not_empty_.notify_one();
+    }
+
+    /* waits for all pending chunks to be written and reports the first
+       error encountered by the writer thread. */
+    void drain() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        drained_.wait(lock, [this] { return queue_.empty() && !busy_; });
+        if (!error_.empty()) {
+            throw std::runtime_error(error_);
+        }
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stop_) {
+                return;
+            }
+            stop_ = true;
+        }
+        not_empty_.notify_one();
+        thread_.join();
+    }
+
+  private:
+    void run_() {
+        while (true) {
+            std::pair<TableFile*, TableChunk> job;
+
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                not_empty_.wait(lock,
+                                [this] { return stop_ || !queue_.empty(); });
+
+                if (queue_.empty()) {
+                    return;
+                }
+
+                job = std::move(queue_.front());
+                queue_.pop_front();
+                busy_ = true;
+                not_full_.notify_one();
+            }
+
+            try {
+                job.first->write_chunk(job.second);
+            } catch (const std::exception& e) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (error_.empty()) {
+                    error_ = e.what();
+                }
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                busy_ = false;
+                if (queue_.empty()) {
+                    drained_.notify_all();
+                }
+            }
+        }
+    }
+
+    std::size_t max_pending_;
+    bool stop_;
+    EventChannel* channel_;
+    bool busy_ = false;
+    std::string error_;
+    std::deque<std::pair<TableFile*, TableChunk>> queue_;
+    std::mutex mutex_;
+    std::condition_variable not_empty_;
+    std::condition_variable not_full_;
+    std::condition_variable drained_;
+    std::thread thread_;
+};
+
+/* Row oriented writer for a single table. Values are appended column by
+   column into a chunk of at most chunk_size rows which is handed over to
+   the StreamWriter once full. If the writer has an event channel, each row
+   is encoded as a single message instead and no chunk is kept. */
+class TableStream {
+  public:
+    TableStream(StreamWriter& writer,
+                const std::string& filepath,
+                const TableSchema& schema,
+                int chunk_size)
+        : writer_(writer)
+        , channel_(writer.get_channel())
+        , schema_(schema)
+        , chunk_size_(chunk_size)
+        , column_(0)
+        , row_count_(0) {
+        if (channel_ != nullptr) {
+            std::vector<std::uint8_t> types;
+            for (ColumnType type: schema.types) {
+                types.push_back(static_cast<std::uint8_t>(type));
+            }
+            table_ = channel_->open_table(filepath, schema.names, types);
+            return;
+        }
+        file_.reset(new TableFile(filepath, schema));
+        reset_chunk_();
+    }
+
+    ~TableStream() {
+        try {
+            close();
+        } catch (const std::exception& e) {
+            /* errors are reported by explicit calls to close */
+        }
+    }
+
+    int get_row_count() const {
+        return row_count_;
+    }
+
+    void put_int(int value) {
+        if (channel_ != nullptr) {
+            put_row_(static_cast<std::int32_t>(value));
+            return;
+        }
+        chunk_.columns[column_++].values.push_back(value);
+    }
+
+    void put_logical(int value) {
+        put_int(value);
+    }
+
+    void put_double(double value) {
+        if (channel_ != nullptr) {
+            put_row_(value);
+            return;
+        }
+        chunk_.columns[column_++].reals.push_back(value);
+    }
+
+    void put_string(const std::string& value) {
+        if (value == ENVTRACER_NA_STRING) {
+            put_na_string();
+            return;
+        }
+        put_string_(value.data(), value.size());
+    }
+
+    void put_string(const char* value) {
+        if (value == nullptr) {
+            put_na_string();
+            return;
+        }
+        put_string_(value, std::strlen(value));
+    }
+
+    void put_na_string() {
+        put_int(-1);
+    }
+
+    void end_row() {
+        column_ = 0;
+        ++row_count_;
+        if (channel_ != nullptr) {
+            channel_->send_row(table_, row_);
+            row_.clear();
+            return;
+        }
+        ++chunk_.row_count;
+        if (chunk_.row_count == chunk_size_) {
+            flush();
+        }
+    }
+
+    void flush() {
+        if (channel_ != nullptr || chunk_.row_count == 0) {
+            return;
+        }
+        writer_.submit(file_.get(), std::move(chunk_));
+        reset_chunk_();
+    }
+
+    /* flushes the last partial chunk and closes the file once it has been
+       written. */
+    void close() {
+        if (closed_) {
+            return;
+        }
+        closed_ = true;
+        if (channel_ != nullptr) {
+            channel_->close_table(table_);
+            return;
+        }
+        flush();
+        writer_.drain();
+        file_->close();
+    }
+
+  private:
+    template <typename T>
+    void put_row_(T value) {
+        row_.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    void put_string_(const char* value, std::size_t size) {
+        if (channel_ != nullptr) {
+            put_row_(static_cast<std::int32_t>(size));
+            row_.append(value, size);
+            return;
+        }
+        TableColumn& column = chunk_.columns[column_++];
+        column.values.push_back(size);
+        column.bytes.append(value, size);
+    }
+
+    void reset_chunk_() {
+        chunk_.row_count = 0;
+        chunk_.columns.clear();
+        chunk_.columns.resize(schema_.types.size());
+        for (std::size_t i = 0; i < schema_.types.size(); ++i) {
+            chunk_.columns[i].type = schema_.types[i];
+            if (schema_.types[i] == ColumnType::Double) {
+                chunk_.columns[i].reals.reserve(chunk_size_);
+            } else {
+                chunk_.columns[i].values.reserve(chunk_size_);
+            }
+        }
+    }
+
+    StreamWriter& writer_;
+    EventChannel* channel_;
+    std::uint16_t table_ = 0;
+    std::string row_;
+    std::unique_ptr<TableFile> file_;
+    TableSchema schema_;
+    std::uint32_t chunk_size_;
+    int column_;
+    int row_count_;
+    bool closed_ = false;
+    TableChunk chunk_;
+};
+
+#endif /* ENVTRACER_TABLE_STREAM_H */
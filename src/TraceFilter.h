@@ -0,0 +1,237 @@
+#ifndef ENVTRACER_TRACE_FILTER_H
+#define ENVTRACER_TRACE_FILTER_H
+
+#include "CallSampler.h"
+#include "IdBitset.h"
+#include <instrumentr/instrumentr.h>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+/* Names that restrict what is traced, see trace_filter in R/tracer.R. */
+struct TraceFilterSpec {
+    std::vector<std::string> include_namespaces;
+    std::vector<std::string> exclude_namespaces;
+    std::vector<std::string> include_functions;
+    std::vector<std::string> exclude_functions;
+    std::vector<std::string> include_env_types;
+    std::vector<std::string> exclude_env_types;
+};
+
+/* Decides whether an event is traced. A call to an excluded closure mutes
+   everything until it returns. If closures are included by name, events
+   are only traced while an included closure is on the stack. Variable
+   events are additionally filtered by the type of their environment.
+
+   The events of calls that are not sampled by the CallSampler are muted
+   too; unlike an excluded call, an unsampled call does not mute the calls
+   nested in it.
+
+   The names are hashed once when tracing starts; a closure's namespace and
+   name are only compared the first time its id is seen, after which it is
+   classified with two bit tests. */
+class TraceFilter {
+  public:
+    TraceFilter(const TraceFilterSpec& spec, const SamplingSpec& sampling)
+        : include_namespaces_(spec.include_namespaces.begin(),
+                              spec.include_namespaces.end())
+        , exclude_namespaces_(spec.exclude_namespaces.begin(),
+                              spec.exclude_namespaces.end())
+        , include_functions_(spec.include_functions.begin(),
+                             spec.include_functions.end())
+        , exclude_functions_(spec.exclude_functions.begin(),
+                             spec.exclude_functions.end())
+        , include_env_types_(spec.include_env_types.begin(),
+                             spec.include_env_types.end())
+        , exclude_env_types_(spec.exclude_env_types.begin(),
+                             spec.exclude_env_types.end())
+        , included_depth_(0)
+        , excluded_depth_(0)
+        , sampler_(sampling) {
+        has_include_ =
+            !include_namespaces_.empty() || !include_functions_.empty();
+        filters_closures_ = has_include_ || !exclude_namespaces_.empty() ||
+                            !exclude_functions_.empty();
+        filters_env_types_ =
+            !include_env_types_.empty() || !exclude_env_types_.empty();
+    }
+
+    /* true if events are currently not traced */
+    bool is_muted() const {
+        return is_filtered_() || sampler_.is_muted();
+    }
+
+    /* sampling weight of the events currently traced */
+    double get_sample_weight() const {
+        return sampler_.get_weight();
+    }
+
+    const CallSampler& get_sampler() const {
+        return sampler_;
+    }
+
+    /* called on closure entry, returns true if the call is traced */
+    bool enter_closure(instrumentr_closure_t closure) {
+        bool sampled = sampler_.enter_closure(closure);
+
+        if (!filters_closures_) {
+            return sampled;
+        }
+
+        frame_t frame = FRAME_NEUTRAL;
+
+        if (excluded_depth_ == 0) {
+            frame = classify_(closure);
+        }
+
+        frames_.push_back(frame);
+
+        if (frame == FRAME_INCLUDED) {
+            ++included_depth_;
+        } else if (frame == FRAME_EXCLUDED) {
+            ++excluded_depth_;
+        }
+
+        return sampled && !is_filtered_();
+    }
+
+    /* called on closure exit, returns true if the matching entry was
+       traced */
+    bool exit_closure() {
+        bool sampled = sampler_.exit_closure();
+
+        if (!filters_closures_) {
+            return sampled;
+        }
+
+        bool traced = sampled && !is_filtered_();
+
+        if (frames_.empty()) {
+            return traced;
+        }
+
+        frame_t frame = frames_.back();
+        frames_.pop_back();
+
+        if (frame == FRAME_INCLUDED) {
+            --included_depth_;
+        } else if (frame == FRAME_EXCLUDED) {
+            --excluded_depth_;
+        }
+
+        return traced;
+    }
+
+    /* true if variable events in environment are traced */
+    bool is_traced(instrumentr_environment_t environment) {
+        if (is_muted()) {
+            return false;
+        }
+
+        if (!filters_env_types_) {
+            return true;
+        }
+
+        int type = instrumentr_environment_get_type(environment);
+
+        if (type >= static_cast<int>(env_types_.size())) {
+            env_types_.resize(type + 1, ENV_TYPE_UNRESOLVED);
+        }
+
+        if (env_types_[type] == ENV_TYPE_UNRESOLVED) {
+            env_types_[type] = resolve_env_type_(
+                static_cast<instrumentr_environment_type_t>(type));
+        }
+
+        return env_types_[type] == ENV_TYPE_TRACED;
+    }
+
+  private:
+    enum frame_t { FRAME_NEUTRAL = 0, FRAME_INCLUDED, FRAME_EXCLUDED };
+
+    enum env_type_state_t {
+        ENV_TYPE_UNRESOLVED = 0,
+        ENV_TYPE_TRACED,
+        ENV_TYPE_FILTERED
+    };
+
+    bool is_filtered_() const {
+        return excluded_depth_ > 0 || (has_include_ && included_depth_ == 0);
+    }
+
+    frame_t classify_(instrumentr_closure_t closure) {
+        int id = instrumentr_closure_get_id(closure);
+
+        if (!resolved_.contains(id)) {
+            resolve_(id, closure);
+        }
+
+        if (excluded_.contains(id)) {
+            return FRAME_EXCLUDED;
+        }
+
+        if (included_.contains(id)) {
+            return FRAME_INCLUDED;
+        }
+
+        return FRAME_NEUTRAL;
+    }
+
+    void resolve_(int id, instrumentr_closure_t closure) {
+        resolved_.insert(id);
+
+        const char* name = instrumentr_closure_get_name(closure);
+        const char* ns = instrumentr_environment_get_name(
+            instrumentr_closure_get_environment(closure));
+
+        if (matches_(exclude_functions_, name) ||
+            matches_(exclude_namespaces_, ns)) {
+            excluded_.insert(id);
+        }
+
+        else if (matches_(include_functions_, name) ||
+                 matches_(include_namespaces_, ns)) {
+            included_.insert(id);
+        }
+    }
+
+    env_type_state_t resolve_env_type_(instrumentr_environment_type_t type) {
+        const char* name = instrumentr_environment_type_to_string(type);
+
+        if (matches_(exclude_env_types_, name)) {
+            return ENV_TYPE_FILTERED;
+        }
+
+        if (!include_env_types_.empty() &&
+            !matches_(include_env_types_, name)) {
+            return ENV_TYPE_FILTERED;
+        }
+
+        return ENV_TYPE_TRACED;
+    }
+
+    static bool matches_(const std::unordered_set<std::string>& names,
+                         const char* name) {
+        return name != NULL && !names.empty() && names.count(name) != 0;
+    }
+
+    std::unordered_set<std::string> include_namespaces_;
+    std::unordered_set<std::string> exclude_namespaces_;
+    std::unordered_set<std::string> include_functions_;
+    std::unordered_set<std::string> exclude_functions_;
+    std::unordered_set<std::string> include_env_types_;
+    std::unordered_set<std::string> exclude_env_types_;
+    bool has_include_;
+    bool filters_closures_;
+    bool filters_env_types_;
+    IdBitset resolved_;
+    IdBitset included_;
+    IdBitset excluded_;
+    std::vector<frame_t> frames_;
+    int included_depth_;
+    int excluded_depth_;
+    std::vector<env_type_state_t> env_types_;
+    CallSampler sampler_;
+};
+
+#endif /* ENVTRACER_TRACE_FILTER_H */
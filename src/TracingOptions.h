@@ -0,0 +1,275 @@
+#ifndef ENVTRACER_TRACING_OPTIONS_H
+#define ENVTRACER_TRACING_OPTIONS_H
+
+#include "utilities.h"
+#include "AnalysisProfile.h"
+#include "TraceFilter.h"
+#include <string>
+#include <vector>
+
+/* Options passed from R to a tracer, see trace_expr. */
+class TracingOptions {
+  public:
+    TracingOptions()
+        : output_dir_("")
+        , chunk_size_(65536)
+        , event_seq_cap_(0)
+        , events_(ANALYSIS_EVENT_ALL)
+        , self_profiling_(false)
+        , analysis_threaded_(false) {
+    }
+
+    /* tables are streamed to output_dir_ instead of being returned as data
+       frames when an output directory is given. */
+    bool is_streaming() const {
+        return !output_dir_.empty();
+    }
+
+    const std::string& get_output_dir() const {
+        return output_dir_;
+    }
+
+    int get_chunk_size() const {
+        return chunk_size_;
+    }
+
+    /* maximum number of events kept in the event_seq of an environment,
+       0 if unbounded */
+    int get_event_seq_cap() const {
+        return event_seq_cap_;
+    }
+
+    /* true if callbacks for event are registered */
+    bool has_event(analysis_event_t event) const {
+        return (events_ & event) != 0;
+    }
+
+    const TraceFilterSpec& get_filter() const {
+        return filter_;
+    }
+
+    /* true if the tracer profiles its own callbacks */
+    bool is_self_profiling() const {
+        return self_profiling_;
+    }
+
+    /* true if event tables are updated on a background thread */
+    bool is_analysis_threaded() const {
+        return analysis_threaded_;
+    }
+
+    const SamplingSpec& get_sampling() const {
+        return sampling_;
+    }
+
+    /* directory of the namespace catalog, empty if it is not used */
+    const std::string& get_catalog_dir() const {
+        return catalog_dir_;
+    }
+
+    /* analyzer executable that writes the streamed tables out of process,
+       empty if they are written by the traced process */
+    const std::string& get_analyzer() const {
+        return analyzer_;
+    }
+
+    /* raw events are logged to the record path if it is not empty */
+    bool is_recording() const {
+        return !record_path_.empty();
+    }
+
+    const std::string& get_record_path() const {
+        return record_path_;
+    }
+
+    static TracingOptions from_sexp(SEXP r_options) {
+        TracingOptions options;
+
+        SEXP r_output = get_list_element(r_options, "output");
+        if (r_output != R_NilValue) {
+            options.output_dir_ = CHAR(STRING_ELT(r_output, 0));
+        }
+
+        SEXP r_chunk_size = get_list_element(r_options, "chunk_size");
+        if (r_chunk_size != R_NilValue) {
+            options.chunk_size_ = asInteger(r_chunk_size);
+            if (options.chunk_size_ == NA_INTEGER || options.chunk_size_ < 1) {
+                Rf_error("chunk_size should be a positive integer");
+            }
+        }
+
+        SEXP r_event_seq_cap = get_list_element(r_options, "event_seq_cap");
+        if (r_event_seq_cap != R_NilValue) {
+            options.event_seq_cap_ = asInteger(r_event_seq_cap);
+            if (options.event_seq_cap_ == NA_INTEGER ||
+                options.event_seq_cap_ < 0) {
+                Rf_error("event_seq_cap should be a non-negative integer");
+            }
+        }
+
+        SEXP r_profile = get_list_element(r_options, "profile");
+        if (r_profile != R_NilValue) {
+            if (TYPEOF(r_profile) != STRSXP || Rf_length(r_profile) != 1) {
+                Rf_error("profile should be a single string");
+            }
+            const char* profile = CHAR(STRING_ELT(r_profile, 0));
+            options.events_ = get_analysis_profile(profile);
+            if (options.events_ == 0) {
+                Rf_error("unknown analysis profile '%s'", profile);
+            }
+        }
+
+        /* a custom event set replaces the events of the profile */
+        SEXP r_events = get_list_element(r_options, "events");
+        if (r_events != R_NilValue) {
+            options.events_ = 0;
+            for (const std::string& name: get_strings_(r_options, "events")) {
+                int event = get_analysis_event(name.c_str());
+                if (event == 0) {
+                    Rf_error("unknown analysis event '%s'", name.c_str());
+                }
+                options.events_ |= event;
+            }
+        }
+
+        SEXP r_filter = get_list_element(r_options, "filter");
+        if (r_filter != R_NilValue) {
+            TraceFilterSpec& filter = options.filter_;
+            filter.include_namespaces =
+                get_strings_(r_filter, "include_namespaces");
+            filter.exclude_namespaces =
+                get_strings_(r_filter, "exclude_namespaces");
+            filter.include_functions =
+                get_strings_(r_filter, "include_functions");
+            filter.exclude_functions =
+                get_strings_(r_filter, "exclude_functions");
+            filter.include_env_types =
+                get_strings_(r_filter, "include_env_types");
+            filter.exclude_env_types =
+                get_strings_(r_filter, "exclude_env_types");
+        }
+
+        SEXP r_sampling = get_list_element(r_options, "sampling");
+        if (r_sampling != R_NilValue) {
+            options.sampling_ = get_sampling_(r_sampling);
+        }
+
+        SEXP r_self_profile = get_list_element(r_options, "self_profile");
+        if (r_self_profile != R_NilValue) {
+            options.self_profiling_ = asLogical(r_self_profile) == TRUE;
+        }
+
+        SEXP r_analysis_thread =
+            get_list_element(r_options, "analysis_thread");
+        if (r_analysis_thread != R_NilValue) {
+            options.analysis_threaded_ = asLogical(r_analysis_thread) == TRUE;
+        }
+
+        SEXP r_catalog = get_list_element(r_options, "catalog");
+        if (r_catalog != R_NilValue) {
+            options.catalog_dir_ = CHAR(STRING_ELT(r_catalog, 0));
+        }
+
+        SEXP r_analyzer = get_list_element(r_options, "analyzer");
+        if (r_analyzer != R_NilValue) {
+            options.analyzer_ = CHAR(STRING_ELT(r_analyzer, 0));
+        }
+
+        SEXP r_record = get_list_element(r_options, "record");
+        if (r_record != R_NilValue) {
+            options.record_path_ = CHAR(STRING_ELT(r_record, 0));
+        }
+
+        return options;
+    }
+
+  private:
+    static SamplingSpec get_sampling_(SEXP r_sampling) {
+        SamplingSpec sampling;
+
+        SEXP r_rate = get_list_element(r_sampling, "rate");
+        if (r_rate != R_NilValue) {
+            sampling.rate = asInteger(r_rate);
+            if (sampling.rate == NA_INTEGER || sampling.rate < 1) {
+                Rf_error("rate should be a positive integer");
+            }
+        }
+
+        SEXP r_window = get_list_element(r_sampling, "window");
+        SEXP r_period = get_list_element(r_sampling, "period");
+        if (r_window != R_NilValue || r_period != R_NilValue) {
+            if (r_window == R_NilValue || r_period == R_NilValue) {
+                Rf_error("window and period should be given together");
+            }
+            sampling.window = asReal(r_window);
+            sampling.period = asReal(r_period);
+            if (!(sampling.window > 0) || !(sampling.period > 0)) {
+                Rf_error("window and period should be positive");
+            }
+            if (!(sampling.period > sampling.window)) {
+                Rf_error("period should be larger than window");
+            }
+        }
+
+        SEXP r_function_rates = get_list_element(r_sampling, "function_rates");
+        if (r_function_rates != R_NilValue) {
+            SEXP r_names = getAttrib(r_function_rates, R_NamesSymbol);
+            if (TYPEOF(r_function_rates) != INTSXP ||
+                (r_names == R_NilValue && Rf_length(r_function_rates) != 0)) {
+                Rf_error("function_rates should be a named integer vector");
+            }
+            for (int i = 0; i < Rf_length(r_function_rates); ++i) {
+                int rate = INTEGER_ELT(r_function_rates, i);
+                if (rate == NA_INTEGER || rate < 1) {
+                    Rf_error("function_rates should be positive integers");
+                }
+                sampling.function_rates[CHAR(STRING_ELT(r_names, i))] = rate;
+            }
+        }
+
+        SEXP r_seed = get_list_element(r_sampling, "seed");
+        if (r_seed != R_NilValue) {
+            sampling.seed = static_cast<std::uint64_t>(asReal(r_seed));
+        }
+
+        return sampling;
+    }
+
+    static std::vector<std::string> get_strings_(SEXP r_list,
+                                                 const char* name) {
+        std::vector<std::string> strings;
+
+        SEXP r_strings = get_list_element(r_list, name);
+
+        if (r_strings == R_NilValue) {
+            return strings;
+        }
+
+        if (TYPEOF(r_strings) != STRSXP) {
+            Rf_error("%s should be a character vector", name);
+        }
+
+        for (int i = 0; i < Rf_length(r_strings); ++i) {
+            SEXP r_string = STRING_ELT(r_strings, i);
+            if (r_string != NA_STRING) {
+                strings.push_back(CHAR(r_string));
+            }
+        }
+
+        return strings;
+    }
+
+    std::string output_dir_;
+    int chunk_size_;
+    int event_seq_cap_;
+    int events_;
+    TraceFilterSpec filter_;
+    SamplingSpec sampling_;
+    bool self_profiling_;
+    bool analysis_threaded_;
+    std::string catalog_dir_;
+    std::string analyzer_;
+    std::string record_path_;
+};
+
+#endif /* ENVTRACER_TRACING_OPTIONS_H */
@@ -1,4 +1,8 @@
 #include "TracingState.h"
+#include "columnar.h"
+#include "CallbackProfiler.h"
+#include "EventRecorder.h"
+#include "ShardManifest.h"
 
 void tracing_state_destroy(SEXP r_tracing_state) {
     void* pointer = instrumentr_r_externalptr_to_c_pointer(r_tracing_state);
@@ -11,52 +15,312 @@ void tracing_state_destroy(SEXP r_tracing_state) {
     }
 }
 
-void TracingState::initialize(instrumentr_state_t state) {
-    TracingState* tracing_state = new TracingState();
+instrumentr_state_t TracingState::bound_state_ = nullptr;
+TracingState* TracingState::bound_tracing_state_ = nullptr;
+
+void TracingState::bind_(instrumentr_state_t state,
+                         TracingState* tracing_state) {
+    bound_state_ = state;
+    bound_tracing_state_ = tracing_state;
+}
+
+void TracingState::initialize(instrumentr_state_t state,
+                              const TracingOptions& options) {
+    TracingState* tracing_state = new TracingState(options);
+
+    if (options.is_self_profiling()) {
+        CallbackProfiler::enable();
+    }
+
+    if (options.is_streaming()) {
+        try {
+            tracing_state->enable_streaming_();
+        } catch (const std::exception& e) {
+            delete tracing_state;
+            Rf_error("%s", e.what());
+        }
+    }
+
+    if (options.is_recording()) {
+        try {
+            EventRecorder::open(options.get_record_path());
+        } catch (const std::exception& e) {
+            delete tracing_state;
+            Rf_error("%s", e.what());
+        }
+    }
 
     SEXP r_tracing_state = PROTECT(instrumentr_c_pointer_to_r_externalptr(
         tracing_state, R_NilValue, R_NilValue, tracing_state_destroy));
 
     instrumentr_state_insert(state, "tracing_state", r_tracing_state, true);
     UNPROTECT(1);
+
+    bind_(state, tracing_state);
 }
 
 void TracingState::finalize(instrumentr_state_t state) {
     TracingState& tracing_state = TracingState::lookup(state);
+
+    /* the tracing state is destroyed when it is erased below */
+    bind_(nullptr, nullptr);
+
+    bool profiling = tracing_state.options_.is_self_profiling();
+
+    /* the remaining work of the exit callback is not profiled */
+    SEXP r_profile = PROTECT(profiling ? CallbackProfiler::to_sexp()
+                                       : R_NilValue);
+    CallbackProfiler::disable();
+
+    if (tracing_state.options_.is_streaming()) {
+        std::string message;
+
+        try {
+            EventRecorder::close();
+            tracing_state.stop_worker_();
+            tracing_state.finalize_streaming_();
+            if (profiling) {
+                write_data_frame(
+                    tracing_state.options_.get_output_dir() + "/profile.tbl",
+                    r_profile);
+            }
+        } catch (const std::exception& e) {
+            message = e.what();
+        }
+
+        instrumentr_state_erase(state, "tracing_state", true);
+        UNPROTECT(1);
+
+        if (!message.empty()) {
+            Rf_error("%s", message.c_str());
+        }
+
+        return;
+    }
+
+    std::string message;
+
+    try {
+        EventRecorder::close();
+        tracing_state.stop_worker_();
+    } catch (const std::exception& e) {
+        message = e.what();
+    }
+
+    if (!message.empty()) {
+        instrumentr_state_erase(state, "tracing_state", true);
+        UNPROTECT(1);
+        Rf_error("%s", message.c_str());
+    }
+
     SEXP r_calls = PROTECT(tracing_state.get_call_table().to_sexp());
+    SEXP r_call_sites =
+        PROTECT(tracing_state.get_call_table().get_call_sites().to_sexp());
     SEXP r_arguments = PROTECT(tracing_state.get_argument_table().to_sexp());
     SEXP r_functions = PROTECT(tracing_state.get_function_table().to_sexp());
     SEXP r_environments =
         PROTECT(tracing_state.get_environment_table().to_sexp());
-    SEXP r_metaprogramming =
-        PROTECT(tracing_state.get_metaprogramming_table().to_sexp());
-    SEXP r_effects = PROTECT(tracing_state.get_effects_table().to_sexp());
+    /* tables of event groups that were not traced are not exported */
+    SEXP r_metaprogramming = PROTECT(
+        tracing_state.has_metaprogramming_table()
+            ? tracing_state.get_metaprogramming_table().to_sexp()
+            : R_NilValue);
+    SEXP r_effects = PROTECT(tracing_state.has_effects_table()
+                                 ? tracing_state.get_effects_table().to_sexp()
+                                 : R_NilValue);
     SEXP r_arg_ref = PROTECT(tracing_state.get_arg_ref_tab().to_sexp());
     SEXP r_call_ref = PROTECT(tracing_state.get_call_ref_tab().to_sexp());
     SEXP r_env_access = PROTECT(tracing_state.get_environment_access_table().to_sexp());
     SEXP r_env_cons = PROTECT(tracing_state.get_environment_constructor_table().to_sexp());
-    SEXP r_evals = PROTECT(tracing_state.get_eval_table().to_sexp());
+    SEXP r_evals = PROTECT(tracing_state.has_eval_table()
+                               ? tracing_state.get_eval_table().to_sexp()
+                               : R_NilValue);
+    SEXP r_backtraces = PROTECT(tracing_state.get_backtrace().to_sexp());
+    SEXP r_allocations = PROTECT(tracing_state.get_allocations());
 
     instrumentr_state_erase(state, "tracing_state", true);
     instrumentr_state_insert(state, "calls", r_calls, true);
+    instrumentr_state_insert(state, "call_sites", r_call_sites, true);
     instrumentr_state_insert(state, "arguments", r_arguments, true);
     instrumentr_state_insert(state, "functions", r_functions, true);
     instrumentr_state_insert(state, "environments", r_environments, true);
-    instrumentr_state_insert(state, "metaprogramming", r_metaprogramming, true);
-    instrumentr_state_insert(state, "effects", r_effects, true);
+    if (r_metaprogramming != R_NilValue) {
+        instrumentr_state_insert(
+            state, "metaprogramming", r_metaprogramming, true);
+    }
+    if (r_effects != R_NilValue) {
+        instrumentr_state_insert(state, "effects", r_effects, true);
+    }
     instrumentr_state_insert(state, "arg_ref", r_arg_ref, true);
     instrumentr_state_insert(state, "call_ref", r_call_ref, true);
     instrumentr_state_insert(state, "env_access", r_env_access, true);
     instrumentr_state_insert(state, "env_cons", r_env_cons, true);
-    instrumentr_state_insert(state, "evals", r_evals, true);
+    if (r_evals != R_NilValue) {
+        instrumentr_state_insert(state, "evals", r_evals, true);
+    }
+    instrumentr_state_insert(state, "backtraces", r_backtraces, true);
+    instrumentr_state_insert(state, "allocations", r_allocations, true);
+    if (profiling) {
+        instrumentr_state_insert(state, "profile", r_profile, true);
+    }
 
-    UNPROTECT(11);
+    UNPROTECT(15);
 }
 
-TracingState& TracingState::lookup(instrumentr_state_t state) {
+SEXP TracingState::get_allocations() const {
+    std::vector<std::string> tables({"calls",
+                                     "environments",
+                                     "arguments",
+                                     "functions",
+                                     "env_access",
+                                     "env_cons"});
+
+    std::vector<const ArenaCounter*> counters(
+        {&call_table_.get_allocations(),
+         &environment_table_.get_allocations(),
+         &argument_table_.get_allocations(),
+         &function_table_.get_allocations(),
+         &env_access_table_.get_allocations(),
+         &env_constructor_table_.get_allocations()});
+
+    if (effects_table_) {
+        tables.push_back("effects");
+        counters.push_back(&effects_table_->get_allocations());
+    }
+
+    if (eval_table_) {
+        tables.push_back("evals");
+        counters.push_back(&eval_table_->get_allocations());
+    }
+
+    int size = tables.size();
+
+    SEXP r_table = PROTECT(allocVector(STRSXP, size));
+    SEXP r_objects = PROTECT(allocVector(REALSXP, size));
+    SEXP r_bytes = PROTECT(allocVector(REALSXP, size));
+
+    for (int index = 0; index < size; ++index) {
+        SET_STRING_ELT(r_table, index, make_char(tables[index]));
+        SET_REAL_ELT(r_objects, index, counters[index]->objects);
+        SET_REAL_ELT(r_bytes, index, counters[index]->bytes);
+    }
+
+    std::vector<SEXP> columns({r_table, r_objects, r_bytes});
+
+    std::vector<std::string> names({"table", "objects", "bytes"});
+
+    SEXP df = create_data_frame(names, columns);
+
+    UNPROTECT(3);
+
+    return df;
+}
+
+TracingState& TracingState::lookup_slow_(instrumentr_state_t state) {
     SEXP r_tracing_state =
         instrumentr_state_lookup(state, "tracing_state", R_NilValue);
     TracingState* tracing_state = static_cast<TracingState*>(
         instrumentr_r_externalptr_to_c_pointer(r_tracing_state));
     return *tracing_state;
 }
+
+void TracingState::stop_worker_() {
+    if (worker_) {
+        worker_->stop();
+    }
+}
+
+void TracingState::enable_streaming_() {
+    const std::string& dir = options_.get_output_dir();
+    int chunk_size = options_.get_chunk_size();
+
+    if (options_.get_analyzer().empty()) {
+        writer_.reset(new StreamWriter());
+    } else {
+        static int channel_count = 0;
+        std::string name = "/envtracer-" + std::to_string(getpid()) + "-" +
+                           std::to_string(channel_count++);
+        channel_.reset(
+            EventChannel::create(name, ENVTRACER_CHANNEL_CAPACITY));
+        channel_->spawn_consumer({options_.get_analyzer(),
+                                  name,
+                                  std::to_string(chunk_size)});
+        writer_.reset(new StreamWriter(*channel_));
+    }
+
+    call_table_.enable_streaming(*writer_, dir + "/calls.tbl", chunk_size);
+    arg_ref_tab_.enable_streaming(*writer_, dir + "/arg_ref.tbl", chunk_size);
+    call_ref_tab_.enable_streaming(
+        *writer_, dir + "/call_ref.tbl", chunk_size);
+    env_access_table_.enable_streaming(
+        *writer_, dir + "/env_access.tbl", chunk_size);
+    env_constructor_table_.enable_streaming(
+        *writer_, dir + "/env_cons.tbl", chunk_size);
+    if (eval_table_) {
+        eval_table_->enable_streaming(
+            *writer_, dir + "/evals.tbl", chunk_size);
+    }
+    if (effects_table_) {
+        effects_table_->enable_streaming(
+            *writer_, dir + "/effects.tbl", chunk_size);
+    }
+    backtrace_.enable_streaming(*writer_, dir + "/backtraces.tbl", chunk_size);
+}
+
+/* event tables and the rows of exited calls have already been streamed to
+   disk, only their last chunks are pending. the other entity tables are
+   updated until the end of tracing and are written out in the same format
+   once. */
+void TracingState::finalize_streaming_() {
+    const std::string& dir = options_.get_output_dir();
+
+    call_table_.close_stream();
+    arg_ref_tab_.close_stream();
+    call_ref_tab_.close_stream();
+    env_access_table_.close_stream();
+    env_constructor_table_.close_stream();
+    if (eval_table_) {
+        eval_table_->close_stream();
+    }
+    if (effects_table_) {
+        effects_table_->close_stream();
+    }
+    backtrace_.close_stream();
+
+    write_data_frame(dir + "/call_sites.tbl",
+                     PROTECT(call_table_.get_call_sites().to_sexp()));
+    UNPROTECT(1);
+
+    write_data_frame(dir + "/arguments.tbl",
+                     PROTECT(argument_table_.to_sexp()));
+    UNPROTECT(1);
+
+    write_data_frame(dir + "/functions.tbl",
+                     PROTECT(function_table_.to_sexp()));
+    UNPROTECT(1);
+
+    write_data_frame(dir + "/environments.tbl",
+                     PROTECT(environment_table_.to_sexp()));
+    UNPROTECT(1);
+
+    if (metaprogramming_table_) {
+        write_data_frame(dir + "/metaprogramming.tbl",
+                         PROTECT(metaprogramming_table_->to_sexp()));
+        UNPROTECT(1);
+    }
+
+    write_data_frame(dir + "/allocations.tbl", PROTECT(get_allocations()));
+    UNPROTECT(1);
+
+    writer_->stop();
+
+    /* the streamed tables are complete once the analyzer has exited */
+    if (channel_) {
+        channel_->finish();
+    }
+
+    /* the output directory is a shard that can be merged with others */
+    ShardManifest manifest;
+    manifest.add_directory(dir);
+    manifest.write(dir + "/" + ENVTRACER_SHARD_MANIFEST);
+}
@@ -2,6 +2,8 @@
 #define ENVTRACER_TRACING_STATE_H
 
 #include "Rincludes.h"
+#include "Arena.h"
+#include "AnalysisWorker.h"
 #include "CallTable.h"
 #include "EnvironmentTable.h"
 #include "ArgumentTable.h"
@@ -11,14 +13,83 @@
 #include "ArgumentReflectionTable.h"
 #include "CallReflectionTable.h"
 #include "Backtrace.h"
+#include "BuiltinDispatchTable.h"
+#include "CallerStack.h"
+#include "ReflectiveFunctionTable.h"
 #include "EnvironmentAccessTable.h"
 #include "EnvironmentConstructorTable.h"
 #include "EvalTable.h"
+#include "EvalScopeStack.h"
+#include "EventChannel.h"
+#include "NamespaceCatalog.h"
+#include "TableStream.h"
+#include "TraceFilter.h"
+#include "TracingOptions.h"
 #include <instrumentr/instrumentr.h>
+#include <memory>
 
 class TracingState {
   public:
-    TracingState() {
+    explicit TracingState(const TracingOptions& options)
+        : options_(options)
+        , call_table_(arena_)
+        , argument_table_(arena_)
+        , function_table_(arena_)
+        , env_access_table_(arena_)
+        , env_constructor_table_(arena_)
+        , trace_filter_(options.get_filter(), options.get_sampling())
+        , namespace_catalog_(options.get_catalog_dir()) {
+        environment_table_.set_event_seq_cap(options.get_event_seq_cap());
+
+        /* tables only filled by the callbacks of an event group exist
+           only if the group is traced */
+        if (options.has_event(ANALYSIS_EVENT_PROMISE)) {
+            metaprogramming_table_.reset(new MetaprogrammingTable());
+        }
+        if (options.has_event(ANALYSIS_EVENT_VARIABLE) ||
+            options.has_event(ANALYSIS_EVENT_ERROR)) {
+            effects_table_.reset(new EffectsTable(arena_));
+        }
+        if (options.has_event(ANALYSIS_EVENT_EVAL)) {
+            eval_table_.reset(new EvalTable(arena_));
+        }
+
+        /* event records carry the sampling weight of their call */
+        const CallSampler* sampler = &trace_filter_.get_sampler();
+        env_access_table_.set_sampler(sampler);
+        env_constructor_table_.set_sampler(sampler);
+        if (metaprogramming_table_) {
+            metaprogramming_table_->set_sampler(sampler);
+        }
+        if (effects_table_) {
+            effects_table_->set_sampler(sampler);
+        }
+        if (eval_table_) {
+            eval_table_->set_sampler(sampler);
+        }
+
+        if (options.is_analysis_threaded()) {
+            worker_.reset(new AnalysisWorker());
+            env_access_table_.set_worker(worker_.get());
+            env_constructor_table_.set_worker(worker_.get());
+            if (effects_table_) {
+                effects_table_->set_worker(worker_.get());
+            }
+            if (eval_table_) {
+                eval_table_->set_worker(worker_.get());
+            }
+        }
+    }
+
+    Arena& get_arena() {
+        return arena_;
+    }
+
+    /* number of records and bytes allocated by each table */
+    SEXP get_allocations() const;
+
+    const TracingOptions& get_options() const {
+        return options_;
     }
 
     CallTable& get_call_table() {
@@ -53,20 +124,34 @@ class TracingState {
         return function_table_;
     }
 
+    /* the metaprogramming, effects and eval tables only exist if their
+       event groups are traced */
+    bool has_metaprogramming_table() const {
+        return metaprogramming_table_ != nullptr;
+    }
+
+    bool has_effects_table() const {
+        return effects_table_ != nullptr;
+    }
+
+    bool has_eval_table() const {
+        return eval_table_ != nullptr;
+    }
+
     MetaprogrammingTable& get_metaprogramming_table() {
-        return metaprogramming_table_;
+        return *metaprogramming_table_;
     }
 
     const MetaprogrammingTable& get_metaprogramming_table() const {
-        return metaprogramming_table_;
+        return *metaprogramming_table_;
     }
 
     EffectsTable& get_effects_table() {
-        return effects_table_;
+        return *effects_table_;
     }
 
     const EffectsTable& get_effects_table() const {
-        return effects_table_;
+        return *effects_table_;
     }
 
     ArgumentReflectionTable& get_arg_ref_tab() {
@@ -93,6 +178,22 @@ class TracingState {
         return backtrace_;
     }
 
+    BuiltinDispatchTable& get_builtin_dispatch_table() {
+        return builtin_dispatch_table_;
+    }
+
+    ReflectiveFunctionTable& get_reflective_function_table() {
+        return reflective_function_table_;
+    }
+
+    CallerStack& get_caller_stack() {
+        return caller_stack_;
+    }
+
+    const CallerStack& get_caller_stack() const {
+        return caller_stack_;
+    }
+
     EnvironmentAccessTable& get_environment_access_table() {
         return env_access_table_;
     }
@@ -111,32 +212,82 @@ class TracingState {
     }
 
     EvalTable& get_eval_table() {
-        return eval_table_;
+        return *eval_table_;
     }
 
     const EvalTable& get_eval_table() const {
-        return eval_table_;
+        return *eval_table_;
     }
 
-    static void initialize(instrumentr_state_t state);
+    TraceFilter& get_trace_filter() {
+        return trace_filter_;
+    }
+
+    EvalScopeStack& get_eval_scopes() {
+        return eval_scopes_;
+    }
+
+    const NamespaceCatalog& get_namespace_catalog() const {
+        return namespace_catalog_;
+    }
+
+    static void initialize(instrumentr_state_t state,
+                           const TracingOptions& options);
 
     static void finalize(instrumentr_state_t state);
 
-    static TracingState& lookup(instrumentr_state_t state);
+    /* The tracing state is bound to its instrumentr state when tracing
+       starts, so callbacks resolve it with a pointer comparison instead of
+       a string-keyed instrumentr_state_lookup. */
+    static TracingState& lookup(instrumentr_state_t state) {
+        if (state == bound_state_) {
+            return *bound_tracing_state_;
+        }
+        return lookup_slow_(state);
+    }
 
   private:
+    static TracingState& lookup_slow_(instrumentr_state_t state);
+
+    static void bind_(instrumentr_state_t state, TracingState* tracing_state);
+
+    static instrumentr_state_t bound_state_;
+    static TracingState* bound_tracing_state_;
+
+    void enable_streaming_();
+
+    void finalize_streaming_();
+
+    /* appends the records still queued for the analysis worker */
+    void stop_worker_();
+
+    TracingOptions options_;
+    /* declared before the tables so that they are destroyed first */
+    Arena arena_;
+    /* outlives the streams that send rows over it */
+    std::unique_ptr<EventChannel> channel_;
+    std::unique_ptr<StreamWriter> writer_;
     CallTable call_table_;
     EnvironmentTable environment_table_;
     ArgumentTable argument_table_;
     FunctionTable function_table_;
-    MetaprogrammingTable metaprogramming_table_;
-    EffectsTable effects_table_;
+    std::unique_ptr<MetaprogrammingTable> metaprogramming_table_;
+    std::unique_ptr<EffectsTable> effects_table_;
     ArgumentReflectionTable arg_ref_tab_;
     CallReflectionTable call_ref_tab_;
     Backtrace backtrace_;
+    BuiltinDispatchTable builtin_dispatch_table_;
+    ReflectiveFunctionTable reflective_function_table_;
+    CallerStack caller_stack_;
     EnvironmentAccessTable env_access_table_;
     EnvironmentConstructorTable env_constructor_table_;
-    EvalTable eval_table_;
+    std::unique_ptr<EvalTable> eval_table_;
+    EvalScopeStack eval_scopes_;
+    TraceFilter trace_filter_;
+    NamespaceCatalog namespace_catalog_;
+    /* declared after the tables so that it is stopped before they are
+       destroyed */
+    std::unique_ptr<AnalysisWorker> worker_;
 };
 
 #endif /* ENVTRACER_TRACING_STATE_H */
@@ -0,0 +1,167 @@
+/* Analyzer process for trace_expr(analyzer = TRUE).
+
+   Reads table events from the shared memory channel created by the traced
+   process and writes them out as table files, so that the traced process
+   neither buffers chunks nor writes to disk.
+
+   usage: envtracer-analyzer <channel> <chunk size> */
+
+#include "../EventChannel.h"
+#include "../TableStream.h"
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+
+const std::string ENVTRACER_NA_STRING("***ENVTRACER_NA_STRING***");
+
+class PayloadReader {
+  public:
+    explicit PayloadReader(const std::string& payload)
+        : payload_(payload), offset_(0) {
+    }
+
+    template <typename T>
+    T read() {
+        T value;
+        check_(sizeof(T));
+        std::memcpy(&value, payload_.data() + offset_, sizeof(T));
+        offset_ += sizeof(T);
+        return value;
+    }
+
+    std::string read_string(std::size_t size) {
+        check_(size);
+        std::string value = payload_.substr(offset_, size);
+        offset_ += size;
+        return value;
+    }
+
+  private:
+    void check_(std::size_t size) {
+        if (offset_ + size > payload_.size()) {
+            throw std::runtime_error("truncated event");
+        }
+    }
+
+    const std::string& payload_;
+    std::size_t offset_;
+};
+
+struct AnalyzerTable {
+    TableSchema schema;
+    std::unique_ptr<TableStream> stream;
+};
+
+static void open_table(StreamWriter& writer,
+                       int chunk_size,
+                       const std::string& payload,
+                       AnalyzerTable& table) {
+    PayloadReader reader(payload);
+
+    std::string filepath = reader.read_string(reader.read<std::uint32_t>());
+    std::uint32_t column_count = reader.read<std::uint32_t>();
+
+    for (std::uint32_t column = 0; column < column_count; ++column) {
+        std::uint8_t type = reader.read<std::uint8_t>();
+        table.schema.types.push_back(static_cast<ColumnType>(type));
+        table.schema.names.push_back(
+            reader.read_string(reader.read<std::uint32_t>()));
+    }
+
+    table.stream.reset(
+        new TableStream(writer, filepath, table.schema, chunk_size));
+}
+
+static void append_row(const std::string& payload, AnalyzerTable& table) {
+    PayloadReader reader(payload);
+    TableStream& stream = *table.stream;
+
+    for (ColumnType type: table.schema.types) {
+        if (type == ColumnType::Double) {
+            stream.put_double(reader.read<double>());
+        } else if (type == ColumnType::String) {
+            std::int32_t size = reader.read<std::int32_t>();
+            if (size == -1) {
+                stream.put_na_string();
+            } else {
+                stream.put_string(reader.read_string(size));
+            }
+        } else {
+            stream.put_int(reader.read<std::int32_t>());
+        }
+    }
+
+    stream.end_row();
+}
+
+static void analyze(const std::string& name, int chunk_size) {
+    std::unique_ptr<EventChannel> channel(EventChannel::attach(name));
+    StreamWriter writer;
+    std::vector<AnalyzerTable> tables;
+
+    while (true) {
+        ChannelMessageHeader header;
+        const std::string& payload = channel->receive(header);
+
+        ChannelMessageKind kind = static_cast<ChannelMessageKind>(header.kind);
+
+        if (kind == ChannelMessageKind::End) {
+            break;
+        }
+
+        if (kind == ChannelMessageKind::Open) {
+            if (header.table >= tables.size()) {
+                tables.resize(header.table + 1);
+            }
+            open_table(writer, chunk_size, payload, tables[header.table]);
+            continue;
+        }
+
+        if (header.table >= tables.size() || !tables[header.table].stream) {
+            throw std::runtime_error("event for unknown table " +
+                                     std::to_string(header.table));
+        }
+
+        AnalyzerTable& table = tables[header.table];
+
+        if (kind == ChannelMessageKind::Row) {
+            append_row(payload, table);
+        } else if (kind == ChannelMessageKind::Close) {
+            table.stream->close();
+        } else {
+            throw std::runtime_error("unknown event kind " +
+                                     std::to_string(header.kind));
+        }
+    }
+
+    for (AnalyzerTable& table: tables) {
+        if (table.stream) {
+            table.stream->close();
+        }
+    }
+
+    writer.stop();
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 3) {
+        std::fprintf(stderr, "usage: %s <channel> <chunk size>\n", argv[0]);
+        return 2;
+    }
+
+    int chunk_size = std::atoi(argv[2]);
+
+    if (chunk_size <= 0) {
+        std::fprintf(stderr, "%s: invalid chunk size '%s'\n", argv[0], argv[2]);
+        return 2;
+    }
+
+    try {
+        analyze(argv[1], chunk_size);
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "%s: %s\n", argv[0], e.what());
+        return 1;
+    }
+
+    return 0;
+}
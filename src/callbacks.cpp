@@ -3,6 +3,7 @@
 #include "TracingState.h"
 #include "utilities.h"
 #include <instrumentr/instrumentr.h>
+#include <unordered_set>
 #include <vector>
 
 int extract_logical(instrumentr_value_t value, int index = 0) {
@@ -73,17 +74,38 @@ instrumentr_value_t lookup_environment(instrumentr_state_t state,
     return val;
 }
 
-void analyze_package_environment(instrumentr_state_t state,
-                                 EnvironmentTable& env_table,
-                                 instrumentr_environment_t environment,
-                                 const std::string& name) {
+/* marks the environments nested in a package environment and records the
+   binding path of each one it reaches. Paths are recorded whether or not
+   an environment was already marked through another package, so that a
+   catalog entry does not depend on the order in which packages are
+   loaded. Other namespace and package environments are not entered and
+   visited holds the slots walked so far, which ends cycles. */
+static void walk_package_environment(instrumentr_state_t state,
+                                     EnvironmentTable& env_table,
+                                     instrumentr_environment_t environment,
+                                     const std::string& name,
+                                     BindingPath& path,
+                                     std::vector<BindingPath>& paths,
+                                     std::unordered_set<int>& visited) {
     Environment* env = env_table.insert(environment);
 
-    if (env->is_package()) {
+    if (!visited.insert(env->get_slot()).second) {
         return;
     }
 
-    env->set_package(name);
+    if (!path.empty()) {
+        instrumentr_environment_type_t type =
+            instrumentr_environment_get_type(environment);
+        if (type == INSTRUMENTR_ENVIRONMENT_TYPE_NAMESPACE ||
+            type == INSTRUMENTR_ENVIRONMENT_TYPE_PACKAGE) {
+            return;
+        }
+        paths.push_back(path);
+    }
+
+    if (!env->is_package()) {
+        env->set_package(name);
+    }
 
     SEXP r_names = PROTECT(
         R_lsInternal(instrumentr_environment_get_sexp(environment), TRUE));
@@ -98,15 +120,94 @@ void analyze_package_environment(instrumentr_state_t state,
         if (instrumentr_value_is_environment(value)) {
             const std::string new_name =
                 name + "::" + std::string(binding_name);
-            analyze_package_environment(state,
-                                        env_table,
-                                        instrumentr_value_as_environment(value),
-                                        new_name);
+            path.push_back(binding_name);
+            walk_package_environment(state,
+                                     env_table,
+                                     instrumentr_value_as_environment(value),
+                                     new_name,
+                                     path,
+                                     paths,
+                                     visited);
+            path.pop_back();
         }
     }
     UNPROTECT(1);
 }
 
+/* marks the environments found at the binding paths of a catalog entry
+   instead of listing every binding of the package. Paths that no longer
+   lead to an environment are skipped. */
+static void replay_package_environment(instrumentr_state_t state,
+                                       EnvironmentTable& env_table,
+                                       instrumentr_environment_t environment,
+                                       const std::string& name,
+                                       const std::vector<BindingPath>& paths) {
+    env_table.insert(environment)->set_package(name);
+
+    for (const BindingPath& path: paths) {
+        instrumentr_environment_t nested = environment;
+        std::string nested_name = name;
+
+        for (const std::string& binding_name: path) {
+            instrumentr_symbol_t binding_sym =
+                instrumentr_state_get_symbol(state, binding_name.c_str());
+            instrumentr_value_t value =
+                instrumentr_environment_lookup(nested, binding_sym);
+
+            if (!instrumentr_value_is_environment(value)) {
+                nested = NULL;
+                break;
+            }
+
+            nested = instrumentr_value_as_environment(value);
+            nested_name += "::" + binding_name;
+        }
+
+        if (nested == NULL) {
+            continue;
+        }
+
+        Environment* env = env_table.insert(nested);
+
+        if (!env->is_package()) {
+            env->set_package(nested_name);
+        }
+    }
+}
+
+void analyze_package_environment(instrumentr_state_t state,
+                                 EnvironmentTable& env_table,
+                                 const NamespaceCatalog& catalog,
+                                 instrumentr_environment_t environment,
+                                 const std::string& name) {
+    if (env_table.insert(environment)->is_package()) {
+        return;
+    }
+
+    std::string key;
+
+    if (catalog.is_enabled()) {
+        key = NamespaceCatalog::get_key(
+            instrumentr_environment_get_sexp(environment), name);
+    }
+
+    std::vector<BindingPath> paths;
+
+    if (!key.empty() && catalog.lookup(key, paths)) {
+        replay_package_environment(state, env_table, environment, name, paths);
+        return;
+    }
+
+    BindingPath path;
+    std::unordered_set<int> visited;
+    walk_package_environment(
+        state, env_table, environment, name, path, paths, visited);
+
+    if (!key.empty()) {
+        catalog.store(key, paths);
+    }
+}
+
 void package_load_callback(instrumentr_tracer_t tracer,
                            instrumentr_callback_t callback,
                            instrumentr_state_t state,
@@ -114,7 +215,9 @@ void package_load_callback(instrumentr_tracer_t tracer,
                            instrumentr_environment_t environment) {
     TracingState& tracing_state = TracingState::lookup(state);
     EnvironmentTable& env_table = tracing_state.get_environment_table();
-    analyze_package_environment(state, env_table, environment, "namespace");
+    const NamespaceCatalog& catalog = tracing_state.get_namespace_catalog();
+    analyze_package_environment(
+        state, env_table, catalog, environment, "namespace");
 }
 
 void package_attach_callback(instrumentr_tracer_t tracer,
@@ -124,7 +227,9 @@ void package_attach_callback(instrumentr_tracer_t tracer,
                              instrumentr_environment_t environment) {
     TracingState& tracing_state = TracingState::lookup(state);
     EnvironmentTable& env_table = tracing_state.get_environment_table();
-    analyze_package_environment(state, env_table, environment, "package");
+    const NamespaceCatalog& catalog = tracing_state.get_namespace_catalog();
+    analyze_package_environment(
+        state, env_table, catalog, environment, "package");
 }
 
 void mark_promises(int ref_call_id,
@@ -180,7 +285,7 @@ void mark_promises(int ref_call_id,
                            call_id,
                            arg_id,
                            formal_pos,
-                           backtrace.to_string());
+                           backtrace.get_node_id());
 
             if (!transitive) {
                 source_fun_id = arg->get_fun_id();
@@ -306,71 +411,8 @@ bool has_minus_one_argument(instrumentr_call_t call) {
     return valid;
 }
 
-instrumentr_call_t get_caller(instrumentr_call_stack_t call_stack, int& index) {
-    int env_id = NA_INTEGER;
-
-    for (; index < instrumentr_call_stack_get_size(call_stack); ++index) {
-        instrumentr_frame_t frame =
-            instrumentr_call_stack_peek_frame(call_stack, index);
-
-        if (instrumentr_frame_is_promise(frame) && env_id == NA_INTEGER) {
-            instrumentr_promise_t promise = instrumentr_frame_as_promise(frame);
-            instrumentr_value_t env =
-                instrumentr_promise_get_environment(promise);
-
-            if (instrumentr_value_is_environment(env)) {
-                env_id = instrumentr_value_get_id(env);
-            }
-        }
-
-        if (instrumentr_frame_is_call(frame)) {
-            instrumentr_call_t call = instrumentr_frame_as_call(frame);
-
-            instrumentr_value_t fun = instrumentr_call_get_function(call);
-
-            if (!instrumentr_value_is_closure(fun)) {
-                continue;
-            }
-
-            instrumentr_closure_t closure = instrumentr_value_as_closure(fun);
-
-            instrumentr_environment_t env =
-                instrumentr_call_get_environment(call);
-
-            int cur_env_id = instrumentr_environment_get_id(env);
-
-            if (env_id == NA_INTEGER || cur_env_id == env_id) {
-                return call;
-            }
-        }
-    }
-
-    return nullptr;
-}
-
-instrumentr_call_t get_caller_info(instrumentr_call_stack_t call_stack,
-                                   int& fun_id,
-                                   int& call_id,
-                                   std::string& fun_name,
-                                   int& index) {
-    instrumentr_call_t call = get_caller(call_stack, index);
-
-    fun_id = NA_INTEGER;
-    call_id = NA_INTEGER;
-    fun_name = ENVTRACER_NA_STRING;
-
-    if (call != nullptr) {
-        instrumentr_closure_t closure =
-            instrumentr_value_as_closure(instrumentr_call_get_function(call));
-        call_id = instrumentr_call_get_id(call);
-        fun_id = instrumentr_closure_get_id(closure);
-        fun_name = charptr_to_string(instrumentr_closure_get_name(closure));
-    }
-
-    return call;
-}
-
-void get_four_caller_info(instrumentr_call_stack_t call_stack,
+void get_four_caller_info(const CallerStack& caller_stack,
+                          instrumentr_call_stack_t call_stack,
                           int& source_fun_id_1,
                           int& source_call_id_1,
                           int& source_fun_id_2,
@@ -379,20 +421,23 @@ void get_four_caller_info(instrumentr_call_stack_t call_stack,
                           int& source_call_id_3,
                           int& source_fun_id_4,
                           int& source_call_id_4,
-                          int& index) {
-    std::string fun_name;
-
-    get_caller_info(
-        call_stack, source_fun_id_1, source_call_id_1, fun_name, index);
-    ++index;
-    get_caller_info(
-        call_stack, source_fun_id_2, source_call_id_2, fun_name, index);
-    ++index;
-    get_caller_info(
-        call_stack, source_fun_id_3, source_call_id_3, fun_name, index);
-    ++index;
-    get_caller_info(
-        call_stack, source_fun_id_4, source_call_id_4, fun_name, index);
+                          int index) {
+    ProfileScope scope(PROFILE_PHASE_CALLER_INFO);
+
+    int fun_ids[4];
+    int call_ids[4];
+
+    caller_stack.get_four_callers(
+        instrumentr_call_stack_get_size(call_stack), index, fun_ids, call_ids);
+
+    source_fun_id_1 = fun_ids[0];
+    source_call_id_1 = call_ids[0];
+    source_fun_id_2 = fun_ids[1];
+    source_call_id_2 = call_ids[1];
+    source_fun_id_3 = fun_ids[2];
+    source_call_id_3 = call_ids[2];
+    source_fun_id_4 = fun_ids[3];
+    source_call_id_4 = call_ids[3];
 }
 
 int get_environment_depth(instrumentr_call_stack_t call_stack,
@@ -431,7 +476,9 @@ void handle_builtin_environment_access(instrumentr_state_t state,
                                        instrumentr_call_stack_t call_stack,
                                        instrumentr_call_t call,
                                        instrumentr_builtin_t builtin,
+                                       builtin_kind_t kind,
                                        Backtrace& backtrace,
+                                       CallerStack& caller_stack,
                                        EnvironmentAccessTable& env_access_table,
                                        EnvironmentTable& env_table,
                                        FunctionTable& function_table) {
@@ -490,7 +537,7 @@ void handle_builtin_environment_access(instrumentr_state_t state,
 
     std::string seq_env_id = ENVTRACER_NA_STRING;
 
-    if (fun_name == "length" || fun_name == "env2list") {
+    if (kind == BUILTIN_ENV_ARG) {
         instrumentr_pairlist_t arguments =
             instrumentr_value_as_pairlist(arg_val);
 
@@ -506,7 +553,7 @@ void handle_builtin_environment_access(instrumentr_state_t state,
         }
     }
 
-    else if (fun_name == "list2env") {
+    else if (kind == BUILTIN_LIST2ENV) {
         instrumentr_pairlist_t arguments =
             instrumentr_value_as_pairlist(arg_val);
 
@@ -522,7 +569,7 @@ void handle_builtin_environment_access(instrumentr_state_t state,
         }
     }
 
-    else if (fun_name == "as.environment" || fun_name == "pos.to.env") {
+    else if (kind == BUILTIN_AS_ENVIRONMENT) {
         record = true;
 
         SEXP r_x = CAR(r_arguments);
@@ -538,8 +585,7 @@ void handle_builtin_environment_access(instrumentr_state_t state,
         }
     }
 
-    else if (fun_name == "sys.call" || fun_name == "sys.frame" ||
-             fun_name == "sys.function") {
+    else if (kind == BUILTIN_SYS_WHICH) {
         record = true;
 
         SEXP r_which = CAR(r_arguments);
@@ -561,7 +607,7 @@ void handle_builtin_environment_access(instrumentr_state_t state,
         }
     }
 
-    else if (fun_name == "sys.parent" || fun_name == "parent.frame") {
+    else if (kind == BUILTIN_SYS_N) {
         record = true;
 
         SEXP r_n = CAR(r_arguments);
@@ -583,13 +629,11 @@ void handle_builtin_environment_access(instrumentr_state_t state,
         }
     }
 
-    else if (fun_name == "sys.calls" || fun_name == "sys.parents" ||
-             fun_name == "sys.on.exit" || fun_name == "sys.status" ||
-             fun_name == "sys.nframe") {
+    else if (kind == BUILTIN_SYS_OTHER) {
         record = true;
     }
 
-    else if (fun_name == "sys.frames" && result != nullptr) {
+    else if (kind == BUILTIN_SYS_FRAMES && result != nullptr) {
         record = true;
 
         if (instrumentr_value_is_pairlist(result)) {
@@ -622,7 +666,7 @@ void handle_builtin_environment_access(instrumentr_state_t state,
 
     }
 
-    else if (fun_name == "environment") {
+    else if (kind == BUILTIN_ENVIRONMENT) {
         record = true;
 
         instrumentr_pairlist_t arguments =
@@ -638,7 +682,7 @@ void handle_builtin_environment_access(instrumentr_state_t state,
         fun_type = get_sexp_type(instrumentr_value_get_sexp(fun_val));
     }
 
-    else if (fun_name == "environment<-") {
+    else if (kind == BUILTIN_ENVIRONMENT_ASSIGN) {
         record = true;
 
         instrumentr_pairlist_t arguments =
@@ -665,7 +709,7 @@ void handle_builtin_environment_access(instrumentr_state_t state,
         }
     }
 
-    else if (fun_name == "lockEnvironment") {
+    else if (kind == BUILTIN_LOCK_ENVIRONMENT) {
         record = true;
 
         instrumentr_pairlist_t arguments =
@@ -690,7 +734,7 @@ void handle_builtin_environment_access(instrumentr_state_t state,
         }
     }
 
-    else if (fun_name == "lockBinding" || fun_name == "unlockBinding") {
+    else if (kind == BUILTIN_LOCK_BINDING) {
         record = true;
 
         instrumentr_pairlist_t arguments =
@@ -715,7 +759,7 @@ void handle_builtin_environment_access(instrumentr_state_t state,
         }
     }
 
-    else if (fun_name == "environmentName") {
+    else if (kind == BUILTIN_ENVIRONMENT_NAME) {
         record = true;
 
         instrumentr_pairlist_t arguments =
@@ -737,7 +781,7 @@ void handle_builtin_environment_access(instrumentr_state_t state,
         }
     }
 
-    else if (fun_name == "parent.env<-") {
+    else if (kind == BUILTIN_PARENT_ENV_ASSIGN) {
         record = true;
 
         instrumentr_pairlist_t arguments =
@@ -776,7 +820,7 @@ void handle_builtin_environment_access(instrumentr_state_t state,
         }
     }
 
-    else if (fun_name == "parent.env") {
+    else if (kind == BUILTIN_PARENT_ENV) {
         record = true;
 
         instrumentr_pairlist_t arguments =
@@ -799,8 +843,7 @@ void handle_builtin_environment_access(instrumentr_state_t state,
         }
     }
 
-    else if (fun_name == "emptyenv" || fun_name == "baseenv" ||
-             fun_name == "globalenv") {
+    else if (kind == BUILTIN_SPECIAL_ENV) {
         record = true;
     }
 
@@ -810,7 +853,7 @@ void handle_builtin_environment_access(instrumentr_state_t state,
         int depth = dyntrace_get_frame_depth();
 
         EnvironmentAccess* env_access =
-            new EnvironmentAccess(time, depth, fun_name);
+            env_access_table.create(time, depth, fun_name);
 
         env_access->set_result_env(result_env_type, result_env_id);
 
@@ -872,7 +915,8 @@ void handle_builtin_environment_access(instrumentr_state_t state,
         int source_fun_id_4 = NA_INTEGER;
         int source_call_id_4 = NA_INTEGER;
 
-        get_four_caller_info(call_stack,
+        get_four_caller_info(caller_stack,
+                             call_stack,
                              source_fun_id_1,
                              source_call_id_1,
                              source_fun_id_2,
@@ -892,7 +936,7 @@ void handle_builtin_environment_access(instrumentr_state_t state,
                                source_fun_id_4,
                                source_call_id_4);
 
-        env_access->set_backtrace(backtrace.to_string());
+        env_access->set_backtrace(backtrace.get_node_id());
 
         env_access_table.insert(env_access);
     }
@@ -903,13 +947,12 @@ void handle_builtin_environment_construction(
     instrumentr_call_stack_t call_stack,
     instrumentr_call_t call,
     instrumentr_builtin_t builtin,
+    builtin_kind_t kind,
     Backtrace& backtrace,
+    CallerStack& caller_stack,
     EnvironmentConstructorTable& env_constructor_table,
     EnvironmentTable& env_table) {
-    std::string fun_name =
-        charptr_to_string(instrumentr_builtin_get_name(builtin));
-
-    if (fun_name != "new.env") {
+    if (kind != BUILTIN_NEW_ENV) {
         return;
     }
 
@@ -935,7 +978,8 @@ void handle_builtin_environment_construction(
     int source_fun_id_4 = NA_INTEGER;
     int source_call_id_4 = NA_INTEGER;
 
-    get_four_caller_info(call_stack,
+    get_four_caller_info(caller_stack,
+                         call_stack,
                          source_fun_id_1,
                          source_call_id_1,
                          source_fun_id_2,
@@ -991,22 +1035,22 @@ void handle_builtin_environment_construction(
     int frame_count = instrumentr_environment_get_frame_count(result_env);
 
     EnvironmentConstructor* cons =
-        new EnvironmentConstructor(result_env_id,
-                                   source_fun_id_1,
-                                   source_call_id_1,
-                                   source_fun_id_2,
-                                   source_call_id_2,
-                                   source_fun_id_3,
-                                   source_call_id_3,
-                                   source_fun_id_4,
-                                   source_call_id_4,
-                                   hash,
-                                   parent_env_id,
-                                   parent_env_depth,
-                                   size,
-                                   frame_count,
-                                   parent_type,
-                                   backtrace.to_string());
+        env_constructor_table.create(result_env_id,
+                                     source_fun_id_1,
+                                     source_call_id_1,
+                                     source_fun_id_2,
+                                     source_call_id_2,
+                                     source_fun_id_3,
+                                     source_call_id_3,
+                                     source_fun_id_4,
+                                     source_call_id_4,
+                                     hash,
+                                     parent_env_id,
+                                     parent_env_depth,
+                                     size,
+                                     frame_count,
+                                     parent_type,
+                                     backtrace.get_node_id());
 
     env_constructor_table.insert(cons);
 
@@ -1022,10 +1066,7 @@ void builtin_call_entry_callback(instrumentr_tracer_t tracer,
                                  instrumentr_call_t call) {
     TracingState& tracing_state = TracingState::lookup(state);
 
-    instrumentr_call_stack_t call_stack =
-        instrumentr_state_get_call_stack(state);
-
-    /* handle backtrace */
+    /* handle backtrace, also inside untraced calls */
     Backtrace& backtrace = tracing_state.get_backtrace();
 
     backtrace.push(call);
@@ -1039,8 +1080,26 @@ void builtin_call_exit_callback(instrumentr_tracer_t tracer,
                                 instrumentr_call_t call) {
     TracingState& tracing_state = TracingState::lookup(state);
 
+    /* handle backtrace */
+    Backtrace& backtrace = tracing_state.get_backtrace();
+
+    builtin_kind_t kind =
+        tracing_state.get_builtin_dispatch_table().lookup(builtin);
+
     EnvironmentTable& env_table = tracing_state.get_environment_table();
 
+    /* eval scopes follow the parents of environments, which also change
+       inside untraced calls */
+    if (kind == BUILTIN_PARENT_ENV_ASSIGN) {
+        env_table.invalidate_eval_parents();
+    }
+
+    if (kind == BUILTIN_IRRELEVANT ||
+        tracing_state.get_trace_filter().is_muted()) {
+        backtrace.pop();
+        return;
+    }
+
     EnvironmentAccessTable& env_access_table =
         tracing_state.get_environment_access_table();
 
@@ -1052,14 +1111,15 @@ void builtin_call_exit_callback(instrumentr_tracer_t tracer,
     instrumentr_call_stack_t call_stack =
         instrumentr_state_get_call_stack(state);
 
-    /* handle backtrace */
-    Backtrace& backtrace = tracing_state.get_backtrace();
+    CallerStack& caller_stack = tracing_state.get_caller_stack();
 
     handle_builtin_environment_access(state,
                                       call_stack,
                                       call,
                                       builtin,
+                                      kind,
                                       backtrace,
+                                      caller_stack,
                                       env_access_table,
                                       env_table,
                                       function_table);
@@ -1068,7 +1128,9 @@ void builtin_call_exit_callback(instrumentr_tracer_t tracer,
                                             call_stack,
                                             call,
                                             builtin,
+                                            kind,
                                             backtrace,
+                                            caller_stack,
                                             env_constructor_table,
                                             env_table);
 
@@ -1109,6 +1171,10 @@ void special_call_exit_callback(instrumentr_tracer_t tracer,
 
     TracingState& tracing_state = TracingState::lookup(state);
 
+    if (tracing_state.get_trace_filter().is_muted()) {
+        return;
+    }
+
     EnvironmentTable& env_table = tracing_state.get_environment_table();
 
     EnvironmentAccessTable& env_access_table =
@@ -1118,6 +1184,7 @@ void special_call_exit_callback(instrumentr_tracer_t tracer,
         instrumentr_state_get_call_stack(state);
 
     Backtrace& backtrace = tracing_state.get_backtrace();
+    CallerStack& caller_stack = tracing_state.get_caller_stack();
 
     int source_fun_id_1 = NA_INTEGER;
     int source_call_id_1 = NA_INTEGER;
@@ -1129,7 +1196,8 @@ void special_call_exit_callback(instrumentr_tracer_t tracer,
     int source_call_id_4 = NA_INTEGER;
     int frame_index = 1;
 
-    get_four_caller_info(call_stack,
+    get_four_caller_info(caller_stack,
+                         call_stack,
                          source_fun_id_1,
                          source_call_id_1,
                          source_fun_id_2,
@@ -1143,7 +1211,7 @@ void special_call_exit_callback(instrumentr_tracer_t tracer,
     Environment* env = env_table.insert(environment);
     env->add_event("~");
 
-    EnvironmentAccess* env_access = new EnvironmentAccess(time, depth, "~");
+    EnvironmentAccess* env_access = env_access_table.create(time, depth, "~");
 
     env_access->set_result_env("environment", env->get_id());
 
@@ -1156,7 +1224,7 @@ void special_call_exit_callback(instrumentr_tracer_t tracer,
                            source_fun_id_4,
                            source_call_id_4);
 
-    env_access->set_backtrace(backtrace.to_string());
+    env_access->set_backtrace(backtrace.get_node_id());
 
     env_access_table.insert(env_access);
 
@@ -1240,6 +1308,39 @@ void closure_call_entry_callback(instrumentr_tracer_t tracer,
                                  instrumentr_call_t call) {
     TracingState& tracing_state = TracingState::lookup(state);
 
+    bool traced = tracing_state.get_trace_filter().enter_closure(closure);
+
+    /* the backtrace and the callers are maintained for untraced calls too,
+       so that they are complete for the traced calls nested in them */
+
+    /* handle backtrace */
+    Backtrace& backtrace = tracing_state.get_backtrace();
+
+    backtrace.push(call);
+
+    /* handle callers */
+    CallerStack& caller_stack = tracing_state.get_caller_stack();
+
+    instrumentr_call_stack_t call_stack =
+        instrumentr_state_get_call_stack(state);
+
+    caller_stack.push_call(
+        instrumentr_call_stack_get_size(call_stack), closure, call);
+
+    std::string closure_name =
+        charptr_to_string(instrumentr_closure_get_name(closure));
+
+    EnvironmentAccessTable& env_access_table =
+        tracing_state.get_environment_access_table();
+
+    if (closure_name == "library" || closure_name == "loadNamespace") {
+        env_access_table.push_library();
+    }
+
+    if (!traced) {
+        return;
+    }
+
     /* handle environments */
 
     EnvironmentTable& env_table = tracing_state.get_environment_table();
@@ -1250,7 +1351,7 @@ void closure_call_entry_callback(instrumentr_tracer_t tracer,
     Environment* call_env_data =
         env_table.insert(instrumentr_call_get_environment(call));
 
-    call_env_data->add_event("CallEntry");
+    call_env_data->add_event(ENV_EVENT_CALL_ENTRY);
 
     /* handle closure */
 
@@ -1266,6 +1367,9 @@ void closure_call_entry_callback(instrumentr_tracer_t tracer,
 
     Call* call_data = call_table.insert(call, function_data);
 
+    call_data->set_sample_weight(
+        tracing_state.get_trace_filter().get_sample_weight());
+
     /* handle arguments */
 
     // NOTE: this table is not needed
@@ -1276,21 +1380,6 @@ void closure_call_entry_callback(instrumentr_tracer_t tracer,
     //    call_env_data);
     //
     // process_actuals(argument_table, call);
-
-    /* handle backtrace */
-    Backtrace& backtrace = tracing_state.get_backtrace();
-
-    backtrace.push(call);
-
-    std::string closure_name =
-        charptr_to_string(instrumentr_closure_get_name(closure));
-
-    EnvironmentAccessTable& env_access_table =
-        tracing_state.get_environment_access_table();
-
-    if (closure_name == "library" || closure_name == "loadNamespace") {
-        env_access_table.push_library();
-    }
 }
 
 // void handle_call_result(instrumentr_closure_t closure,
@@ -1334,6 +1423,7 @@ void handle_closure_environment_access(instrumentr_state_t state,
                                        instrumentr_call_t call,
                                        instrumentr_closure_t closure,
                                        Backtrace& backtrace,
+                                       CallerStack& caller_stack,
                                        EnvironmentAccessTable& env_access_table,
                                        EnvironmentTable& env_table) {
     std::string fun_name =
@@ -1393,7 +1483,8 @@ void handle_closure_environment_access(instrumentr_state_t state,
     int source_call_id_4 = NA_INTEGER;
     int frame_index = 1;
 
-    get_four_caller_info(call_stack,
+    get_four_caller_info(caller_stack,
+                         call_stack,
                          source_fun_id_1,
                          source_call_id_1,
                          source_fun_id_2,
@@ -1406,9 +1497,13 @@ void handle_closure_environment_access(instrumentr_state_t state,
 
     Environment* env = env_table.insert(environment);
 
-    env->add_event(fun_name == "getNamespace" ? fun_name : "Return");
+    if (fun_name == "getNamespace") {
+        env->add_event(fun_name);
+    } else {
+        env->add_event(ENV_EVENT_RETURN);
+    }
 
-    EnvironmentAccess* env_access = new EnvironmentAccess(
+    EnvironmentAccess* env_access = env_access_table.create(
         time, NA_INTEGER, fun_name == "getNamespace" ? fun_name : "Return");
 
     env_access->set_result_env("environment", env->get_id());
@@ -1430,7 +1525,7 @@ void handle_closure_environment_access(instrumentr_state_t state,
                            source_fun_id_4,
                            source_call_id_4);
 
-    env_access->set_backtrace(backtrace.to_string());
+    env_access->set_backtrace(backtrace.get_node_id());
 
     env_access_table.insert(env_access);
 }
@@ -1443,41 +1538,45 @@ void closure_call_exit_callback(instrumentr_tracer_t tracer,
                                 instrumentr_call_t call) {
     TracingState& tracing_state = TracingState::lookup(state);
 
-    ArgumentTable& argument_table = tracing_state.get_argument_table();
-
-    /* handle calls */
-    CallTable& call_table = tracing_state.get_call_table();
+    bool traced = tracing_state.get_trace_filter().exit_closure();
 
     EnvironmentTable& env_table = tracing_state.get_environment_table();
 
-    Environment* call_env_data =
-        env_table.insert(instrumentr_call_get_environment(call));
-
-    call_env_data->add_event("CallExit");
+    if (traced) {
+        /* handle calls */
+        CallTable& call_table = tracing_state.get_call_table();
 
-    int call_id = instrumentr_call_get_id(call);
+        Environment* call_env_data =
+            env_table.insert(instrumentr_call_get_environment(call));
 
-    bool has_result = instrumentr_call_has_result(call);
+        call_env_data->add_event(ENV_EVENT_CALL_EXIT);
 
-    instrumentr_value_t result = nullptr;
+        int call_id = instrumentr_call_get_id(call);
 
-    std::string result_type = ENVTRACER_NA_STRING;
+        std::string result_type = ENVTRACER_NA_STRING;
 
-    if (has_result) {
-        result = instrumentr_call_get_result(call);
-        instrumentr_value_type_t val_type = instrumentr_value_get_type(result);
-        result_type = instrumentr_value_type_get_name(val_type);
-    }
+        if (instrumentr_call_has_result(call)) {
+            instrumentr_value_t result = instrumentr_call_get_result(call);
+            instrumentr_value_type_t val_type =
+                instrumentr_value_get_type(result);
+            result_type = instrumentr_value_type_get_name(val_type);
+        }
 
-    Call* call_data = call_table.lookup(call_id);
+        Call* call_data = call_table.lookup(call_id);
 
-    call_data->exit(result_type);
+        call_table.exit(call_data, result_type);
+    }
 
     /* handle backtrace */
     Backtrace& backtrace = tracing_state.get_backtrace();
 
     backtrace.pop();
 
+    /* handle callers */
+    CallerStack& caller_stack = tracing_state.get_caller_stack();
+
+    caller_stack.pop_call(call);
+
     instrumentr_call_stack_t call_stack =
         instrumentr_state_get_call_stack(state);
 
@@ -1491,11 +1590,16 @@ void closure_call_exit_callback(instrumentr_tracer_t tracer,
         env_access_table.pop_library();
     }
 
+    if (!traced) {
+        return;
+    }
+
     handle_closure_environment_access(state,
                                       call_stack,
                                       call,
                                       closure,
                                       backtrace,
+                                      caller_stack,
                                       env_access_table,
                                       env_table);
 }
@@ -1571,6 +1675,11 @@ void promise_substitute_callback(instrumentr_tracer_t tracer,
     }
 
     TracingState& tracing_state = TracingState::lookup(state);
+
+    if (tracing_state.get_trace_filter().is_muted()) {
+        return;
+    }
+
     CallTable& call_table = tracing_state.get_call_table();
     ArgumentTable& argument_table = tracing_state.get_argument_table();
     MetaprogrammingTable& meta_table =
@@ -1607,6 +1716,11 @@ void promise_expression_lookup_callback(instrumentr_tracer_t tracer,
     }
 
     TracingState& tracing_state = TracingState::lookup(state);
+
+    if (tracing_state.get_trace_filter().is_muted()) {
+        return;
+    }
+
     CallTable& call_table = tracing_state.get_call_table();
     ArgumentTable& argument_table = tracing_state.get_argument_table();
     MetaprogrammingTable& meta_table =
@@ -1643,6 +1757,11 @@ void promise_value_lookup_callback(instrumentr_tracer_t tracer,
     }
 
     TracingState& tracing_state = TracingState::lookup(state);
+
+    if (tracing_state.get_trace_filter().is_muted()) {
+        return;
+    }
+
     CallTable& call_table = tracing_state.get_call_table();
     ArgumentTable& argument_table = tracing_state.get_argument_table();
 
@@ -1790,11 +1909,8 @@ void compute_parent_argument(instrumentr_state_t state,
     }
 }
 
-void promise_force_entry_callback(instrumentr_tracer_t tracer,
-                                  instrumentr_callback_t callback,
-                                  instrumentr_state_t state,
-                                  instrumentr_application_t application,
-                                  instrumentr_promise_t promise) {
+void handle_argument_force_entry(instrumentr_state_t state,
+                                 instrumentr_promise_t promise) {
     if (instrumentr_promise_get_type(promise) !=
         INSTRUMENTR_PROMISE_TYPE_ARGUMENT) {
         return;
@@ -1831,11 +1947,43 @@ void promise_force_entry_callback(instrumentr_tracer_t tracer,
     compute_parent_argument(state, argument_table, promise);
 }
 
+void promise_force_entry_callback(instrumentr_tracer_t tracer,
+                                  instrumentr_callback_t callback,
+                                  instrumentr_state_t state,
+                                  instrumentr_application_t application,
+                                  instrumentr_promise_t promise) {
+    TracingState& tracing_state = TracingState::lookup(state);
+
+    /* handle callers, also inside untraced calls */
+    CallerStack& caller_stack = tracing_state.get_caller_stack();
+
+    instrumentr_call_stack_t call_stack =
+        instrumentr_state_get_call_stack(state);
+
+    caller_stack.push_promise(instrumentr_call_stack_get_size(call_stack),
+                              promise);
+
+    /* arguments are not handled since the argument table is not populated,
+       see closure_call_entry_callback */
+}
+
 void promise_force_exit_callback(instrumentr_tracer_t tracer,
                                  instrumentr_callback_t callback,
                                  instrumentr_state_t state,
                                  instrumentr_application_t application,
                                  instrumentr_promise_t promise) {
+    TracingState& tracing_state = TracingState::lookup(state);
+
+    /* handle callers, also inside untraced calls */
+    CallerStack& caller_stack = tracing_state.get_caller_stack();
+
+    caller_stack.pop_promise();
+
+    if (!tracing_state.has_metaprogramming_table() ||
+        tracing_state.get_trace_filter().is_muted()) {
+        return;
+    }
+
     if (instrumentr_promise_get_type(promise) !=
         INSTRUMENTR_PROMISE_TYPE_ARGUMENT) {
         return;
@@ -1857,8 +2005,6 @@ void promise_force_exit_callback(instrumentr_tracer_t tracer,
     instrumentr_call_stack_t call_stack =
         instrumentr_state_get_call_stack(state);
 
-    TracingState& tracing_state = TracingState::lookup(state);
-
     EnvironmentTable& env_table = tracing_state.get_environment_table();
 
     CallTable& call_table = tracing_state.get_call_table();
@@ -1870,7 +2016,7 @@ void promise_force_exit_callback(instrumentr_tracer_t tracer,
 
     Environment* env = env_table.insert(environment);
 
-    env->add_event("Argument");
+    env->add_event(ENV_EVENT_ARGUMENT);
 
     instrumentr_call_t call = instrumentr_promise_get_call(promise);
 
@@ -1879,7 +2025,7 @@ void promise_force_exit_callback(instrumentr_tracer_t tracer,
     int time = instrumentr_state_get_time(state);
 
     EnvironmentAccess* env_access =
-        new EnvironmentAccess(time, NA_INTEGER, "Argument");
+        env_access_table.create(time, NA_INTEGER, "Argument");
 
     /* NOTE: we are setting call id for a reason */
     env_access->set_fun("closure", call_data->get_fun_id());
@@ -1894,7 +2040,8 @@ void promise_force_exit_callback(instrumentr_tracer_t tracer,
     int source_call_id_4 = NA_INTEGER;
     int frame_index = 1;
 
-    get_four_caller_info(call_stack,
+    get_four_caller_info(caller_stack,
+                         call_stack,
                          source_fun_id_1,
                          source_call_id_1,
                          source_fun_id_2,
@@ -1914,7 +2061,7 @@ void promise_force_exit_callback(instrumentr_tracer_t tracer,
                            source_fun_id_4,
                            source_call_id_4);
 
-    env_access->set_backtrace(backtrace.to_string());
+    env_access->set_backtrace(backtrace.get_node_id());
 
     env_access_table.insert(env_access);
 }
@@ -1922,23 +2069,26 @@ void promise_force_exit_callback(instrumentr_tracer_t tracer,
 void tracing_entry_callback(instrumentr_tracer_t tracer,
                             instrumentr_callback_t callback,
                             instrumentr_state_t state) {
-    TracingState::initialize(state);
+    TracingState::initialize(state, get_tracing_options(tracer));
 
     TracingState& tracing_state = TracingState::lookup(state);
     EnvironmentTable& env_table = tracing_state.get_environment_table();
+    const NamespaceCatalog& catalog = tracing_state.get_namespace_catalog();
 
     std::vector<instrumentr_environment_t> namespaces =
         instrumentr_state_get_namespaces(state);
 
     for (auto ns: namespaces) {
-        analyze_package_environment(state, env_table, ns, "namespace");
+        analyze_package_environment(
+            state, env_table, catalog, ns, "namespace");
     }
 
     std::vector<instrumentr_environment_t> packages =
         instrumentr_state_get_packages(state);
 
     for (auto packs: packages) {
-        analyze_package_environment(state, env_table, packs, "package");
+        analyze_package_environment(
+            state, env_table, catalog, packs, "package");
     }
 
     env_table.insert(instrumentr_state_get_global_env(state));
@@ -1954,60 +2104,9 @@ void tracing_exit_callback(instrumentr_tracer_t tracer,
 
     fun_table.infer_qualified_names(env_table);
 
-    TracingState::finalize(state);
-}
-
-void get_call_info(instrumentr_call_stack_t call_stack,
-                   int position,
-                   bool builtin,
-                   bool special,
-                   bool closure,
-                   std::string& fun_name,
-                   std::string& pack_name,
-                   int& call_id) {
-    pack_name = ENVTRACER_NA_STRING;
-    fun_name = ENVTRACER_NA_STRING;
-    call_id = NA_INTEGER;
-
-    if (instrumentr_call_stack_get_size(call_stack) <= position) {
-        return;
-    }
-
-    instrumentr_frame_t frame =
-        instrumentr_call_stack_peek_frame(call_stack, position);
-
-    if (!instrumentr_frame_is_call(frame)) {
-        return;
-    }
-
-    instrumentr_call_t call = instrumentr_frame_as_call(frame);
-
-    instrumentr_value_t function = instrumentr_call_get_function(call);
-
-    if (builtin && instrumentr_value_is_builtin(function)) {
-        instrumentr_builtin_t builtin = instrumentr_value_as_builtin(function);
-        fun_name = charptr_to_string(instrumentr_builtin_get_name(builtin));
-        pack_name = "base";
-    }
-
-    else if (special && instrumentr_value_is_special(function)) {
-        instrumentr_special_t special = instrumentr_value_as_special(function);
-        fun_name = charptr_to_string(instrumentr_special_get_name(special));
-        pack_name = "base";
-    }
-
-    else if (closure && instrumentr_value_is_closure(function)) {
-        instrumentr_closure_t closure = instrumentr_value_as_closure(function);
-        fun_name = charptr_to_string(instrumentr_closure_get_name(closure));
-        instrumentr_environment_t environment =
-            instrumentr_closure_get_environment(closure);
-        pack_name =
-            charptr_to_string(instrumentr_environment_get_name(environment));
-    }
+    release_tracing_options(tracer);
 
-    if (fun_name != ENVTRACER_NA_STRING) {
-        call_id = instrumentr_call_get_id(call);
-    }
+    TracingState::finalize(state);
 }
 
 void subset_or_subassign_callback(instrumentr_tracer_t tracer,
@@ -2023,10 +2122,16 @@ void subset_or_subassign_callback(instrumentr_tracer_t tracer,
     }
 
     TracingState& tracing_state = TracingState::lookup(state);
+
+    if (tracing_state.get_trace_filter().is_muted()) {
+        return;
+    }
+
     EnvironmentTable& env_table = tracing_state.get_environment_table();
     EnvironmentAccessTable& env_access_table =
         tracing_state.get_environment_access_table();
     Backtrace& backtrace = tracing_state.get_backtrace();
+    CallerStack& caller_stack = tracing_state.get_caller_stack();
 
     instrumentr_call_stack_t call_stack =
         instrumentr_state_get_call_stack(state);
@@ -2087,7 +2192,8 @@ void subset_or_subassign_callback(instrumentr_tracer_t tracer,
     int source_call_id_4;
     int frame_index = 1;
 
-    get_four_caller_info(call_stack,
+    get_four_caller_info(caller_stack,
+                         call_stack,
                          source_fun_id_1,
                          source_call_id_1,
                          source_fun_id_2,
@@ -2099,9 +2205,9 @@ void subset_or_subassign_callback(instrumentr_tracer_t tracer,
                          frame_index);
 
     EnvironmentAccess* env_access =
-        new EnvironmentAccess(time, depth, fun_name);
+        env_access_table.create(time, depth, fun_name);
 
-    env_access->set_backtrace(backtrace.to_string());
+    env_access->set_backtrace(backtrace.get_node_id());
 
     env_access->set_source(source_fun_id_1,
                            source_call_id_1,
@@ -2118,14 +2224,44 @@ void subset_or_subassign_callback(instrumentr_tracer_t tracer,
     env_access_table.insert(env_access);
 }
 
+reflective_fun_t get_reflective_fun(instrumentr_call_stack_t call_stack,
+                                    int position,
+                                    ReflectiveFunctionTable& reflective_table) {
+    if (instrumentr_call_stack_get_size(call_stack) <= position) {
+        return REFLECTIVE_NONE;
+    }
+
+    instrumentr_frame_t frame =
+        instrumentr_call_stack_peek_frame(call_stack, position);
+
+    if (!instrumentr_frame_is_call(frame)) {
+        return REFLECTIVE_NONE;
+    }
+
+    instrumentr_value_t function =
+        instrumentr_call_get_function(instrumentr_frame_as_call(frame));
+
+    if (!instrumentr_value_is_closure(function)) {
+        return REFLECTIVE_NONE;
+    }
+
+    return reflective_table.lookup(instrumentr_value_as_closure(function));
+}
+
+/* NOTE: this is called for every variable lookup, so nothing is allocated
+   until we know that the event has to be recorded. symbol is nullptr and
+   value_type is NA_INTEGER for events without a symbol or a value. */
 void process_reads_and_writes(instrumentr_state_t state,
                               instrumentr_environment_t environment,
-                              const std::string& event,
-                              const std::string& varname,
-                              const std::string& value_type,
+                              variable_event_t event,
+                              instrumentr_symbol_t symbol,
+                              int value_type,
                               EnvironmentTable& environment_table,
                               EnvironmentAccessTable& env_access_table,
-                              Backtrace& backtrace) {
+                              Backtrace& backtrace,
+                              CallerStack& caller_stack,
+                              ReflectiveFunctionTable& reflective_table,
+                              const EvalScopeStack& eval_scopes) {
     if (env_access_table.inside_library()) {
         return;
     }
@@ -2133,78 +2269,69 @@ void process_reads_and_writes(instrumentr_state_t state,
     instrumentr_call_stack_t call_stack =
         instrumentr_state_get_call_stack(state);
 
-    Environment* env = environment_table.insert(environment);
+    /* environments under eval have been inserted by eval_call_entry */
+    Environment* env =
+        environment_table.lookup(instrumentr_environment_get_id(environment));
+
+    bool under_eval =
+        env != NULL && eval_scopes.is_under_eval(env->get_slot());
 
     bool record = false;
 
-    std::string fun_name = ENVTRACER_NA_STRING;
-    std::string pack_name = ENVTRACER_NA_STRING;
-    int call_id = NA_INTEGER;
+    const char* fun_name = nullptr;
     int frame_index = 3;
 
-    if (event == "ls") {
+    if (event == ENVIRONMENT_LS) {
         frame_index = 7;
-    } else if (event == "R") {
+    } else if (event == VARIABLE_REMOVE) {
         frame_index = 5;
     }
 
-    get_call_info(call_stack,
-                  frame_index,
-                  false,
-                  false,
-                  true,
-                  fun_name,
-                  pack_name,
-                  call_id);
-
-    if ((pack_name == "base") &&
-        ((event == "L" &&
-          (fun_name == "get" || fun_name == "get0" || fun_name == "mget")) ||
-         (event == "A" && (fun_name == "assign")) ||
-         (event == "D" && (fun_name == "assign")) ||
-         (event == "E" && (fun_name == "exists")) ||
-         (event == "R" && (fun_name == "remove" || fun_name == "rm")) ||
-         (event == "ls" && (fun_name == "ls" || fun_name == "objects")))) {
+    reflective_fun_t fun =
+        get_reflective_fun(call_stack, frame_index, reflective_table);
+
+    if (is_reflective_access(event, fun)) {
         record = true;
+        fun_name = get_reflective_fun_name(fun);
 
         /* get0 is called by dynGet */
-        if (fun_name == "get0") {
-            std::string parent_pack_name("");
-            std::string parent_fun_name("");
-            int parent_call_id = NA_INTEGER;
-            get_call_info(call_stack,
-                          15,
-                          false,
-                          false,
-                          true,
-                          parent_fun_name,
-                          parent_pack_name,
-                          parent_call_id);
-
-            if (parent_fun_name == "dynGet") {
-                fun_name = parent_fun_name;
-                frame_index = 15;
-            }
+        if (fun == REFLECTIVE_GET0 &&
+            get_reflective_fun(call_stack, 15, reflective_table) ==
+                REFLECTIVE_DYNGET) {
+            fun_name = get_reflective_fun_name(REFLECTIVE_DYNGET);
+            frame_index = 15;
         }
     }
 
-    else if (env->inside_eval()) {
+    else if (under_eval) {
         record = true;
-        fun_name = event;
+        fun_name = get_variable_event_name(event);
         frame_index = 0;
     }
 
     if (record) {
+        if (env == NULL) {
+            env = environment_table.insert(environment);
+        }
+
         int time = instrumentr_state_get_time(state);
 
         int depth = NA_INTEGER;
 
         EnvironmentAccess* env_access =
-            new EnvironmentAccess(time, depth, fun_name);
+            env_access_table.create(time, depth, fun_name);
+
+        env_access->set_backtrace(backtrace.get_node_id());
 
-        env_access->set_backtrace(backtrace.to_string());
+        env_access->set_side_effect(env->get_id(),
+                                    sexptype_to_string(value_type));
 
-        env_access->set_side_effect(env->get_id(), value_type);
+        std::string varname = ENVTRACER_NA_STRING;
+
+        if (symbol != nullptr) {
+            instrumentr_char_t charval = instrumentr_symbol_get_element(symbol);
+            varname = instrumentr_char_get_element(charval);
+        }
 
         env_access->set_symbol(varname);
 
@@ -2218,7 +2345,8 @@ void process_reads_and_writes(instrumentr_state_t state,
         int source_call_id_4;
         int frame_index = 1;
 
-        get_four_caller_info(call_stack,
+        get_four_caller_info(caller_stack,
+                             call_stack,
                              source_fun_id_1,
                              source_call_id_1,
                              source_fun_id_2,
@@ -2252,26 +2380,35 @@ void variable_lookup(instrumentr_tracer_t tracer,
                      instrumentr_value_t value,
                      instrumentr_environment_t environment) {
     TracingState& tracing_state = TracingState::lookup(state);
+
+    if (!tracing_state.get_trace_filter().is_traced(environment)) {
+        return;
+    }
+
     ArgumentTable& arg_table = tracing_state.get_argument_table();
     EffectsTable& effects_table = tracing_state.get_effects_table();
     EnvironmentTable& env_table = tracing_state.get_environment_table();
     EnvironmentAccessTable& env_access_table =
         tracing_state.get_environment_access_table();
     Backtrace& backtrace = tracing_state.get_backtrace();
+    CallerStack& caller_stack = tracing_state.get_caller_stack();
+    ReflectiveFunctionTable& reflective_table =
+        tracing_state.get_reflective_function_table();
+    EvalScopeStack& eval_scopes = tracing_state.get_eval_scopes();
 
-    instrumentr_char_t charval = instrumentr_symbol_get_element(symbol);
-    std::string varname = instrumentr_char_get_element(charval);
-
-    std::string value_type = get_sexp_type(instrumentr_value_get_sexp(value));
+    int value_type = get_sexp_typeof(instrumentr_value_get_sexp(value));
 
     process_reads_and_writes(state,
                              environment,
-                             "L",
-                             varname,
+                             VARIABLE_LOOKUP,
+                             symbol,
                              value_type,
                              env_table,
                              env_access_table,
-                             backtrace);
+                             backtrace,
+                             caller_stack,
+                             reflective_table,
+                             eval_scopes);
 }
 
 void variable_exists(instrumentr_tracer_t tracer,
@@ -2281,26 +2418,35 @@ void variable_exists(instrumentr_tracer_t tracer,
                      instrumentr_symbol_t symbol,
                      instrumentr_environment_t environment) {
     TracingState& tracing_state = TracingState::lookup(state);
+
+    if (!tracing_state.get_trace_filter().is_traced(environment)) {
+        return;
+    }
+
     ArgumentTable& arg_table = tracing_state.get_argument_table();
     EffectsTable& effects_table = tracing_state.get_effects_table();
     EnvironmentTable& env_table = tracing_state.get_environment_table();
     EnvironmentAccessTable& env_access_table =
         tracing_state.get_environment_access_table();
     Backtrace& backtrace = tracing_state.get_backtrace();
+    CallerStack& caller_stack = tracing_state.get_caller_stack();
+    ReflectiveFunctionTable& reflective_table =
+        tracing_state.get_reflective_function_table();
+    EvalScopeStack& eval_scopes = tracing_state.get_eval_scopes();
 
-    instrumentr_char_t charval = instrumentr_symbol_get_element(symbol);
-    std::string varname = instrumentr_char_get_element(charval);
-
-    std::string value_type = ENVTRACER_NA_STRING;
+    int value_type = NA_INTEGER;
 
     process_reads_and_writes(state,
                              environment,
-                             "E",
-                             varname,
+                             VARIABLE_EXISTS,
+                             symbol,
                              value_type,
                              env_table,
                              env_access_table,
-                             backtrace);
+                             backtrace,
+                             caller_stack,
+                             reflective_table,
+                             eval_scopes);
 }
 
 void function_context_lookup(instrumentr_tracer_t tracer,
@@ -2323,6 +2469,10 @@ void function_context_lookup(instrumentr_tracer_t tracer,
 
     TracingState& tracing_state = TracingState::lookup(state);
 
+    if (!tracing_state.get_trace_filter().is_traced(environment)) {
+        return;
+    }
+
     ArgumentTable& arg_tab = tracing_state.get_argument_table();
 
     int promise_id = instrumentr_promise_get_id(promise);
@@ -2348,25 +2498,35 @@ void variable_assign(instrumentr_tracer_t tracer,
                      instrumentr_value_t value,
                      instrumentr_environment_t environment) {
     TracingState& tracing_state = TracingState::lookup(state);
+
+    if (!tracing_state.get_trace_filter().is_traced(environment)) {
+        return;
+    }
+
     ArgumentTable& arg_table = tracing_state.get_argument_table();
     EffectsTable& effects_table = tracing_state.get_effects_table();
     EnvironmentTable& env_table = tracing_state.get_environment_table();
     EnvironmentAccessTable& env_access_table =
         tracing_state.get_environment_access_table();
     Backtrace& backtrace = tracing_state.get_backtrace();
+    CallerStack& caller_stack = tracing_state.get_caller_stack();
+    ReflectiveFunctionTable& reflective_table =
+        tracing_state.get_reflective_function_table();
+    EvalScopeStack& eval_scopes = tracing_state.get_eval_scopes();
 
-    instrumentr_char_t charval = instrumentr_symbol_get_element(symbol);
-    std::string varname = instrumentr_char_get_element(charval);
-    std::string value_type = get_sexp_type(instrumentr_value_get_sexp(value));
+    int value_type = get_sexp_typeof(instrumentr_value_get_sexp(value));
 
     process_reads_and_writes(state,
                              environment,
-                             "A",
-                             varname,
+                             VARIABLE_ASSIGN,
+                             symbol,
                              value_type,
                              env_table,
                              env_access_table,
-                             backtrace);
+                             backtrace,
+                             caller_stack,
+                             reflective_table,
+                             eval_scopes);
 }
 
 void variable_define(instrumentr_tracer_t tracer,
@@ -2377,25 +2537,35 @@ void variable_define(instrumentr_tracer_t tracer,
                      instrumentr_value_t value,
                      instrumentr_environment_t environment) {
     TracingState& tracing_state = TracingState::lookup(state);
+
+    if (!tracing_state.get_trace_filter().is_traced(environment)) {
+        return;
+    }
+
     ArgumentTable& arg_table = tracing_state.get_argument_table();
     EffectsTable& effects_table = tracing_state.get_effects_table();
     EnvironmentTable& env_table = tracing_state.get_environment_table();
     EnvironmentAccessTable& env_access_table =
         tracing_state.get_environment_access_table();
     Backtrace& backtrace = tracing_state.get_backtrace();
+    CallerStack& caller_stack = tracing_state.get_caller_stack();
+    ReflectiveFunctionTable& reflective_table =
+        tracing_state.get_reflective_function_table();
+    EvalScopeStack& eval_scopes = tracing_state.get_eval_scopes();
 
-    instrumentr_char_t charval = instrumentr_symbol_get_element(symbol);
-    std::string varname = instrumentr_char_get_element(charval);
-    std::string value_type = get_sexp_type(instrumentr_value_get_sexp(value));
+    int value_type = get_sexp_typeof(instrumentr_value_get_sexp(value));
 
     process_reads_and_writes(state,
                              environment,
-                             "D",
-                             varname,
+                             VARIABLE_DEFINE,
+                             symbol,
                              value_type,
                              env_table,
                              env_access_table,
-                             backtrace);
+                             backtrace,
+                             caller_stack,
+                             reflective_table,
+                             eval_scopes);
 }
 
 void variable_remove(instrumentr_tracer_t tracer,
@@ -2405,25 +2575,35 @@ void variable_remove(instrumentr_tracer_t tracer,
                      instrumentr_symbol_t symbol,
                      instrumentr_environment_t environment) {
     TracingState& tracing_state = TracingState::lookup(state);
+
+    if (!tracing_state.get_trace_filter().is_traced(environment)) {
+        return;
+    }
+
     ArgumentTable& arg_table = tracing_state.get_argument_table();
     EffectsTable& effects_table = tracing_state.get_effects_table();
     EnvironmentTable& env_table = tracing_state.get_environment_table();
     EnvironmentAccessTable& env_access_table =
         tracing_state.get_environment_access_table();
     Backtrace& backtrace = tracing_state.get_backtrace();
+    CallerStack& caller_stack = tracing_state.get_caller_stack();
+    ReflectiveFunctionTable& reflective_table =
+        tracing_state.get_reflective_function_table();
+    EvalScopeStack& eval_scopes = tracing_state.get_eval_scopes();
 
-    instrumentr_char_t charval = instrumentr_symbol_get_element(symbol);
-    std::string varname = instrumentr_char_get_element(charval);
-    std::string value_type = ENVTRACER_NA_STRING;
+    int value_type = NA_INTEGER;
 
     process_reads_and_writes(state,
                              environment,
-                             "R",
-                             varname,
+                             VARIABLE_REMOVE,
+                             symbol,
                              value_type,
                              env_table,
                              env_access_table,
-                             backtrace);
+                             backtrace,
+                             caller_stack,
+                             reflective_table,
+                             eval_scopes);
 }
 
 void environment_ls(instrumentr_tracer_t tracer,
@@ -2433,24 +2613,35 @@ void environment_ls(instrumentr_tracer_t tracer,
                     instrumentr_environment_t environment,
                     instrumentr_character_t result) {
     TracingState& tracing_state = TracingState::lookup(state);
+
+    if (!tracing_state.get_trace_filter().is_traced(environment)) {
+        return;
+    }
+
     ArgumentTable& arg_table = tracing_state.get_argument_table();
     EffectsTable& effects_table = tracing_state.get_effects_table();
     EnvironmentTable& env_table = tracing_state.get_environment_table();
     EnvironmentAccessTable& env_access_table =
         tracing_state.get_environment_access_table();
     Backtrace& backtrace = tracing_state.get_backtrace();
+    CallerStack& caller_stack = tracing_state.get_caller_stack();
+    ReflectiveFunctionTable& reflective_table =
+        tracing_state.get_reflective_function_table();
+    EvalScopeStack& eval_scopes = tracing_state.get_eval_scopes();
 
-    std::string varname = ENVTRACER_NA_STRING;
-    std::string value_type = ENVTRACER_NA_STRING;
+    int value_type = NA_INTEGER;
 
     process_reads_and_writes(state,
                              environment,
-                             "ls",
-                             varname,
+                             ENVIRONMENT_LS,
+                             nullptr,
                              value_type,
                              env_table,
                              env_access_table,
-                             backtrace);
+                             backtrace,
+                             caller_stack,
+                             reflective_table,
+                             eval_scopes);
 }
 
 void value_finalize(instrumentr_tracer_t tracer,
@@ -2512,6 +2703,11 @@ void trace_error(instrumentr_tracer_t tracer,
                  instrumentr_application_t application,
                  instrumentr_value_t call_expr) {
     TracingState& tracing_state = TracingState::lookup(state);
+
+    if (tracing_state.get_trace_filter().is_muted()) {
+        return;
+    }
+
     ArgumentTable& arg_tab = tracing_state.get_argument_table();
     EffectsTable& effects_tab = tracing_state.get_effects_table();
     Backtrace& backtrace = tracing_state.get_backtrace();
@@ -2565,7 +2761,7 @@ void trace_error(instrumentr_tracer_t tracer,
                            call_id,
                            arg_id,
                            formal_pos,
-                           backtrace.to_string());
+                           backtrace.get_node_id());
 
         if (!transitive) {
             source_fun_id = arg->get_fun_id();
@@ -2588,6 +2784,11 @@ void attribute_set_callback(instrumentr_tracer_t tracer,
     }
 
     TracingState& tracing_state = TracingState::lookup(state);
+
+    if (tracing_state.get_trace_filter().is_muted()) {
+        return;
+    }
+
     EnvironmentTable& env_table = tracing_state.get_environment_table();
 
     Environment* env =
@@ -2624,6 +2825,11 @@ void gc_allocation_callback(instrumentr_tracer_t tracer,
     }
 
     TracingState& tracing_state = TracingState::lookup(state);
+
+    if (tracing_state.get_trace_filter().is_muted()) {
+        return;
+    }
+
     EnvironmentTable& env_table = tracing_state.get_environment_table();
 
     instrumentr_environment_t environment =
@@ -2631,6 +2837,8 @@ void gc_allocation_callback(instrumentr_tracer_t tracer,
 
     Environment* env = env_table.insert(environment);
 
+    CallerStack& caller_stack = tracing_state.get_caller_stack();
+
     instrumentr_call_stack_t call_stack =
         instrumentr_state_get_call_stack(state);
 
@@ -2644,7 +2852,8 @@ void gc_allocation_callback(instrumentr_tracer_t tracer,
     int source_call_id_4 = NA_INTEGER;
     int frame_index = 0;
 
-    get_four_caller_info(call_stack,
+    get_four_caller_info(caller_stack,
+                         call_stack,
                          source_fun_id_1,
                          source_call_id_1,
                          source_fun_id_2,
@@ -2667,7 +2876,7 @@ void gc_allocation_callback(instrumentr_tracer_t tracer,
 
     Backtrace& backtrace = tracing_state.get_backtrace();
 
-    env->set_backtrace(backtrace.to_string());
+    env->set_backtrace(backtrace.get_node_id());
 }
 
 void use_method_entry_callback(instrumentr_tracer_t tracer,
@@ -2677,6 +2886,11 @@ void use_method_entry_callback(instrumentr_tracer_t tracer,
                                instrumentr_value_t object,
                                instrumentr_environment_t environment) {
     TracingState& tracing_state = TracingState::lookup(state);
+
+    if (tracing_state.get_trace_filter().is_muted()) {
+        return;
+    }
+
     EnvironmentTable& env_table = tracing_state.get_environment_table();
 
     Environment* env = env_table.insert(environment);
@@ -2691,17 +2905,30 @@ void eval_call_entry(instrumentr_tracer_t tracer,
                      instrumentr_value_t expression,
                      instrumentr_environment_t environment) {
     TracingState& tracing_state = TracingState::lookup(state);
+
+    if (tracing_state.get_trace_filter().is_muted()) {
+        return;
+    }
+
     EnvironmentTable& env_table = tracing_state.get_environment_table();
     EvalTable& eval_table = tracing_state.get_eval_table();
+    EvalScopeStack& eval_scopes = tracing_state.get_eval_scopes();
     Backtrace& backtrace = tracing_state.get_backtrace();
-    const std::string bt = backtrace.to_string();
+    CallerStack& caller_stack = tracing_state.get_caller_stack();
+    int bt = backtrace.get_node_id();
 
-    instrumentr_call_stack_t call_stack =
-        instrumentr_state_get_call_stack(state);
+    std::vector<int>& slots = eval_scopes.prepare();
 
-    instrumentr_value_t value = instrumentr_environment_as_value(environment);
+    env_table.get_eval_scope(environment, slots);
 
-    bool direct = true;
+    eval_scopes.enter();
+
+    if (slots.empty()) {
+        return;
+    }
+
+    instrumentr_call_stack_t call_stack =
+        instrumentr_state_get_call_stack(state);
 
     int time = instrumentr_state_get_time(state);
 
@@ -2709,65 +2936,57 @@ void eval_call_entry(instrumentr_tracer_t tracer,
         instrumentr_sexp_to_string(instrumentr_value_get_sexp(expression), true)
             .front();
 
-    while (instrumentr_value_is_environment(value)) {
-        instrumentr_environment_t envir =
-            instrumentr_value_as_environment(value);
+    /* the callers are the same for every environment of the scope */
+    int source_fun_id_1 = NA_INTEGER;
+    int source_call_id_1 = NA_INTEGER;
+    int source_fun_id_2 = NA_INTEGER;
+    int source_call_id_2 = NA_INTEGER;
+    int source_fun_id_3 = NA_INTEGER;
+    int source_call_id_3 = NA_INTEGER;
+    int source_fun_id_4 = NA_INTEGER;
+    int source_call_id_4 = NA_INTEGER;
+    int frame_index = 1;
 
-        auto type = instrumentr_environment_get_type(envir);
+    get_four_caller_info(caller_stack,
+                         call_stack,
+                         source_fun_id_1,
+                         source_call_id_1,
+                         source_fun_id_2,
+                         source_call_id_2,
+                         source_fun_id_3,
+                         source_call_id_3,
+                         source_fun_id_4,
+                         source_call_id_4,
+                         frame_index);
 
-        if (type == INSTRUMENTR_ENVIRONMENT_TYPE_NAMESPACE ||
-            type == INSTRUMENTR_ENVIRONMENT_TYPE_PACKAGE) {
-            break;
-        }
+    bool direct = true;
 
-        Environment* env = env_table.insert(envir);
-        env->push_eval();
+    for (int slot: slots) {
+        Environment* env = env_table.get(slot);
+        env->count_eval();
 
         if (direct) {
-            env->add_event("EvalEntryDirect");
+            env->add_event(ENV_EVENT_EVAL_ENTRY_DIRECT);
         } else {
-            env->add_event("EvalEntryIndirect");
-        }
-
-        int source_fun_id_1 = NA_INTEGER;
-        int source_call_id_1 = NA_INTEGER;
-        int source_fun_id_2 = NA_INTEGER;
-        int source_call_id_2 = NA_INTEGER;
-        int source_fun_id_3 = NA_INTEGER;
-        int source_call_id_3 = NA_INTEGER;
-        int source_fun_id_4 = NA_INTEGER;
-        int source_call_id_4 = NA_INTEGER;
-        int frame_index = 1;
-
-        get_four_caller_info(call_stack,
-                             source_fun_id_1,
-                             source_call_id_1,
-                             source_fun_id_2,
-                             source_call_id_2,
-                             source_fun_id_3,
-                             source_call_id_3,
-                             source_fun_id_4,
-                             source_call_id_4,
-                             frame_index);
-
-        Eval* eval = new Eval(time,
-                              env->get_id(),
-                              direct,
-                              expr,
-                              source_fun_id_1,
-                              source_call_id_1,
-                              source_fun_id_2,
-                              source_call_id_2,
-                              source_fun_id_3,
-                              source_call_id_3,
-                              source_fun_id_4,
-                              source_call_id_4,
-                              bt);
+            env->add_event(ENV_EVENT_EVAL_ENTRY_INDIRECT);
+        }
+
+        Eval* eval = eval_table.create(time,
+                                       env->get_id(),
+                                       direct,
+                                       expr,
+                                       source_fun_id_1,
+                                       source_call_id_1,
+                                       source_fun_id_2,
+                                       source_call_id_2,
+                                       source_fun_id_3,
+                                       source_call_id_3,
+                                       source_fun_id_4,
+                                       source_call_id_4,
+                                       bt);
 
         eval_table.insert(eval);
 
-        value = instrumentr_environment_get_parent(envir);
-
         direct = false;
     }
 }
@@ -2780,35 +2999,27 @@ void eval_call_exit(instrumentr_tracer_t tracer,
                     instrumentr_environment_t environment,
                     instrumentr_value_t result) {
     TracingState& tracing_state = TracingState::lookup(state);
-    EnvironmentTable& env_table = tracing_state.get_environment_table();
 
-    instrumentr_value_t value = instrumentr_environment_as_value(environment);
-
-    bool direct = true;
-
-    while (instrumentr_value_is_environment(value)) {
-        instrumentr_environment_t envir =
-            instrumentr_value_as_environment(value);
+    if (tracing_state.get_trace_filter().is_muted()) {
+        return;
+    }
 
-        auto type = instrumentr_environment_get_type(envir);
+    EnvironmentTable& env_table = tracing_state.get_environment_table();
 
-        if (type == INSTRUMENTR_ENVIRONMENT_TYPE_NAMESPACE ||
-            type == INSTRUMENTR_ENVIRONMENT_TYPE_PACKAGE) {
-            break;
-        }
+    /* evals exit in reverse order of entry */
+    const std::vector<int>& slots = tracing_state.get_eval_scopes().exit();
 
-        Environment* env = env_table.insert(envir);
+    bool direct = true;
 
-        env->pop_eval();
+    for (int slot: slots) {
+        Environment* env = env_table.get(slot);
 
         if (direct) {
-            env->add_event("EvalExitDirect");
+            env->add_event(ENV_EVENT_EVAL_EXIT_DIRECT);
         } else {
-            env->add_event("EvalExitIndirect");
+            env->add_event(ENV_EVENT_EVAL_EXIT_INDIRECT);
         }
 
-        value = instrumentr_environment_get_parent(envir);
-
         direct = false;
     }
 }
@@ -2820,11 +3031,17 @@ void substitute_call_entry(instrumentr_tracer_t tracer,
                            instrumentr_value_t expression,
                            instrumentr_environment_t environment) {
     TracingState& tracing_state = TracingState::lookup(state);
+
+    if (tracing_state.get_trace_filter().is_muted()) {
+        return;
+    }
+
     EnvironmentTable& env_table = tracing_state.get_environment_table();
     EnvironmentAccessTable& env_access_table =
         tracing_state.get_environment_access_table();
 
     Backtrace& backtrace = tracing_state.get_backtrace();
+    CallerStack& caller_stack = tracing_state.get_caller_stack();
 
     int time = instrumentr_state_get_time(state);
     int depth = NA_INTEGER;
@@ -2842,7 +3059,8 @@ void substitute_call_entry(instrumentr_tracer_t tracer,
     int source_call_id_4 = NA_INTEGER;
     int frame_index = 1;
 
-    get_four_caller_info(call_stack,
+    get_four_caller_info(caller_stack,
+                         call_stack,
                          source_fun_id_1,
                          source_call_id_1,
                          source_fun_id_2,
@@ -2854,10 +3072,10 @@ void substitute_call_entry(instrumentr_tracer_t tracer,
                          frame_index);
 
     Environment* env = env_table.insert(environment);
-    env->add_event("substitute");
+    env->add_event(ENV_EVENT_SUBSTITUTE);
 
     EnvironmentAccess* env_access =
-        new EnvironmentAccess(time, depth, "substitute");
+        env_access_table.create(time, depth, "substitute");
 
     env_access->set_result_env("environment", env->get_id());
 
@@ -2870,7 +3088,7 @@ void substitute_call_entry(instrumentr_tracer_t tracer,
                            source_fun_id_4,
                            source_call_id_4);
 
-    env_access->set_backtrace(backtrace.to_string());
+    env_access->set_backtrace(backtrace.get_node_id());
 
     env_access_table.insert(env_access);
 }
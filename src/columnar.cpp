@@ -0,0 +1,238 @@
+#include "columnar.h"
+#include "TableReader.h"
+#include "TableStream.h"
+#include "utilities.h"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+/* large tables are written in chunks so that the string buffers of a
+   single chunk stay small. */
+const int WRITE_CHUNK_SIZE = 65536;
+
+static ColumnType get_column_type(SEXP r_column) {
+    switch (TYPEOF(r_column)) {
+    case INTSXP:
+        return ColumnType::Integer;
+    case LGLSXP:
+        return ColumnType::Logical;
+    case REALSXP:
+        return ColumnType::Double;
+    case STRSXP:
+        return ColumnType::String;
+    default:
+        throw std::runtime_error(std::string("cannot write column of type ") +
+                                 type2char(TYPEOF(r_column)));
+    }
+}
+
+void write_data_frame(const std::string& filepath, SEXP r_data_frame) {
+    int column_count = Rf_length(r_data_frame);
+    int row_count = column_count == 0 ? 0 : LENGTH(VECTOR_ELT(r_data_frame, 0));
+    SEXP r_names = getAttrib(r_data_frame, R_NamesSymbol);
+
+    TableSchema schema;
+
+    for (int column = 0; column < column_count; ++column) {
+        schema.names.push_back(CHAR(STRING_ELT(r_names, column)));
+        schema.types.push_back(
+            get_column_type(VECTOR_ELT(r_data_frame, column)));
+    }
+
+    TableFile file(filepath, schema);
+    TableChunk chunk;
+
+    for (int start = 0; start < row_count; start += WRITE_CHUNK_SIZE) {
+        int end = std::min(start + WRITE_CHUNK_SIZE, row_count);
+
+        chunk.row_count = end - start;
+        chunk.columns.clear();
+        chunk.columns.resize(column_count);
+
+        for (int column = 0; column < column_count; ++column) {
+            SEXP r_column = VECTOR_ELT(r_data_frame, column);
+            TableColumn& output = chunk.columns[column];
+            output.type = schema.types[column];
+
+            if (output.type == ColumnType::Double) {
+                const double* reals = REAL(r_column);
+                output.reals.assign(reals + start, reals + end);
+                continue;
+            }
+
+            if (output.type != ColumnType::String) {
+                const int* values = TYPEOF(r_column) == INTSXP
+                                        ? INTEGER(r_column)
+                                        : LOGICAL(r_column);
+                output.values.assign(values + start, values + end);
+                continue;
+            }
+
+            output.values.reserve(end - start);
+
+            for (int row = start; row < end; ++row) {
+                SEXP r_char = STRING_ELT(r_column, row);
+                if (r_char == NA_STRING) {
+                    output.values.push_back(-1);
+                } else {
+                    const char* value = CHAR(r_char);
+                    std::size_t size = std::strlen(value);
+                    output.values.push_back(size);
+                    output.bytes.append(value, size);
+                }
+            }
+        }
+
+        file.write_chunk(chunk);
+    }
+
+    file.close();
+}
+
+static SEXPTYPE get_sexp_type(ColumnType type) {
+    switch (type) {
+    case ColumnType::Integer:
+        return INTSXP;
+    case ColumnType::Logical:
+        return LGLSXP;
+    case ColumnType::Double:
+        return REALSXP;
+    default:
+        return STRSXP;
+    }
+}
+
+/* Copies the numeric columns of a table file into the preallocated R
+   vectors. String columns are collected as lengths and bytes since making
+   their CHARSXPs allocates, and an allocation failure would longjmp over
+   the reader and leak its mapping. */
+static void read_columns(const std::string& filepath,
+                         const TableSchema& schema,
+                         std::size_t row_count,
+                         const std::vector<SEXP>& columns,
+                         std::vector<TableColumn>& strings) {
+    TableReader reader(filepath);
+
+    int column_count = schema.types.size();
+    std::size_t offset = 0;
+    TableChunkView chunk;
+
+    strings.resize(column_count);
+
+    while (reader.next_chunk(chunk)) {
+        if (offset + chunk.row_count > row_count) {
+            throw std::runtime_error(filepath + " changed while reading");
+        }
+
+        for (int column = 0; column < column_count; ++column) {
+            SEXP r_column = columns[column];
+
+            if (schema.types[column] == ColumnType::Double) {
+                std::memcpy(REAL(r_column) + offset,
+                            chunk.reals[column],
+                            chunk.row_count * sizeof(double));
+                continue;
+            }
+
+            if (schema.types[column] != ColumnType::String) {
+                int* output = TYPEOF(r_column) == INTSXP ? INTEGER(r_column)
+                                                         : LOGICAL(r_column);
+                std::memcpy(output + offset,
+                            chunk.values[column],
+                            chunk.row_count * sizeof(std::int32_t));
+                continue;
+            }
+
+            TableColumn& output = strings[column];
+            std::size_t size = 0;
+
+            for (std::uint32_t row = 0; row < chunk.row_count; ++row) {
+                std::int32_t length;
+                std::memcpy(&length,
+                            chunk.values[column] + row,
+                            sizeof(length));
+                output.values.push_back(length);
+                size += length == -1 ? 0 : length;
+            }
+
+            output.bytes.append(chunk.bytes[column], size);
+        }
+
+        offset += chunk.row_count;
+    }
+
+    if (offset != row_count) {
+        throw std::runtime_error(filepath + " changed while reading");
+    }
+}
+
+SEXP r_envtracer_read_table(SEXP r_filepath) {
+    std::string filepath = CHAR(STRING_ELT(r_filepath, 0));
+    TableSchema schema;
+    std::size_t row_count = 0;
+    std::string message;
+
+    /* R errors and allocation failures longjmp over destructors, so the
+       file is only mapped while no R allocation is made */
+    try {
+        TableReader reader(filepath);
+        schema = reader.get_schema();
+        row_count = reader.count_rows();
+    } catch (const std::exception& e) {
+        message = e.what();
+    }
+
+    if (!message.empty()) {
+        Rf_error("%s", message.c_str());
+    }
+
+    int column_count = schema.types.size();
+    std::vector<SEXP> columns;
+
+    for (int column = 0; column < column_count; ++column) {
+        columns.push_back(PROTECT(
+            allocVector(get_sexp_type(schema.types[column]), row_count)));
+    }
+
+    std::vector<TableColumn> strings;
+
+    if (column_count != 0) {
+        try {
+            read_columns(filepath, schema, row_count, columns, strings);
+        } catch (const std::exception& e) {
+            message = e.what();
+        }
+    }
+
+    if (!message.empty()) {
+        UNPROTECT(column_count);
+        Rf_error("%s", message.c_str());
+    }
+
+    for (int column = 0; column < column_count; ++column) {
+        if (schema.types[column] != ColumnType::String) {
+            continue;
+        }
+
+        SEXP r_column = columns[column];
+        const TableColumn& input = strings[column];
+        const char* bytes = input.bytes.data();
+
+        for (std::size_t row = 0; row < input.values.size(); ++row) {
+            std::int32_t length = input.values[row];
+            if (length == -1) {
+                SET_STRING_ELT(r_column, row, NA_STRING);
+            } else {
+                SET_STRING_ELT(
+                    r_column, row, mkCharLenCE(bytes, length, CE_UTF8));
+                bytes += length;
+            }
+        }
+    }
+
+    SEXP r_data_frame = create_data_frame(schema.names, columns);
+
+    UNPROTECT(column_count);
+
+    return r_data_frame;
+}
@@ -0,0 +1,15 @@
+#ifndef ENVTRACER_COLUMNAR_H
+#define ENVTRACER_COLUMNAR_H
+
+#include "Rincludes.h"
+#include <string>
+
+extern "C" {
+SEXP r_envtracer_read_table(SEXP r_filepath);
+}
+
+/* writes a data frame of integer, logical, double and character columns
+   to a table file, see TableStream.h for the format. */
+void write_data_frame(const std::string& filepath, SEXP r_data_frame);
+
+#endif /* ENVTRACER_COLUMNAR_H */
@@ -3,6 +3,8 @@
 #include <Rinternals.h>
 #include <stdlib.h> // for NULL
 #include "tracer.h"
+#include "columnar.h"
+#include "merge.h"
 #include <instrumentr/instrumentr.h>
 #include "utilities.h"
 
@@ -14,7 +16,9 @@ SEXP R_WhichSymbol;
 SEXP R_NSymbol;
 
 static const R_CallMethodDef callMethods[] = {
-    {"envtracer_tracer_create", (DL_FUNC) &r_envtracer_tracer_create, 0},
+    {"envtracer_tracer_create", (DL_FUNC) &r_envtracer_tracer_create, 1},
+    {"envtracer_read_table", (DL_FUNC) &r_envtracer_read_table, 1},
+    {"envtracer_merge_shards", (DL_FUNC) &r_envtracer_merge_shards, 4},
     {NULL, NULL, 0}};
 
 void R_init_envtracer(DllInfo* dll) {
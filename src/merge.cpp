@@ -0,0 +1,36 @@
+#include "merge.h"
+#include "ShardMerger.h"
+#include <string>
+#include <vector>
+
+SEXP r_envtracer_merge_shards(SEXP r_shards,
+                              SEXP r_output,
+                              SEXP r_threads,
+                              SEXP r_memory_budget) {
+    std::vector<std::string> shards;
+
+    for (int i = 0; i < Rf_length(r_shards); ++i) {
+        shards.push_back(CHAR(STRING_ELT(r_shards, i)));
+    }
+
+    std::string output = CHAR(STRING_ELT(r_output, 0));
+    int threads = asInteger(r_threads);
+    double memory_budget = asReal(r_memory_budget);
+    std::string message;
+
+    /* R errors longjmp over destructors, so they are only raised once the
+       merger is gone */
+    try {
+        ShardMerger merger(
+            shards, output, threads, static_cast<std::size_t>(memory_budget));
+        merger.merge();
+    } catch (const std::exception& e) {
+        message = e.what();
+    }
+
+    if (!message.empty()) {
+        Rf_error("%s", message.c_str());
+    }
+
+    return R_NilValue;
+}
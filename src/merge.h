@@ -0,0 +1,13 @@
+#ifndef ENVTRACER_MERGE_H
+#define ENVTRACER_MERGE_H
+
+#include "Rincludes.h"
+
+extern "C" {
+SEXP r_envtracer_merge_shards(SEXP r_shards,
+                              SEXP r_output,
+                              SEXP r_threads,
+                              SEXP r_memory_budget);
+}
+
+#endif /* ENVTRACER_MERGE_H */
@@ -0,0 +1,221 @@
+/* Offline replay of an event log recorded with trace_expr(record = ...).
+
+   Runs a stand-in for the callback analyses on the logged events without
+   R and writes its tables to the output directory:
+
+   events.tbl     callback, count
+   functions.tbl  fun_id, name, call_count, max_depth
+   variables.tbl  callback, symbol, count
+
+   The replay throughput is reported on stderr so that analyses can be
+   benchmarked at disk speed.
+
+   usage: envtracer-replay <log> <output dir> */
+
+#include "../EventReplay.h"
+#include "../TableStream.h"
+#include <chrono>
+#include <cstdio>
+#include <unordered_map>
+
+const std::string ENVTRACER_NA_STRING("***ENVTRACER_NA_STRING***");
+
+enum replay_handler_t {
+    REPLAY_HANDLER_OTHER = 0,
+    REPLAY_HANDLER_CLOSURE_ENTRY,
+    REPLAY_HANDLER_VARIABLE
+};
+
+class ReplayAnalysis {
+  public:
+    explicit ReplayAnalysis(EventLogReader& reader): reader_(reader) {
+    }
+
+    int get_handler(const std::string& callback) {
+        int handler = event_names_.size();
+        event_names_.push_back(callback);
+        event_counts_.push_back(0);
+        event_kinds_.push_back(get_kind_(callback));
+        return handler;
+    }
+
+    void on_event(int handler, const LogEvent& event, int stack_size) {
+        ++event_counts_[handler];
+
+        switch (event_kinds_[handler]) {
+        case REPLAY_HANDLER_CLOSURE_ENTRY:
+            enter_closure_(event, stack_size);
+            break;
+        case REPLAY_HANDLER_VARIABLE:
+            access_variable_(handler, event);
+            break;
+        default:
+            break;
+        }
+    }
+
+    void write(const std::string& dir) const {
+        write_events_(dir + "/events.tbl");
+        write_functions_(dir + "/functions.tbl");
+        write_variables_(dir + "/variables.tbl");
+    }
+
+  private:
+    struct FunctionCount {
+        std::uint32_t name;
+        int call_count;
+        int max_depth;
+    };
+
+    static int get_kind_(const std::string& callback) {
+        if (callback == "closure_call_entry_callback") {
+            return REPLAY_HANDLER_CLOSURE_ENTRY;
+        }
+        if (callback == "variable_lookup" || callback == "variable_exists" ||
+            callback == "variable_assign" || callback == "variable_define" ||
+            callback == "variable_remove") {
+            return REPLAY_HANDLER_VARIABLE;
+        }
+        return REPLAY_HANDLER_OTHER;
+    }
+
+    static const LogOperand* find_(const LogEvent& event,
+                                   LogOperandKind kind) {
+        for (const LogOperand& operand: event.operands) {
+            if (operand.kind == kind) {
+                return &operand;
+            }
+        }
+        return nullptr;
+    }
+
+    void enter_closure_(const LogEvent& event, int stack_size) {
+        const LogOperand* closure = find_(event, LogOperandKind::Closure);
+        if (closure == nullptr) {
+            return;
+        }
+
+        auto result = functions_.emplace(
+            closure->id, FunctionCount{closure->name, 0, 0});
+        FunctionCount& function = result.first->second;
+        ++function.call_count;
+        if (stack_size > function.max_depth) {
+            function.max_depth = stack_size;
+        }
+    }
+
+    void access_variable_(int handler, const LogEvent& event) {
+        const LogOperand* symbol = find_(event, LogOperandKind::Symbol);
+        if (symbol == nullptr) {
+            return;
+        }
+
+        std::uint64_t key =
+            (static_cast<std::uint64_t>(handler) << 32) | symbol->name;
+        ++variables_[key];
+    }
+
+    void put_name_(TableStream& stream, std::uint32_t name) const {
+        if (name == ENVTRACER_LOG_NO_NAME) {
+            stream.put_na_string();
+        } else {
+            stream.put_string(reader_.get_name(name));
+        }
+    }
+
+    void write_events_(const std::string& filepath) const {
+        StreamWriter writer;
+        TableStream stream(writer,
+                           filepath,
+                           {{"callback", "count"},
+                            {ColumnType::String, ColumnType::Double}},
+                           65536);
+
+        for (std::size_t index = 0; index < event_names_.size(); ++index) {
+            stream.put_string(event_names_[index]);
+            stream.put_double(event_counts_[index]);
+            stream.end_row();
+        }
+
+        stream.close();
+    }
+
+    void write_functions_(const std::string& filepath) const {
+        StreamWriter writer;
+        TableStream stream(writer,
+                           filepath,
+                           {{"fun_id", "name", "call_count", "max_depth"},
+                            {ColumnType::Integer,
+                             ColumnType::String,
+                             ColumnType::Integer,
+                             ColumnType::Integer}},
+                           65536);
+
+        for (const auto& entry: functions_) {
+            stream.put_int(entry.first);
+            put_name_(stream, entry.second.name);
+            stream.put_int(entry.second.call_count);
+            stream.put_int(entry.second.max_depth);
+            stream.end_row();
+        }
+
+        stream.close();
+    }
+
+    void write_variables_(const std::string& filepath) const {
+        StreamWriter writer;
+        TableStream stream(
+            writer,
+            filepath,
+            {{"callback", "symbol", "count"},
+             {ColumnType::String, ColumnType::String, ColumnType::Double}},
+            65536);
+
+        for (const auto& entry: variables_) {
+            stream.put_string(event_names_[entry.first >> 32]);
+            put_name_(stream, entry.first & 0xFFFFFFFF);
+            stream.put_double(entry.second);
+            stream.end_row();
+        }
+
+        stream.close();
+    }
+
+    EventLogReader& reader_;
+    std::vector<std::string> event_names_;
+    std::vector<double> event_counts_;
+    std::vector<int> event_kinds_;
+    std::unordered_map<int, FunctionCount> functions_;
+    std::unordered_map<std::uint64_t, double> variables_;
+};
+
+int main(int argc, char* argv[]) {
+    if (argc != 3) {
+        std::fprintf(stderr, "usage: %s <log> <output dir>\n", argv[0]);
+        return 2;
+    }
+
+    try {
+        EventLogReader reader(argv[1]);
+        ReplayAnalysis analysis(reader);
+
+        auto start = std::chrono::steady_clock::now();
+        std::size_t count = replay_event_log(reader, analysis);
+        std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+
+        analysis.write(argv[2]);
+
+        std::fprintf(stderr,
+                     "%s: replayed %zu events in %.3f s (%.0f events/s)\n",
+                     argv[0],
+                     count,
+                     elapsed.count(),
+                     elapsed.count() > 0 ? count / elapsed.count() : 0.0);
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "%s: %s\n", argv[0], e.what());
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,132 @@
+#ifndef ENVTRACER_STRUCTURAL_HASH_H
+#define ENVTRACER_STRUCTURAL_HASH_H
+
+#include "Rincludes.h"
+#include <cstdint>
+#include <cstring>
+#include <functional>
+
+inline std::size_t combine_hash(std::size_t seed, std::size_t value) {
+    return seed ^ (value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2));
+}
+
+/* FNV-1a */
+inline std::size_t
+hash_bytes(std::size_t seed, const void* bytes, std::size_t size) {
+    const unsigned char* data = static_cast<const unsigned char*>(bytes);
+    std::uint64_t hash = 14695981039346656037ULL;
+    for (std::size_t i = 0; i < size; ++i) {
+        hash = (hash ^ data[i]) * 1099511628211ULL;
+    }
+    return combine_hash(seed, hash);
+}
+
+/* Constants in parsed code are scalars. Longer vectors and lists in an
+   expression are values inlined by do.call or as.call, such as the data
+   of do.call(rbind, dfs); they are only compared by type and length so
+   that matching a call does not walk its data. */
+inline bool is_inlined_value(SEXP r_value) {
+    switch (TYPEOF(r_value)) {
+    case INTSXP:
+    case LGLSXP:
+    case REALSXP:
+    case CPLXSXP:
+    case STRSXP:
+    case RAWSXP:
+        return XLENGTH(r_value) > 1;
+    case VECSXP:
+    case EXPRSXP:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/* hash of the language structure of an expression. Scalar constants are
+   hashed by value and inlined values by type and length. Symbols are
+   interned so they are hashed by address, as are bytecode, closures,
+   environments and other objects. Expressions with the same structure
+   have equal hashes. */
+inline std::size_t hash_sexp_structure(SEXP r_value, std::size_t seed) {
+    while (true) {
+        int type = TYPEOF(r_value);
+        seed = combine_hash(seed, type);
+
+        if (type == LISTSXP || type == LANGSXP) {
+            seed = combine_hash(seed, std::hash<SEXP>()(TAG(r_value)));
+            seed = hash_sexp_structure(CAR(r_value), seed);
+            r_value = CDR(r_value);
+            continue;
+        }
+
+        else if (is_inlined_value(r_value)) {
+            seed = combine_hash(seed, XLENGTH(r_value));
+        }
+
+        else if (type == INTSXP || type == LGLSXP) {
+            seed = hash_bytes(
+                seed, INTEGER(r_value), XLENGTH(r_value) * sizeof(int));
+        }
+
+        else if (type == REALSXP) {
+            seed = hash_bytes(
+                seed, REAL(r_value), XLENGTH(r_value) * sizeof(double));
+        }
+
+        else if (type == STRSXP) {
+            for (R_xlen_t i = 0; i < XLENGTH(r_value); ++i) {
+                const char* str = CHAR(STRING_ELT(r_value, i));
+                seed = hash_bytes(seed, str, std::strlen(str));
+            }
+        }
+
+        else {
+            seed = combine_hash(seed, std::hash<SEXP>()(r_value));
+        }
+
+        return seed;
+    }
+}
+
+/* true if both expressions have the same language structure, comparing
+   their leaves as hash_sexp_structure hashes them */
+inline bool same_sexp_structure(SEXP r_left, SEXP r_right) {
+    while (r_left != r_right) {
+        int type = TYPEOF(r_left);
+
+        if (type != TYPEOF(r_right)) {
+            return false;
+        }
+
+        if (type == LISTSXP || type == LANGSXP) {
+            if (TAG(r_left) != TAG(r_right) ||
+                !same_sexp_structure(CAR(r_left), CAR(r_right))) {
+                return false;
+            }
+            r_left = CDR(r_left);
+            r_right = CDR(r_right);
+            continue;
+        }
+
+        if (is_inlined_value(r_left) || is_inlined_value(r_right)) {
+            return is_inlined_value(r_left) && is_inlined_value(r_right) &&
+                   XLENGTH(r_left) == XLENGTH(r_right);
+        }
+
+        switch (type) {
+        case INTSXP:
+        case LGLSXP:
+        case REALSXP:
+        case CPLXSXP:
+        case STRSXP:
+        case RAWSXP:
+            return R_compute_identical(r_left, r_right, 16);
+        default:
+            return false;
+        }
+    }
+
+    return true;
+}
+
+#endif /* ENVTRACER_STRUCTURAL_HASH_H */
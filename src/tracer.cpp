@@ -1,180 +1,171 @@
 #include "tracer.h"
 #include "TracingState.h"
 #include "callbacks.h"
+#include "EventRecorder.h"
 #include <instrumentr/instrumentr.h>
+#include <unordered_map>
 
-SEXP r_envtracer_tracer_create() {
-    instrumentr_tracer_t tracer = instrumentr_tracer_create();
-
-    instrumentr_callback_t callback;
-
-    callback = instrumentr_callback_create_from_c_function(
-        (void*) (tracing_entry_callback), INSTRUMENTR_EVENT_TRACING_ENTRY);
-    instrumentr_tracer_set_callback(tracer, callback);
-    instrumentr_object_release(callback);
-
-    callback = instrumentr_callback_create_from_c_function(
-        (void*) (tracing_exit_callback), INSTRUMENTR_EVENT_TRACING_EXIT);
-    instrumentr_tracer_set_callback(tracer, callback);
-    instrumentr_object_release(callback);
-
-    callback = instrumentr_callback_create_from_c_function(
-        (void*) (package_load_callback), INSTRUMENTR_EVENT_PACKAGE_LOAD);
-    instrumentr_tracer_set_callback(tracer, callback);
-    instrumentr_object_release(callback);
-
-    callback = instrumentr_callback_create_from_c_function(
-        (void*) (package_attach_callback), INSTRUMENTR_EVENT_PACKAGE_ATTACH);
-    instrumentr_tracer_set_callback(tracer, callback);
-    instrumentr_object_release(callback);
-
-    callback = instrumentr_callback_create_from_c_function(
-        (void*) (builtin_call_entry_callback),
-        INSTRUMENTR_EVENT_BUILTIN_CALL_ENTRY);
-    instrumentr_tracer_set_callback(tracer, callback);
-    instrumentr_object_release(callback);
-
-    callback = instrumentr_callback_create_from_c_function(
-        (void*) (builtin_call_exit_callback),
-        INSTRUMENTR_EVENT_BUILTIN_CALL_EXIT);
-    instrumentr_tracer_set_callback(tracer, callback);
-    instrumentr_object_release(callback);
-
-    callback = instrumentr_callback_create_from_c_function(
-        (void*) (special_call_exit_callback),
-        INSTRUMENTR_EVENT_SPECIAL_CALL_EXIT);
-    instrumentr_tracer_set_callback(tracer, callback);
-    instrumentr_object_release(callback);
-
-    callback = instrumentr_callback_create_from_c_function(
-        (void*) (closure_call_entry_callback),
-        INSTRUMENTR_EVENT_CLOSURE_CALL_ENTRY);
-    instrumentr_tracer_set_callback(tracer, callback);
-    instrumentr_object_release(callback);
-
-    callback = instrumentr_callback_create_from_c_function(
-        (void*) (closure_call_exit_callback),
-        INSTRUMENTR_EVENT_CLOSURE_CALL_EXIT);
-    instrumentr_tracer_set_callback(tracer, callback);
-    instrumentr_object_release(callback);
-
-    // callback = instrumentr_callback_create_from_c_function(
-    //     (void*) (promise_force_entry_callback),
-    //     INSTRUMENTR_EVENT_PROMISE_FORCE_ENTRY);
-    // instrumentr_tracer_set_callback(tracer, callback);
-    // instrumentr_object_release(callback);
-    //
-    callback = instrumentr_callback_create_from_c_function(
-        (void*) (promise_force_exit_callback),
-        INSTRUMENTR_EVENT_PROMISE_FORCE_EXIT);
-    instrumentr_tracer_set_callback(tracer, callback);
-    instrumentr_object_release(callback);
-    //
-    // callback = instrumentr_callback_create_from_c_function(
-    //     (void*) (promise_value_lookup_callback),
-    //     INSTRUMENTR_EVENT_PROMISE_VALUE_LOOKUP);
-    // instrumentr_tracer_set_callback(tracer, callback);
-    // instrumentr_object_release(callback);
-    //
-    // callback = instrumentr_callback_create_from_c_function(
-    //     (void*) (promise_substitute_callback),
-    //     INSTRUMENTR_EVENT_PROMISE_SUBSTITUTE);
-    // instrumentr_tracer_set_callback(tracer, callback);
-    // instrumentr_object_release(callback);
-    //
-    // callback = instrumentr_callback_create_from_c_function(
-    //     (void*) (promise_expression_lookup_callback),
-    //     INSTRUMENTR_EVENT_PROMISE_EXPRESSION_LOOKUP);
-    // instrumentr_tracer_set_callback(tracer, callback);
-    // instrumentr_object_release(callback);
-
-    callback = instrumentr_callback_create_from_c_function(
-        (void*) (variable_lookup), INSTRUMENTR_EVENT_VARIABLE_LOOKUP);
-    instrumentr_tracer_set_callback(tracer, callback);
-    instrumentr_object_release(callback);
-
-    callback = instrumentr_callback_create_from_c_function(
-        (void*) (variable_exists), INSTRUMENTR_EVENT_VARIABLE_EXISTS);
-    instrumentr_tracer_set_callback(tracer, callback);
-    instrumentr_object_release(callback);
-
-    // callback = instrumentr_callback_create_from_c_function(
-    //     (void*) (function_context_lookup),
-    //     INSTRUMENTR_EVENT_FUNCTION_CONTEXT_LOOKUP);
-    // instrumentr_tracer_set_callback(tracer, callback);
-    // instrumentr_object_release(callback);
+/* options of tracers that have been created but not finished tracing yet */
+static std::unordered_map<instrumentr_tracer_t, TracingOptions> options_table;
 
-    callback = instrumentr_callback_create_from_c_function(
-        (void*) (variable_assign), INSTRUMENTR_EVENT_VARIABLE_ASSIGNMENT);
-    instrumentr_tracer_set_callback(tracer, callback);
-    instrumentr_object_release(callback);
-
-    callback = instrumentr_callback_create_from_c_function(
-        (void*) (variable_define), INSTRUMENTR_EVENT_VARIABLE_DEFINITION);
-    instrumentr_tracer_set_callback(tracer, callback);
-    instrumentr_object_release(callback);
-
-    callback = instrumentr_callback_create_from_c_function(
-        (void*) (variable_remove), INSTRUMENTR_EVENT_VARIABLE_REMOVAL);
-    instrumentr_tracer_set_callback(tracer, callback);
-    instrumentr_object_release(callback);
-
-    callback = instrumentr_callback_create_from_c_function(
-        (void*) (environment_ls), INSTRUMENTR_EVENT_ENVIRONMENT_LS);
-    instrumentr_tracer_set_callback(tracer, callback);
-    instrumentr_object_release(callback);
-
-    callback = instrumentr_callback_create_from_c_function(
-        (void*) (value_finalize), INSTRUMENTR_EVENT_VALUE_FINALIZE);
-    instrumentr_tracer_set_callback(tracer, callback);
-    instrumentr_object_release(callback);
-
-    callback = instrumentr_callback_create_from_c_function(
-        (void*) (trace_error), INSTRUMENTR_EVENT_ERROR);
-    instrumentr_tracer_set_callback(tracer, callback);
-    instrumentr_object_release(callback);
-
-    callback = instrumentr_callback_create_from_c_function(
-        (void*) (attribute_set_callback), INSTRUMENTR_EVENT_ATTRIBUTE_SET);
-    instrumentr_tracer_set_callback(tracer, callback);
-    instrumentr_object_release(callback);
-
-    callback = instrumentr_callback_create_from_c_function(
-        (void*) (gc_allocation_callback), INSTRUMENTR_EVENT_GC_ALLOCATION);
-    instrumentr_tracer_set_callback(tracer, callback);
-    instrumentr_object_release(callback);
-
-    callback = instrumentr_callback_create_from_c_function(
-        (void*) (use_method_entry_callback),
-        INSTRUMENTR_EVENT_USE_METHOD_ENTRY);
-    instrumentr_tracer_set_callback(tracer, callback);
-    instrumentr_object_release(callback);
+const TracingOptions& get_tracing_options(instrumentr_tracer_t tracer) {
+    return options_table[tracer];
+}
 
-    callback = instrumentr_callback_create_from_c_function(
-        (void*) (subset_or_subassign_callback), INSTRUMENTR_EVENT_SUBASSIGN);
-    instrumentr_tracer_set_callback(tracer, callback);
-    instrumentr_object_release(callback);
+void release_tracing_options(instrumentr_tracer_t tracer) {
+    options_table.erase(tracer);
+}
 
-    callback = instrumentr_callback_create_from_c_function(
-        (void*) (subset_or_subassign_callback), INSTRUMENTR_EVENT_SUBSET);
+static void set_callback(instrumentr_tracer_t tracer,
+                         void* function,
+                         instrumentr_event_t event) {
+    instrumentr_callback_t callback =
+        instrumentr_callback_create_from_c_function(function, event);
     instrumentr_tracer_set_callback(tracer, callback);
     instrumentr_object_release(callback);
+}
 
-    callback = instrumentr_callback_create_from_c_function(
-        (void*) (eval_call_entry), INSTRUMENTR_EVENT_EVAL_CALL_ENTRY);
-    instrumentr_tracer_set_callback(tracer, callback);
-    instrumentr_object_release(callback);
+SEXP r_envtracer_tracer_create(SEXP r_options) {
+    TracingOptions options = TracingOptions::from_sexp(r_options);
 
-    callback = instrumentr_callback_create_from_c_function(
-        (void*) (substitute_call_entry),
-        INSTRUMENTR_EVENT_SUBSTITUTE_CALL_ENTRY);
-    instrumentr_tracer_set_callback(tracer, callback);
-    instrumentr_object_release(callback);
+    instrumentr_tracer_t tracer = instrumentr_tracer_create();
 
-    callback = instrumentr_callback_create_from_c_function(
-        (void*) (eval_call_exit), INSTRUMENTR_EVENT_EVAL_CALL_EXIT);
-    instrumentr_tracer_set_callback(tracer, callback);
-    instrumentr_object_release(callback);
+    options_table[tracer] = options;
+
+    /* callbacks are only wrapped when self profiling or recording */
+    CallbackMode mode = {options.is_self_profiling(), options.is_recording()};
+
+    /* tracing, packages, calls and builtins are needed by every table */
+    set_callback(tracer,
+                 ENVTRACER_CALLBACK(mode, tracing_entry_callback),
+                 INSTRUMENTR_EVENT_TRACING_ENTRY);
+    set_callback(tracer,
+                 ENVTRACER_CALLBACK(mode, tracing_exit_callback),
+                 INSTRUMENTR_EVENT_TRACING_EXIT);
+    set_callback(tracer,
+                 ENVTRACER_CALLBACK(mode, package_load_callback),
+                 INSTRUMENTR_EVENT_PACKAGE_LOAD);
+    set_callback(tracer,
+                 ENVTRACER_CALLBACK(mode, package_attach_callback),
+                 INSTRUMENTR_EVENT_PACKAGE_ATTACH);
+    set_callback(tracer,
+                 ENVTRACER_CALLBACK(mode, builtin_call_entry_callback),
+                 INSTRUMENTR_EVENT_BUILTIN_CALL_ENTRY);
+    set_callback(tracer,
+                 ENVTRACER_CALLBACK(mode, builtin_call_exit_callback),
+                 INSTRUMENTR_EVENT_BUILTIN_CALL_EXIT);
+    set_callback(tracer,
+                 ENVTRACER_CALLBACK(mode, closure_call_entry_callback),
+                 INSTRUMENTR_EVENT_CLOSURE_CALL_ENTRY);
+    set_callback(tracer,
+                 ENVTRACER_CALLBACK(mode, closure_call_exit_callback),
+                 INSTRUMENTR_EVENT_CLOSURE_CALL_EXIT);
+
+    if (options.has_event(ANALYSIS_EVENT_SPECIAL)) {
+        set_callback(tracer,
+                     ENVTRACER_CALLBACK(mode, special_call_exit_callback),
+                     INSTRUMENTR_EVENT_SPECIAL_CALL_EXIT);
+    }
+
+    /* promise frames are pushed on the caller stack by these callbacks, so
+       they are registered for every profile; the rest of their work is
+       only done if promises are traced */
+    set_callback(tracer,
+                 ENVTRACER_CALLBACK(mode, promise_force_entry_callback),
+                 INSTRUMENTR_EVENT_PROMISE_FORCE_ENTRY);
+    set_callback(tracer,
+                 ENVTRACER_CALLBACK(mode, promise_force_exit_callback),
+                 INSTRUMENTR_EVENT_PROMISE_FORCE_EXIT);
+
+    if (options.has_event(ANALYSIS_EVENT_PROMISE)) {
+        // set_callback(tracer,
+        //              (void*) (promise_value_lookup_callback),
+        //              INSTRUMENTR_EVENT_PROMISE_VALUE_LOOKUP);
+        // set_callback(tracer,
+        //              (void*) (promise_substitute_callback),
+        //              INSTRUMENTR_EVENT_PROMISE_SUBSTITUTE);
+        // set_callback(tracer,
+        //              (void*) (promise_expression_lookup_callback),
+        //              INSTRUMENTR_EVENT_PROMISE_EXPRESSION_LOOKUP);
+    }
+
+    if (options.has_event(ANALYSIS_EVENT_VARIABLE)) {
+        set_callback(tracer,
+                     ENVTRACER_CALLBACK(mode, variable_lookup),
+                     INSTRUMENTR_EVENT_VARIABLE_LOOKUP);
+        set_callback(tracer,
+                     ENVTRACER_CALLBACK(mode, variable_exists),
+                     INSTRUMENTR_EVENT_VARIABLE_EXISTS);
+        // set_callback(tracer,
+        //              (void*) (function_context_lookup),
+        //              INSTRUMENTR_EVENT_FUNCTION_CONTEXT_LOOKUP);
+        set_callback(tracer,
+                     ENVTRACER_CALLBACK(mode, variable_assign),
+                     INSTRUMENTR_EVENT_VARIABLE_ASSIGNMENT);
+        set_callback(tracer,
+                     ENVTRACER_CALLBACK(mode, variable_define),
+                     INSTRUMENTR_EVENT_VARIABLE_DEFINITION);
+        set_callback(tracer,
+                     ENVTRACER_CALLBACK(mode, variable_remove),
+                     INSTRUMENTR_EVENT_VARIABLE_REMOVAL);
+        set_callback(tracer,
+                     ENVTRACER_CALLBACK(mode, environment_ls),
+                     INSTRUMENTR_EVENT_ENVIRONMENT_LS);
+    }
+
+    if (options.has_event(ANALYSIS_EVENT_VALUE_FINALIZE)) {
+        set_callback(tracer,
+                     ENVTRACER_CALLBACK(mode, value_finalize),
+                     INSTRUMENTR_EVENT_VALUE_FINALIZE);
+    }
+
+    if (options.has_event(ANALYSIS_EVENT_ERROR)) {
+        set_callback(tracer,
+                     ENVTRACER_CALLBACK(mode, trace_error),
+                     INSTRUMENTR_EVENT_ERROR);
+    }
+
+    if (options.has_event(ANALYSIS_EVENT_ATTRIBUTE_SET)) {
+        set_callback(tracer,
+                     ENVTRACER_CALLBACK(mode, attribute_set_callback),
+                     INSTRUMENTR_EVENT_ATTRIBUTE_SET);
+    }
+
+    if (options.has_event(ANALYSIS_EVENT_GC_ALLOCATION)) {
+        set_callback(tracer,
+                     ENVTRACER_CALLBACK(mode, gc_allocation_callback),
+                     INSTRUMENTR_EVENT_GC_ALLOCATION);
+    }
+
+    if (options.has_event(ANALYSIS_EVENT_USE_METHOD)) {
+        set_callback(tracer,
+                     ENVTRACER_CALLBACK(mode, use_method_entry_callback),
+                     INSTRUMENTR_EVENT_USE_METHOD_ENTRY);
+    }
+
+    if (options.has_event(ANALYSIS_EVENT_SUBSET)) {
+        set_callback(tracer,
+                     ENVTRACER_CALLBACK(mode, subset_or_subassign_callback),
+                     INSTRUMENTR_EVENT_SUBASSIGN);
+        set_callback(tracer,
+                     ENVTRACER_CALLBACK(mode, subset_or_subassign_callback),
+                     INSTRUMENTR_EVENT_SUBSET);
+    }
+
+    if (options.has_event(ANALYSIS_EVENT_EVAL)) {
+        set_callback(tracer,
+                     ENVTRACER_CALLBACK(mode, eval_call_entry),
+                     INSTRUMENTR_EVENT_EVAL_CALL_ENTRY);
+        set_callback(tracer,
+                     ENVTRACER_CALLBACK(mode, eval_call_exit),
+                     INSTRUMENTR_EVENT_EVAL_CALL_EXIT);
+    }
+
+    if (options.has_event(ANALYSIS_EVENT_SUBSTITUTE)) {
+        set_callback(tracer,
+                     ENVTRACER_CALLBACK(mode, substitute_call_entry),
+                     INSTRUMENTR_EVENT_SUBSTITUTE_CALL_ENTRY);
+    }
 
     SEXP r_tracer = instrumentr_tracer_wrap(tracer);
     instrumentr_object_release(tracer);
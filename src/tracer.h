@@ -2,9 +2,15 @@
 #define ENVTRACER_TRACER_H
 
 #include "Rincludes.h"
+#include "TracingOptions.h"
+#include <instrumentr/instrumentr.h>
 
 extern "C" {
-SEXP r_envtracer_tracer_create();
+SEXP r_envtracer_tracer_create(SEXP r_options);
 }
 
+const TracingOptions& get_tracing_options(instrumentr_tracer_t tracer);
+
+void release_tracing_options(instrumentr_tracer_t tracer);
+
 #endif /* ENVTRACER_TRACER_H */
@@ -1,4 +1,5 @@
 #include "utilities.h"
+#include <cstring>
 
 const std::string ENVTRACER_NA_STRING("***ENVTRACER_NA_STRING***");
 
@@ -14,6 +15,18 @@ std::string get_type_as_string(SEXP r_object) {
     return type2char(TYPEOF(r_object));
 }
 
+int get_sexp_typeof(SEXP r_value) {
+    return r_value == R_UnboundValue ? NA_INTEGER : TYPEOF(r_value);
+}
+
+std::string sexptype_to_string(int type) {
+    if (type == NA_INTEGER) {
+        return ENVTRACER_NA_STRING;
+    } else {
+        return type2char(type);
+    }
+}
+
 SEXP integer_vector_wrap(const std::vector<int>& vector) {
     int size = vector.size();
     SEXP r_vector = PROTECT(allocVector(INTSXP, size));
@@ -85,11 +98,10 @@ SEXP create_data_frame(const std::vector<std::string>& names,
 
     set_class(r_list, "data.frame");
 
-    SEXP r_row_names = PROTECT(allocVector(STRSXP, row_count));
-
-    for (int i = 0; i < row_count; ++i) {
-        SET_STRING_ELT(r_row_names, i, mkChar(std::to_string(i + 1).c_str()));
-    }
+    /* compact form of 1:row_count */
+    SEXP r_row_names = PROTECT(allocVector(INTSXP, 2));
+    INTEGER(r_row_names)[0] = NA_INTEGER;
+    INTEGER(r_row_names)[1] = -row_count;
 
     Rf_setAttrib(r_list, R_RowNamesSymbol, r_row_names);
 
@@ -98,10 +110,38 @@ SEXP create_data_frame(const std::vector<std::string>& names,
     return r_list;
 }
 
+SEXP get_list_element(SEXP r_list, const char* name) {
+    SEXP r_names = getAttrib(r_list, R_NamesSymbol);
+
+    for (int i = 0; i < Rf_length(r_list); ++i) {
+        if (strcmp(CHAR(STRING_ELT(r_names, i)), name) == 0) {
+            return VECTOR_ELT(r_list, i);
+        }
+    }
+
+    return R_NilValue;
+}
+
 SEXP make_char(const std::string& input) {
     return input == ENVTRACER_NA_STRING ? NA_STRING : mkChar(input.c_str());
 }
 
+SEXP CharCache::get(const std::string& input) {
+    if (input == ENVTRACER_NA_STRING) {
+        return NA_STRING;
+    }
+
+    auto iter = chars_.find(input);
+
+    if (iter != chars_.end()) {
+        return iter->second;
+    }
+
+    SEXP r_char = mkChar(input.c_str());
+    chars_.insert({input, r_char});
+    return r_char;
+}
+
 SEXP make_char(const std::vector<std::string>& inputs) {
     std::string input("");
     if (inputs.size() != 0) {
@@ -3,6 +3,7 @@
 
 #include <vector>
 #include <string>
+#include <unordered_map>
 #include "Rincludes.h"
 
 extern const std::string ENVTRACER_NA_STRING;
@@ -16,6 +17,11 @@ std::string get_sexp_type(SEXP r_value);
 
 std::string get_type_as_string(SEXP r_object);
 
+/* SEXPTYPE of r_value, NA_INTEGER for unbound values */
+int get_sexp_typeof(SEXP r_value);
+
+std::string sexptype_to_string(int type);
+
 SEXP integer_vector_wrap(const std::vector<int>& vector);
 
 SEXP real_vector_wrap(const std::vector<double>& vector);
@@ -29,8 +35,21 @@ void set_class(SEXP r_object, const std::string& class_name);
 SEXP create_data_frame(const std::vector<std::string>& names,
                        const std::vector<SEXP>& columns);
 
+SEXP get_list_element(SEXP r_list, const char* name);
+
 SEXP make_char(const std::string& input);
 
+/* Maps strings to CHARSXPs for the duration of a single export so that
+   columns with few distinct values create each CHARSXP once. The CHARSXPs
+   are kept alive by the protected vectors they are stored in. */
+class CharCache {
+  public:
+    SEXP get(const std::string& input);
+
+  private:
+    std::unordered_map<std::string, SEXP> chars_;
+};
+
 SEXP make_char(const std::vector<std::string>& inputs);
 
 std::string charptr_to_string(const char* charptr);